@@ -53,6 +53,8 @@ struct Mover
   ParticleSet els;
   /// wavefunction container
   WaveFunction wavefunction;
+  /// wavefunction at the proposed positions of the all-electron moves, swapped in on acceptance
+  WaveFunction trial_wavefunction;
   /// non-local pseudo-potentials
   NonLocalPP<RealType> nlpp;
 
@@ -103,6 +105,14 @@ const std::vector<WaveFunction*> extract_wf_list(const std::vector<Mover*>& move
   return wf_list;
 }
 
+const std::vector<WaveFunction*> extract_trial_wf_list(const std::vector<Mover*>& mover_list)
+{
+  std::vector<WaveFunction*> wf_list;
+  for (auto it = mover_list.begin(); it != mover_list.end(); it++)
+    wf_list.push_back(&(*it)->trial_wavefunction);
+  return wf_list;
+}
+
 const std::vector<NonLocalPP<QMCTraits::RealType>*> extract_nlpp_list(const std::vector<Mover*>& mover_list)
 {
   std::vector<NonLocalPP<QMCTraits::RealType>*> nlpp_list;
@@ -17,6 +17,7 @@
 #ifndef QMCPLUSPLUS_MINIAPPS_PSEUDO_H
 #define QMCPLUSPLUS_MINIAPPS_PSEUDO_H
 
+#include <memory>
 #include <Utilities/RandomGenerator.h>
 #include <Particle/VirtualParticleSet.h>
 #include <QMCWaveFunctions/WaveFunction.h>
@@ -46,8 +47,11 @@ struct NonLocalPP
   std::vector<RealType> weight_m;
   /** positions on a sphere */
   std::vector<PosType> sgridxyz_m;
-  /** Virtual ParticleSet for each ionic specie*/
-  std::vector<VirtualParticleSet> VPs;
+  /** Virtual ParticleSets holding the knots of 2^b ions at VPs[b], created at first use
+   *
+   * The ions within Rmax of an electron are split into chunks of these sizes.
+   */
+  std::vector<std::unique_ptr<VirtualParticleSet>> VPs;
   /** ions particle set */
   const ParticleSet& ions_ref;
 
@@ -87,14 +91,22 @@ struct NonLocalPP
   {
     if (VPs.size())
       throw std::runtime_error("Can not create VPs again.\n");
-    // reserving space avoids the copy constructor of VirtualParticleSet which is not safe to use
-    // due to the unsafety of ParticleSet base class. To be fixed.
-    VPs.reserve(ions.groups());
-    for (int i = 0; i < ions.groups(); ++i)
-      VPs.emplace_back(elecs, size());
+    int num_sizes = 1;
+    while ((2 << (num_sizes - 1)) <= ions.getTotalNum())
+      num_sizes++;
+    VPs.resize(num_sizes);
     Rmax = Rmax_in;
   }
 
+  /// the VP of the knots around 2^b ions
+  VirtualParticleSet& getVP(const ParticleSet& elecs, int b)
+  {
+    auto& VP = VPs[b];
+    if (!VP)
+      VP.reset(new VirtualParticleSet(elecs, (1 << b) * size()));
+    return *VP;
+  }
+
   inline int size() const { return sgridxyz_m.size(); }
 
   template<typename PA>
@@ -112,11 +124,18 @@ struct NonLocalPP
       rrotsgrid[i] = dot(rmat, sgridxyz_m[i]);
   }
 
+  /** the ratios of the knots of an electron are computed by a few evaluateRatios
+   *
+   * The ions within Rmax are taken in power-of-two chunks, at most log2(ions)+1 of them.
+   * The determinant corrects the inverse row for the delayed updates once per electron
+   * and reuses it for all the chunks.
+   */
   void evaluate(const ParticleSet& els, WaveFunction& wf)
   {
     ParticlePos_t rOnSphere(size());
-    ParticlePos_t virtualPos(size());
-    std::vector<QMCTraits::ValueType> ratios(size());
+    ParticlePos_t virtualPos;
+    std::vector<int> near_ions;
+    std::vector<QMCTraits::ValueType> ratios;
     randomize(rOnSphere); // pick random sphere
     const DistanceTableData* d_ie = els.DistTables[wf.get_ei_TableID()];
 
@@ -124,17 +143,31 @@ struct NonLocalPP
     {
       const auto& dist  = d_ie->Distances[jel];
       const auto& displ = d_ie->Displacements[jel];
+      near_ions.clear();
       for (int iat = 0; iat < ions_ref.getTotalNum(); ++iat)
-      {
         //due to < Rmax condition, the actually iteration iat is [0,2] in a real simulation
         if (dist[iat] < Rmax)
+          near_ions.push_back(iat);
+
+      for (int first = 0; first < near_ions.size();)
+      {
+        const int remaining = near_ions.size() - first;
+        int b               = 0;
+        while ((2 << b) <= remaining)
+          b++;
+        const int num_ions = 1 << b;
+        virtualPos.resize(num_ions * size());
+        for (int i = 0; i < num_ions; i++)
         {
+          const int iat = near_ions[first + i];
           for (int k = 0; k < size(); k++)
-            virtualPos[k] = dist[iat] * rOnSphere[k] + displ[iat] + els.R[jel];
-          auto& VP = VPs[ions_ref.GroupID[iat]];
-          VP.makeMoves(jel, virtualPos, true, iat);
-          wf.evaluateRatios(VP, ratios);
+            virtualPos[i * size() + k] = dist[iat] * rOnSphere[k] + displ[iat] + els.R[jel];
         }
+        auto& VP = getVP(els, b);
+        VP.makeMoves(jel, virtualPos);
+        ratios.resize(VP.getTotalNum());
+        wf.evaluateRatios(VP, ratios);
+        first += num_ions;
       }
     }
   }
@@ -0,0 +1,455 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/** @file bench_spo.cpp
+ * @brief Microbenchmark of the 3D spline kernels.
+ *
+ * Sweeps tile sizes, grid sizes, coefficient storages, instruction sets, thread
+ * counts and kernels, and reports the time per evaluation of all the orbitals,
+ * the effective bandwidth and the arithmetic intensity, as CSV or JSON.
+ *
+ * Bytes and flops follow a model of the kernels: an evaluation reads the 64
+ * stencil points of every spline and writes its outputs once, the flops are
+ * those of the stencil sums with an fma counted as 2. Coefficients served by
+ * the caches are counted as memory traffic, so the bandwidth of small tables
+ * can exceed the memory bandwidth.
+ */
+#include <Utilities/Configuration.h>
+#include <Utilities/Communicate.h>
+#include <Utilities/Clock.h>
+#include <Utilities/RandomGenerator.h>
+#include <QMCWaveFunctions/einspline_spo.hpp>
+#include <QMCWaveFunctions/SPOSet_builder.h>
+#include <Utilities/qmcpack_version.h>
+#include <getopt.h>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace qmcplusplus;
+
+void print_help()
+{
+  // clang-format off
+  app_summary() << "usage:" << '\n';
+  app_summary() << "  bench_spo [-hvV] [-a \"tiles\"] [-f format] [-i \"isas\"] [-k \"kernels\"]" << '\n';
+  app_summary() << "            [-m \"meshfactors\"] [-n evaluations] [-N orbitals] [-o file]"    << '\n';
+  app_summary() << "            [-p \"storages\"] [-s seed] [-t \"threads\"]"                     << '\n';
+  app_summary() << "options:"                                                             << '\n';
+  app_summary() << "  -a  splines per tile                default: 16 32 64 128"          << '\n';
+  app_summary() << "  -f  output format, csv or json      default: csv"                   << '\n';
+  app_summary() << "  -h  print help and exit"                                            << '\n';
+  app_summary() << "  -i  auto, portable, avx2 or avx512  default: auto"                  << '\n';
+  app_summary() << "  -k  evaluations: v, vgl, vgh        default: v vgl vgh"             << '\n';
+  app_summary() << "  -m  meshfactors                     default: 1.0"                   << '\n';
+  app_summary() << "  -n  evaluations per thread          default: 1000"                  << '\n';
+  app_summary() << "  -N  number of orbitals              default: 256"                   << '\n';
+  app_summary() << "  -o  output file                     default: standard output"       << '\n';
+  app_summary() << "  -p  storages: native, fp16, bf16    default: native"                << '\n';
+  app_summary() << "  -s  set the random seed.            default: 11"                    << '\n';
+  app_summary() << "  -t  numbers of threads              default: all the threads"       << '\n';
+  app_summary() << "  -v  verbose output"                                                 << '\n';
+  app_summary() << "  -V  print version information and exit"                             << '\n';
+  // clang-format on
+
+  exit(1); // print help and exit
+}
+
+/// split a list of values separated by spaces
+template<typename T>
+std::vector<T> parse_list(const std::string& list)
+{
+  std::vector<T> values;
+  std::istringstream is(list);
+  T value;
+  while (is >> value)
+    values.push_back(value);
+  return values;
+}
+
+/// bytes and flops of an evaluation of a spline, see the file description
+struct KernelModel
+{
+  std::string name;
+  /// outputs per spline
+  int num_outputs;
+  /// flops per spline
+  int flops;
+};
+
+const std::vector<KernelModel>& kernel_models()
+{
+  // v: 4 rows weighted and accumulated per stencil row, 16 rows
+  // vgl: 3 weighted sums of the rows, 5 accumulations, gradient scaling
+  // vgh: 3 weighted sums of the rows, 10 accumulations, gradient and hessian scaling
+  static const std::vector<KernelModel> models{{"v", 1, 16 * 9}, {"vgl", 5, 16 * 33 + 3}, {"vgh", 10, 16 * 41 + 9}};
+  return models;
+}
+
+/// one point of the sweep
+struct BenchResult
+{
+  std::string kernel, storage, isa;
+  int tile, nx, ny, nz, threads;
+  double meshfactor;
+  /// seconds per evaluation of all the orbitals, per thread
+  double time_per_eval;
+  double gbytes_per_sec, gflops_per_sec, flops_per_byte;
+};
+
+void write_csv(std::ostream& os, const std::vector<BenchResult>& results)
+{
+  os << "kernel,storage,isa,tile,meshfactor,nx,ny,nz,threads,time_per_eval_us,gbytes_per_sec,gflops_per_sec,"
+        "flops_per_byte\n";
+  for (const auto& r : results)
+    os << r.kernel << ',' << r.storage << ',' << r.isa << ',' << r.tile << ',' << r.meshfactor << ',' << r.nx << ','
+       << r.ny << ',' << r.nz << ',' << r.threads << ',' << r.time_per_eval * 1e6 << ',' << r.gbytes_per_sec << ','
+       << r.gflops_per_sec << ',' << r.flops_per_byte << '\n';
+}
+
+void write_json(std::ostream& os, const std::vector<BenchResult>& results)
+{
+  os << "[\n";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult& r = results[i];
+    os << "  {\"kernel\": \"" << r.kernel << "\", \"storage\": \"" << r.storage << "\", \"isa\": \"" << r.isa
+       << "\", \"tile\": " << r.tile << ", \"meshfactor\": " << r.meshfactor << ", \"nx\": " << r.nx
+       << ", \"ny\": " << r.ny << ", \"nz\": " << r.nz << ", \"threads\": " << r.threads
+       << ", \"time_per_eval_us\": " << r.time_per_eval * 1e6 << ", \"gbytes_per_sec\": " << r.gbytes_per_sec
+       << ", \"gflops_per_sec\": " << r.gflops_per_sec << ", \"flops_per_byte\": " << r.flops_per_byte << "}"
+       << (i + 1 < results.size() ? "," : "") << '\n';
+  }
+  os << "]\n";
+}
+
+/// sweep options shared by all the storages
+struct BenchOptions
+{
+  int norb = 256;
+  int nevals = 1000;
+  int iseed = 11;
+  std::vector<int> tiles{16, 32, 64, 128};
+  std::vector<double> meshfactors{1.0};
+  std::vector<std::string> kernels{"v", "vgl", "vgh"};
+  std::vector<SplineISA> isas{detectSplineISA()};
+  std::vector<int> threads{omp_get_max_threads()};
+};
+
+/// evaluate all the blocks at the first nevals positions of pos, eval(spline, x, y, z) runs one kernel
+template<typename CT, typename T, typename F>
+inline void run_kernel(const einspline_spo<OHMMS_PRECISION, CT>& spo, const std::vector<T>& pos, int nevals, F eval)
+{
+  for (int iw = 0; iw < nevals; iw++)
+  {
+    const T x = pos[3 * iw], y = pos[3 * iw + 1], z = pos[3 * iw + 2];
+    for (int i = 0; i < spo.nBlocks; i++)
+      eval(spo.einsplines[i], x, y, z);
+  }
+}
+
+/** time nevals evaluations per thread of all the blocks at random positions
+ * @return wall time in seconds
+ */
+template<typename CT>
+double time_kernel(const einspline_spo<OHMMS_PRECISION, CT>& spo,
+                   const std::string& kernel,
+                   SplineISA isa,
+                   int nthreads,
+                   const BenchOptions& options)
+{
+  using T = OHMMS_PRECISION;
+  // the kernel is picked once, not in the timed loop
+  enum class Kernel
+  {
+    v,
+    vgl,
+    vgh
+  };
+  const Kernel kind = (kernel == "v") ? Kernel::v : (kernel == "vgl") ? Kernel::vgl : Kernel::vgh;
+  double elapsed    = 0.0;
+#pragma omp parallel num_threads(nthreads)
+  {
+    RandomGenerator<T> random_th(options.iseed + omp_get_thread_num());
+    std::vector<T> pos(3 * options.nevals);
+    random_th.generate_uniform(pos.data(), pos.size());
+
+    const int ns = spo.nSplinesPerBlock;
+    aligned_vector<T> vals(ns);
+    VectorSoAContainer<T, 3> grads(ns);
+    VectorSoAContainer<T, 6> hess(ns);
+
+    using spline_type = typename einspline_spo<OHMMS_PRECISION, CT>::spline_type;
+    auto run = [&](int nevals) {
+      switch (kind)
+      {
+      case Kernel::v:
+        run_kernel(spo, pos, nevals, [&](const spline_type* spline, T x, T y, T z) {
+          MultiBsplineEval::evaluate_v(isa, spline, x, y, z, vals.data(), ns);
+        });
+        break;
+      case Kernel::vgl:
+        run_kernel(spo, pos, nevals, [&](const spline_type* spline, T x, T y, T z) {
+          MultiBsplineEval::evaluate_vgl(isa, spline, x, y, z, vals.data(), grads.data(), hess.data(), ns,
+                                         grads.capacity());
+        });
+        break;
+      case Kernel::vgh:
+        run_kernel(spo, pos, nevals, [&](const spline_type* spline, T x, T y, T z) {
+          MultiBsplineEval::evaluate_vgh(isa, spline, x, y, z, vals.data(), grads.data(), hess.data(), ns);
+        });
+        break;
+      }
+    };
+
+    // warm up the caches, the page tables and the clock frequency with a full run
+    run(options.nevals);
+#pragma omp barrier
+    const double start = cpu_clock();
+    run(options.nevals);
+#pragma omp barrier
+#pragma omp master
+    elapsed = cpu_clock() - start;
+  }
+  return elapsed;
+}
+
+template<typename CT>
+void bench_storage(const std::string& storage, const BenchOptions& options, std::vector<BenchResult>& results)
+{
+  for (double meshfactor : options.meshfactors)
+    for (int tile : options.tiles)
+    {
+      if (tile <= 0 || options.norb % tile != 0)
+      {
+        app_warning() << "Skipping tile " << tile << ", not a divisor of " << options.norb << " orbitals" << std::endl;
+        continue;
+      }
+      const int nx = 37 * meshfactor, ny = 37 * meshfactor, nz = 37 * meshfactor;
+      einspline_spo<OHMMS_PRECISION, CT> spo;
+      spo.set(nx, ny, nz, options.norb, options.norb / tile);
+
+      // the spline kernels of 16-bit storages are portable, timed once
+      std::vector<SplineISA> isas(options.isas);
+      if (!MultiBsplineEval::is_simd_dispatched<typename einspline_spo<OHMMS_PRECISION, CT>::spline_type,
+                                                OHMMS_PRECISION>::value)
+        isas.assign(1, SplineISA::portable);
+
+      for (SplineISA isa : isas)
+        for (int nthreads : options.threads)
+          for (const auto& model : kernel_models())
+          {
+            if (std::find(options.kernels.begin(), options.kernels.end(), model.name) == options.kernels.end())
+              continue;
+            const double elapsed = time_kernel(spo, model.name, isa, nthreads, options);
+
+            BenchResult r;
+            r.kernel     = model.name;
+            r.storage    = storage;
+            r.isa        = getSplineISAName(isa);
+            r.tile       = tile;
+            r.meshfactor = meshfactor;
+            r.nx         = nx;
+            r.ny         = ny;
+            r.nz         = nz;
+            r.threads    = nthreads;
+            const double evals    = static_cast<double>(options.nevals) * nthreads;
+            const double bytes    = static_cast<double>(options.norb) *
+                (64 * sizeof(CT) + model.num_outputs * sizeof(OHMMS_PRECISION));
+            const double flops    = static_cast<double>(options.norb) * model.flops;
+            r.time_per_eval  = elapsed / options.nevals;
+            r.gbytes_per_sec = bytes * evals / elapsed * 1e-9;
+            r.gflops_per_sec = flops * evals / elapsed * 1e-9;
+            r.flops_per_byte = flops / bytes;
+            results.push_back(r);
+            app_log() << r.kernel << " " << r.storage << " " << r.isa << " tile " << tile << " mesh " << nx
+                      << " threads " << nthreads << ": " << r.time_per_eval * 1e6 << " us " << r.gbytes_per_sec
+                      << " GB/s " << r.gflops_per_sec << " GFLOP/s" << std::endl;
+          }
+    }
+}
+
+int main(int argc, char** argv)
+{
+  Communicate comm(argc, argv);
+
+  BenchOptions options;
+  std::vector<std::string> storages{"native"};
+  std::string format = "csv";
+  std::string output;
+  bool verbose = false;
+
+  if (!comm.root())
+  {
+    outputManager.shutOff();
+  }
+
+  int opt;
+  while (optind < argc)
+  {
+    if ((opt = getopt(argc, argv, "hvVa:f:i:k:m:n:N:o:p:s:t:")) != -1)
+    {
+      switch (opt)
+      {
+      case 'a':
+        options.tiles = parse_list<int>(optarg);
+        break;
+      case 'f':
+        format = optarg;
+        break;
+      case 'h':
+        print_help();
+        break;
+      case 'i':
+      {
+        options.isas.clear();
+        for (const auto& name : parse_list<std::string>(optarg))
+        {
+          SplineISA isa;
+          if (!getSplineISA(name, isa))
+          {
+            app_error() << "Unknown SPO kernels " << name << std::endl;
+            return 1;
+          }
+          if (!isSplineISASupported(isa))
+          {
+            app_error() << "SPO kernels " << name << " not supported by this cpu" << std::endl;
+            return 1;
+          }
+          options.isas.push_back(isa);
+        }
+      }
+      break;
+      case 'k':
+        options.kernels = parse_list<std::string>(optarg);
+        break;
+      case 'm':
+        options.meshfactors = parse_list<double>(optarg);
+        break;
+      case 'n':
+        options.nevals = atoi(optarg);
+        break;
+      case 'N':
+        options.norb = atoi(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'p':
+        storages = parse_list<std::string>(optarg);
+        break;
+      case 's':
+        options.iseed = atoi(optarg);
+        break;
+      case 't':
+        options.threads = parse_list<int>(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'V':
+        print_version(true);
+        return 1;
+        break;
+      default:
+        print_help();
+      }
+    }
+    else // disallow non-option arguments
+    {
+      app_error() << "Non-option arguments not allowed" << endl;
+      print_help();
+    }
+  }
+
+  if (format != "csv" && format != "json")
+  {
+    app_error() << "Unknown output format " << format << ", use csv or json" << std::endl;
+    return 1;
+  }
+  if (options.nevals < 1 || options.norb < 1)
+  {
+    app_error() << "The numbers of evaluations and orbitals must be positive" << std::endl;
+    return 1;
+  }
+  for (const auto& kernel : options.kernels)
+    if (kernel != "v" && kernel != "vgl" && kernel != "vgh")
+    {
+      app_error() << "Unknown kernel " << kernel << ", use v, vgl or vgh" << std::endl;
+      return 1;
+    }
+  for (int nthreads : options.threads)
+    if (nthreads < 1)
+    {
+      app_error() << "The numbers of threads must be positive" << std::endl;
+      return 1;
+    }
+
+  if (comm.root())
+  {
+    // the results on standard output stay machine readable, the version and progress go to the error stream
+    if (output.empty())
+    {
+      outputManager.resume();
+      infoSummary.setStream(&std::cerr);
+      infoLog.setStream(&std::cerr);
+    }
+    if (verbose)
+      outputManager.setVerbosity(Verbosity::HIGH);
+    else
+      outputManager.setVerbosity(Verbosity::LOW);
+  }
+
+  print_version(verbose);
+
+  std::vector<BenchResult> results;
+  for (const auto& name : storages)
+  {
+    SplineStorage storage;
+    if (!getSplineStorage(name, storage))
+    {
+      app_error() << "Unknown SPO storage " << name << std::endl;
+      return 1;
+    }
+    switch (storage)
+    {
+    case SplineStorage::fp16:
+      bench_storage<float16>(name, options, results);
+      break;
+    case SplineStorage::bf16:
+      bench_storage<bfloat16>(name, options, results);
+      break;
+    default:
+      bench_storage<OHMMS_PRECISION>(name, options, results);
+    }
+  }
+
+  if (!comm.root())
+    return 0;
+
+  std::ofstream fout;
+  if (!output.empty())
+  {
+    fout.open(output);
+    if (!fout)
+    {
+      app_error() << "Failed to open " << output << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& os = output.empty() ? std::cout : fout;
+  if (format == "json")
+    write_json(os, results);
+  else
+    write_csv(os, results);
+
+  return 0;
+}
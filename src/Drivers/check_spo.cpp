@@ -26,6 +26,7 @@
 #include <Input/Input.hpp>
 #include <QMCWaveFunctions/einspline_spo.hpp>
 #include <QMCWaveFunctions/einspline_spo_ref.hpp>
+#include <QMCWaveFunctions/SPOSet_builder.h>
 #include <Drivers/NonLocalPP.hpp>
 #include <Utilities/qmcpack_version.h>
 #include <getopt.h>
@@ -53,6 +54,36 @@ void print_help()
   exit(1); // print help and exit
 }
 
+/// accumulate the absolute V, G and H differences of the last evaluate_vgh of two SPO sets
+template<typename SPO, typename SPO_REF>
+void accumulate_vgh_error(const SPO& spo, const SPO_REF& spo_ref, double& v_err, double& g_err, double& h_err)
+{
+  for (int ib = 0; ib < spo.nBlocks; ib++)
+    for (int n = 0; n < spo.nSplinesPerBlock; n++)
+    {
+      v_err += std::fabs(spo.psi[ib][n] - spo_ref.psi[ib][n]);
+      for (int d = 0; d < 3; d++)
+        g_err += std::fabs(spo.grad[ib].data(d)[n] - spo_ref.grad[ib].data(d)[n]);
+      for (int d = 0; d < 6; d++)
+        h_err += std::fabs(spo.hess[ib].data(d)[n] - spo_ref.hess[ib].data(d)[n]);
+    }
+}
+
+/// accumulate the absolute V, G and H of the last evaluate_vgh of a SPO set
+template<typename SPO>
+void accumulate_vgh_norm(const SPO& spo, double& v_norm, double& g_norm, double& h_norm)
+{
+  for (int ib = 0; ib < spo.nBlocks; ib++)
+    for (int n = 0; n < spo.nSplinesPerBlock; n++)
+    {
+      v_norm += std::fabs(spo.psi[ib][n]);
+      for (int d = 0; d < 3; d++)
+        g_norm += std::fabs(spo.grad[ib].data(d)[n]);
+      for (int d = 0; d < 6; d++)
+        h_norm += std::fabs(spo.hess[ib].data(d)[n]);
+    }
+}
+
 int main(int argc, char** argv)
 {
   // clang-format off
@@ -156,6 +187,13 @@ int main(int argc, char** argv)
   spo_type spo_main;
   using spo_ref_type = miniqmcreference::einspline_spo_ref<OHMMS_PRECISION>;
   spo_ref_type spo_ref_main;
+  // reduced-precision coefficient storage
+  using spo_fp16_type = einspline_spo<OHMMS_PRECISION, float16>;
+  spo_fp16_type spo_fp16_main;
+  using spo_bf16_type = einspline_spo<OHMMS_PRECISION, bfloat16>;
+  spo_bf16_type spo_bf16_main;
+  // coefficients in Morton-ordered bricks
+  spo_type spo_brick_main;
   int nTiles = 1;
 
   ParticleSet ions;
@@ -188,6 +226,13 @@ int main(int argc, char** argv)
     spo_main.Lattice.set(lattice_b);
     spo_ref_main.set(nx, ny, nz, norb, nTiles);
     spo_ref_main.Lattice.set(lattice_b);
+    spo_fp16_main.set(nx, ny, nz, norb, nTiles);
+    spo_fp16_main.Lattice.set(lattice_b);
+    spo_bf16_main.set(nx, ny, nz, norb, nTiles);
+    spo_bf16_main.Lattice.set(lattice_b);
+    spo_brick_main.set(nx, ny, nz, norb, nTiles);
+    spo_brick_main.to_bricks();
+    spo_brick_main.Lattice.set(lattice_b);
   }
 
   double nspheremoves = 0;
@@ -197,10 +242,28 @@ int main(int argc, char** argv)
   double evalVGH_v_err = 0.0;
   double evalVGH_g_err = 0.0;
   double evalVGH_h_err = 0.0;
+  double evalMW_vgh_err = 0.0;
+  double evalBrick_err  = 0.0;
+  double evalRatio_err  = 0.0;
+  double evalISA_v_err  = 0.0;
+  double evalISA_g_err  = 0.0;
+  double evalISA_h_err  = 0.0;
+  double evalTeam_err   = 0.0;
+  double evalVGL_v_err  = 0.0;
+  double evalVGL_g_err  = 0.0;
+  double evalVGL_l_err  = 0.0;
+  // norms of the reference and errors of the reduced-precision storage
+  double refVGH_v_norm = 0.0, refVGH_g_norm = 0.0, refVGH_h_norm = 0.0;
+  double fp16VGH_v_err = 0.0, fp16VGH_g_err = 0.0, fp16VGH_h_err = 0.0;
+  double bf16VGH_v_err = 0.0, bf16VGH_g_err = 0.0, bf16VGH_h_err = 0.0;
 
   // clang-format off
   #pragma omp parallel reduction(+:ratio,nspheremoves,dNumVGHCalls) \
-   reduction(+:evalV_v_err,evalVGH_v_err,evalVGH_g_err,evalVGH_h_err)
+   reduction(+:evalV_v_err,evalVGH_v_err,evalVGH_g_err,evalVGH_h_err,evalMW_vgh_err,evalBrick_err) \
+   reduction(+:evalRatio_err,evalISA_v_err,evalISA_g_err,evalISA_h_err,evalTeam_err) \
+   reduction(+:evalVGL_v_err,evalVGL_g_err,evalVGL_l_err) \
+   reduction(+:refVGH_v_norm,refVGH_g_norm,refVGH_h_norm) \
+   reduction(+:fp16VGH_v_err,fp16VGH_g_err,fp16VGH_h_err,bf16VGH_v_err,bf16VGH_g_err,bf16VGH_h_err)
   // clang-format on
   {
     const int np        = omp_get_num_threads();
@@ -224,6 +287,23 @@ int main(int argc, char** argv)
     // create spo per thread
     spo_type spo(spo_main, team_size, member_id);
     spo_ref_type spo_ref(spo_ref_main, team_size, member_id);
+    spo_fp16_type spo_fp16(spo_fp16_main, team_size, member_id);
+    spo_bf16_type spo_bf16(spo_bf16_main, team_size, member_id);
+    spo_type spo_brick(spo_brick_main, team_size, member_id);
+    // spo uses the widest kernels of the cpu, compare them and avx2 to the portable ones
+    spo_type spo_portable(spo_main, team_size, member_id);
+    spo_portable.ISA = SplineISA::portable;
+    spo_type spo_avx2(spo_main, team_size, member_id);
+    if (isSplineISASupported(SplineISA::avx2))
+      spo_avx2.ISA = SplineISA::avx2;
+    // the blocks of spo split among two members evaluating the same walker
+    std::unique_ptr<SPOSet> spo_team(build_SPOSet_team(false, &spo, 2));
+    SPOSet::ValueVector_t psi_v(spo.size()), team_psi_v(spo.size());
+    SPOSet::GradVector_t dpsi_v(spo.size()), team_dpsi_v(spo.size());
+    SPOSet::ValueVector_t d2psi_v(spo.size()), team_d2psi_v(spo.size());
+    // outputs of evaluateVGL, written in place
+    SPOSet::ValueVector_t vgl_psi_v(spo.size()), vgl_d2psi_v(spo.size());
+    SPOSet::GradVectorSoA_t vgl_dpsi_v(spo.size());
 
     // use teams
     // if(team_size>1 && team_size>=nTiles ) spo.set_range(team_size,ip%team_size);
@@ -233,6 +313,12 @@ int main(int argc, char** argv)
 
     ParticlePos_t delta(nels);
     ParticlePos_t rOnSphere(nknots);
+    // virtual moves of all the knots around an ion at once
+    VirtualParticleSet VP(els, nknots);
+    ParticlePos_t vpPos(nknots);
+    SPOSet::ValueVector_t vp_psi(spo.size()), vp_psiinv(spo.size());
+    random_th.generate_uniform(vp_psiinv.data(), spo.size());
+    std::vector<SPOSet::ValueType> vp_ratios(nknots), vp_ratios_ref(nknots);
 
     RealType accept  = 0.5;
 
@@ -242,6 +328,23 @@ int main(int argc, char** argv)
 
     int my_accepted = 0, my_vals = 0;
 
+    // buffers of the batched evaluation at all the electron positions
+    const int nsplines = spo.nSplinesPerBlock;
+    std::vector<spo_type::vContainer_type> mw_psi(nels, spo_type::vContainer_type(nsplines));
+    std::vector<spo_type::gContainer_type> mw_grad(nels, spo_type::gContainer_type(nsplines));
+    std::vector<spo_type::hContainer_type> mw_hess(nels, spo_type::hContainer_type(nsplines));
+    std::vector<RealType*> mw_v(nels), mw_g(nels), mw_h(nels);
+    std::vector<RealType> mw_x(nels), mw_y(nels), mw_z(nels);
+    for (int iel = 0; iel < nels; ++iel)
+    {
+      mw_v[iel] = mw_psi[iel].data();
+      mw_g[iel] = mw_grad[iel].data();
+      mw_h[iel] = mw_hess[iel].data();
+    }
+    spo_type::vContainer_type sw_psi(nsplines);
+    spo_type::gContainer_type sw_grad(nsplines);
+    spo_type::hContainer_type sw_hess(nsplines);
+
     for (int mc = 0; mc < nsteps; ++mc)
     {
       random_th.generate_normal(&delta[0][0], nels3);
@@ -271,6 +374,37 @@ int main(int argc, char** argv)
             evalVGH_h_err += std::fabs(spo.hess[ib].data(4)[n] - spo_ref.hess[ib].data(4)[n]);
             evalVGH_h_err += std::fabs(spo.hess[ib].data(5)[n] - spo_ref.hess[ib].data(5)[n]);
           }
+        spo_fp16.evaluate_vgh(els, iel);
+        spo_bf16.evaluate_vgh(els, iel);
+        accumulate_vgh_norm(spo_ref, refVGH_v_norm, refVGH_g_norm, refVGH_h_norm);
+        accumulate_vgh_error(spo_fp16, spo_ref, fp16VGH_v_err, fp16VGH_g_err, fp16VGH_h_err);
+        accumulate_vgh_error(spo_bf16, spo_ref, bf16VGH_v_err, bf16VGH_g_err, bf16VGH_h_err);
+        spo_portable.evaluate_vgh(els, iel);
+        spo_avx2.evaluate_vgh(els, iel);
+        accumulate_vgh_error(spo, spo_portable, evalISA_v_err, evalISA_g_err, evalISA_h_err);
+        accumulate_vgh_error(spo_avx2, spo_portable, evalISA_v_err, evalISA_g_err, evalISA_h_err);
+        spo_brick.evaluate_vgh(els, iel);
+        accumulate_vgh_error(spo_brick, spo_portable, evalBrick_err, evalBrick_err, evalBrick_err);
+        spo.evaluate(els, iel, psi_v, dpsi_v, d2psi_v);
+        spo_team->evaluate(els, iel, team_psi_v, team_dpsi_v, team_d2psi_v);
+        for (int n = 0; n < spo.size(); n++)
+        {
+          evalTeam_err += std::fabs(team_psi_v[n] - psi_v[n]) + std::fabs(team_d2psi_v[n] - d2psi_v[n]);
+          for (int d = 0; d < 3; d++)
+            evalTeam_err += std::fabs(team_dpsi_v[n][d] - dpsi_v[n][d]);
+        }
+        for (SPOSet* spo_vgl : {static_cast<SPOSet*>(&spo), static_cast<SPOSet*>(&spo_portable),
+                                static_cast<SPOSet*>(&spo_brick)})
+        {
+          spo_vgl->evaluateVGL(els, iel, vgl_psi_v, vgl_dpsi_v, vgl_d2psi_v);
+          for (int n = 0; n < spo.size(); n++)
+          {
+            evalVGL_v_err += std::fabs(vgl_psi_v[n] - psi_v[n]);
+            for (int d = 0; d < 3; d++)
+              evalVGL_g_err += std::fabs(vgl_dpsi_v.data(d)[n] - dpsi_v[n][d]);
+            evalVGL_l_err += std::fabs(vgl_d2psi_v[n] - d2psi_v[n]);
+          }
+        }
         if (ur[iel] < accept)
         {
           els.acceptMove(iel);
@@ -278,6 +412,33 @@ int main(int argc, char** argv)
         }
       }
 
+      // batched evaluation against the single-position one
+      for (int iel = 0; iel < nels; ++iel)
+      {
+        auto u    = spo.Lattice.toUnit_floor(els.R[iel]);
+        mw_x[iel] = u[0];
+        mw_y[iel] = u[1];
+        mw_z[iel] = u[2];
+      }
+      for (int ib = 0; ib < spo.nBlocks; ib++)
+      {
+        MultiBsplineEval::mw_evaluate_vgh(spo.einsplines[ib], mw_x.data(), mw_y.data(), mw_z.data(),
+                                          mw_v.data(), mw_g.data(), mw_h.data(), nsplines, nels);
+        for (int iel = 0; iel < nels; ++iel)
+        {
+          MultiBsplineEval::evaluate_vgh(spo.einsplines[ib], mw_x[iel], mw_y[iel], mw_z[iel], sw_psi.data(),
+                                         sw_grad.data(), sw_hess.data(), nsplines);
+          for (int n = 0; n < nsplines; n++)
+          {
+            evalMW_vgh_err += std::fabs(mw_psi[iel][n] - sw_psi[n]);
+            for (int d = 0; d < 3; d++)
+              evalMW_vgh_err += std::fabs(mw_grad[iel].data(d)[n] - sw_grad.data(d)[n]);
+            for (int d = 0; d < 6; d++)
+              evalMW_vgh_err += std::fabs(mw_hess[iel].data(d)[n] - sw_hess.data(d)[n]);
+          }
+        }
+      }
+
       random_th.generate_uniform(ur.data(), nels);
       ecp.randomize(rOnSphere); // pick random sphere
       for (int iat = 0, kat = 0; iat < nions; ++iat)
@@ -300,7 +461,30 @@ int main(int argc, char** argv)
             for (int ib = 0; ib < spo.nBlocks; ib++)
               for (int n = 0; n < spo.nSplinesPerBlock; n++)
                 evalV_v_err += std::fabs(spo.psi[ib][n] - spo_ref.psi[ib][n]);
+            spo_portable.evaluate_v(els, iel);
+            for (int ib = 0; ib < spo.nBlocks; ib++)
+              for (int n = 0; n < spo.nSplinesPerBlock; n++)
+                evalISA_v_err += std::fabs(spo.psi[ib][n] - spo_portable.psi[ib][n]);
+            spo_brick.evaluate_v(els, iel);
+            for (int ib = 0; ib < spo.nBlocks; ib++)
+              for (int n = 0; n < spo.nSplinesPerBlock; n++)
+                evalBrick_err += std::fabs(spo_brick.psi[ib][n] - spo_portable.psi[ib][n]);
+            // fused ratio against the values reduced afterwards
+            const SPOSet::ValueType ratio_ref = spo.SPOSet::evaluateDetRatio(els, iel, vp_psi, vp_psiinv);
+            for (SPOSet* spo_ratio : {static_cast<SPOSet*>(&spo), static_cast<SPOSet*>(&spo_portable),
+                                      static_cast<SPOSet*>(&spo_brick), spo_team.get()})
+              evalRatio_err += std::fabs(spo_ratio->evaluateDetRatio(els, iel, vp_psi, vp_psiinv) - ratio_ref);
           }
+          for (int k = 0; k < nknots; k++)
+            vpPos[k] = centerP + r * rOnSphere[k];
+          VP.makeMoves(iel, vpPos, true, iat);
+          spo.evaluateDetRatios(VP, vp_psi, vp_psiinv, vp_ratios);
+          spo.SPOSet::evaluateDetRatios(VP, vp_psi, vp_psiinv, vp_ratios_ref);
+          for (int k = 0; k < nknots; k++)
+            evalRatio_err += std::fabs(vp_ratios[k] - vp_ratios_ref[k]);
+          spo_team->evaluateDetRatios(VP, vp_psi, vp_psiinv, vp_ratios_ref);
+          for (int k = 0; k < nknots; k++)
+            evalTeam_err += std::fabs(vp_ratios[k] - vp_ratios_ref[k]);
         } // els
       }   // ions
 
@@ -315,9 +499,19 @@ int main(int argc, char** argv)
   outputManager.resume();
 
   evalV_v_err   /= nspheremoves;
+  evalRatio_err /= nspheremoves;
   evalVGH_v_err /= dNumVGHCalls;
   evalVGH_g_err /= dNumVGHCalls;
   evalVGH_h_err /= dNumVGHCalls;
+  evalMW_vgh_err /= dNumVGHCalls;
+  evalBrick_err /= dNumVGHCalls;
+  evalISA_v_err /= dNumVGHCalls;
+  evalISA_g_err /= dNumVGHCalls;
+  evalISA_h_err /= dNumVGHCalls;
+  evalTeam_err /= dNumVGHCalls;
+  evalVGL_v_err /= dNumVGHCalls;
+  evalVGL_g_err /= dNumVGHCalls;
+  evalVGL_l_err /= dNumVGHCalls;
 
   int np                     = omp_get_max_threads();
   constexpr RealType small_v = std::numeric_limits<RealType>::epsilon() * 1e4;
@@ -330,6 +524,11 @@ int main(int argc, char** argv)
     app_log() << "Fail in evaluate_v, V error =" << evalV_v_err / np << std::endl;
     nfail = 1;
   }
+  if (evalRatio_err / np > small_v)
+  {
+    app_log() << "Fail in evaluateDetRatios, ratio error =" << evalRatio_err / np << std::endl;
+    nfail += 1;
+  }
   if (evalVGH_v_err / np > small_v)
   {
     app_log() << "Fail in evaluate_vgh, V error =" << evalVGH_v_err / np << std::endl;
@@ -345,6 +544,53 @@ int main(int argc, char** argv)
     app_log() << "Fail in evaluate_vgh, H error =" << evalVGH_h_err / np << std::endl;
     nfail += 1;
   }
+  if (evalMW_vgh_err / np > small_v)
+  {
+    app_log() << "Fail in mw_evaluate_vgh, VGH error =" << evalMW_vgh_err / np << std::endl;
+    nfail += 1;
+  }
+  if (evalBrick_err / np > small_v)
+  {
+    app_log() << "Fail in the brick layout, VGH error =" << evalBrick_err / np << std::endl;
+    nfail += 1;
+  }
+  if (evalISA_v_err / np > small_v || evalISA_g_err / np > small_g || evalISA_h_err / np > small_h)
+  {
+    app_log() << "Fail in the " << getSplineISAName(detectSplineISA()) << " kernels, V error ="
+              << evalISA_v_err / np << " G error =" << evalISA_g_err / np << " H error =" << evalISA_h_err / np
+              << std::endl;
+    nfail += 1;
+  }
+  if (evalVGL_v_err / np > small_v || evalVGL_g_err / np > small_g || evalVGL_l_err / np > small_h)
+  {
+    app_log() << "Fail in evaluateVGL, V error =" << evalVGL_v_err / np << " G error =" << evalVGL_g_err / np
+              << " L error =" << evalVGL_l_err / np << std::endl;
+    nfail += 1;
+  }
+  if (evalTeam_err / np > small_v)
+  {
+    app_log() << "Fail in the team evaluation, error =" << evalTeam_err / np << std::endl;
+    nfail += 1;
+  }
+  // reduced-precision storage is checked by the relative error against the reference
+  constexpr double small_fp16 = 1e-3;
+  constexpr double small_bf16 = 1e-2;
+  app_log() << "fp16 storage relative error: V " << fp16VGH_v_err / refVGH_v_norm << " G "
+            << fp16VGH_g_err / refVGH_g_norm << " H " << fp16VGH_h_err / refVGH_h_norm << std::endl;
+  app_log() << "bf16 storage relative error: V " << bf16VGH_v_err / refVGH_v_norm << " G "
+            << bf16VGH_g_err / refVGH_g_norm << " H " << bf16VGH_h_err / refVGH_h_norm << std::endl;
+  if (fp16VGH_v_err > small_fp16 * refVGH_v_norm || fp16VGH_g_err > small_fp16 * refVGH_g_norm ||
+      fp16VGH_h_err > small_fp16 * refVGH_h_norm)
+  {
+    app_log() << "Fail in evaluate_vgh with fp16 storage" << std::endl;
+    nfail += 1;
+  }
+  if (bf16VGH_v_err > small_bf16 * refVGH_v_norm || bf16VGH_g_err > small_bf16 * refVGH_g_norm ||
+      bf16VGH_h_err > small_bf16 * refVGH_h_norm)
+  {
+    app_log() << "Fail in evaluate_vgh with bf16 storage" << std::endl;
+    nfail += 1;
+  }
   comm.reduce(nfail);
 
   if (nfail == 0)
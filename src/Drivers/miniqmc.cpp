@@ -111,6 +111,7 @@
 #include <Utilities/XMLWriter.h>
 #include <Utilities/RandomGenerator.h>
 #include <Utilities/qmcpack_version.h>
+#include <Utilities/OptionFile.h>
 #include <Input/Input.hpp>
 #include <QMCWaveFunctions/SPOSet.h>
 #include <QMCWaveFunctions/SPOSet_builder.h>
@@ -131,6 +132,7 @@ enum MiniQMCTimers
   Timer_evalGrad,
   Timer_ratioGrad,
   Timer_Update,
+  Timer_Recompute,
   Timer_Setup,
 };
 
@@ -143,6 +145,7 @@ TimerNameList_t<MiniQMCTimers> MiniQMCTimerNames = {
     {Timer_evalGrad, "Current Gradient"},
     {Timer_ratioGrad, "New Gradient"},
     {Timer_Update, "Update"},
+    {Timer_Recompute, "All-electron recompute"},
     {Timer_Setup, "Setup"},
 };
 
@@ -150,26 +153,47 @@ void print_help()
 {
   // clang-format off
   app_summary() << "usage:" << '\n';
-  app_summary() << "  miniqmc   [-bhjvV] [-g \"n0 n1 n2\"] [-m meshfactor]"      << '\n';
+  app_summary() << "  miniqmc   [-AbdhjpvV] [-g \"n0 n1 n2\"] [-m meshfactor]"   << '\n';
   app_summary() << "            [-n steps] [-N substeps] [-x rmax]"              << '\n';
   app_summary() << "            [-r AcceptanceRatio] [-s seed] [-w walkers]"     << '\n';
   app_summary() << "            [-a tile_size] [-t timer_level] [-k delay_rank]" << '\n';
+  app_summary() << "            [-f storage] [-M] [-F file] [-T policy] [-R] [-B]"  << '\n';
+  app_summary() << "            [-K kernels] [-c team_size] [-L file]"           << '\n';
+  app_summary() << "            [-l inverse] [-D num_dets] [-u period]"          << '\n';
+  app_summary() << "            [-e threshold]"                                  << '\n';
   app_summary() << "options:"                                                    << '\n';
-  app_summary() << "  -a  size of each spline tile       default: num of orbs"   << '\n';
+  app_summary() << "  -a  size of each spline tile       default: orbs / team"   << '\n';
+  app_summary() << "  -A  move all electrons at once     default: off"           << '\n';
   app_summary() << "  -b  use reference implementations  default: off"           << '\n';
+  app_summary() << "  -B  splines in Morton bricks       default: off"           << '\n';
+  app_summary() << "  -c  threads evaluating a walker    default: 1"             << '\n';
+  app_summary() << "  -d  adapt the delay rank up to -k  default: off"           << '\n';
+  app_summary() << "  -D  number of determinants         default: 1"             << '\n';
+  app_summary() << "  -e  recompute if residual exceeds  default: 0 (no check)"  << '\n';
+  app_summary() << "      useful above ~1e-5 mixed, ~1e-12 full precision"       << '\n';
+  app_summary() << "  -f  coefficients: native,fp16,bf16 default: native"        << '\n';
+  app_summary() << "  -F  spline file, made if missing   default: none"          << '\n';
   app_summary() << "  -g  set the 3D tiling.             default: 1 1 1"         << '\n';
   app_summary() << "  -h  print help and exit"                                   << '\n';
   app_summary() << "  -j  enable three body Jastrow      default: off"           << '\n';
   app_summary() << "  -m  meshfactor                     default: 1.0"           << '\n';
+  app_summary() << "  -M  share spline table in a node   default: off"           << '\n';
   app_summary() << "  -n  number of MC steps             default: 5"             << '\n';
   app_summary() << "  -N  number of MC substeps          default: 1"             << '\n';
+  app_summary() << "  -p  prefetch the next move         default: off"           << '\n';
   app_summary() << "  -r  set the acceptance ratio.      default: 0.5"           << '\n';
+  app_summary() << "  -R  spline table per NUMA node     default: off"           << '\n';
   app_summary() << "  -s  set the random seed.           default: 11"            << '\n';
   app_summary() << "  -t  timer level: coarse or fine    default: fine"          << '\n';
+  app_summary() << "  -T  first touch: block,interleave  default: block"         << '\n';
+  app_summary() << "  -u  steps between the recomputes   default: 0 (never)"     << '\n';
   app_summary() << "  -k  matrix delayed update rank     default: 32"            << '\n';
+  app_summary() << "  -l  inverse: lapack,mixed,native   default: lapack"        << '\n';
+  app_summary() << "  -L  file of options, see autotune  default: none"          << '\n';
+  app_summary() << "  -K  kernels: portable,avx2,avx512  default: auto"          << '\n';
   app_summary() << "  -v  verbose output"                                        << '\n';
   app_summary() << "  -V  print version information and exit"                    << '\n';
-  app_summary() << "  -w  number of walker(movers)       default: num of threads"<< '\n';
+  app_summary() << "  -w  number of walker(movers)       default: num of teams"  << '\n';
   app_summary() << "  -x  set the Rmax.                  default: 1.7"           << '\n';
   // clang-format on
 }
@@ -192,7 +216,7 @@ int main(int argc, char** argv)
   int nsteps = 5;
   int iseed  = 11;
   int nx = 37, ny = 37, nz = 37;
-  int nmovers = omp_get_max_threads();
+  int nmovers = -1;
   // thread blocking
   int tileSize  = -1;
   int team_size = 1;
@@ -201,35 +225,75 @@ int main(int argc, char** argv)
   RealType Rmax(1.7);
   RealType accept  = 0.5;
   int delay_rank = 32;
+  int num_dets   = 1;
+  RecomputePolicy recompute;
   bool useRef   = false;
   bool enableJ3 = false;
+  bool adaptive_delay = false;
+  bool all_electron   = false;
+  bool pipelined = false;
 
   PrimeNumberSet<uint32_t> myPrimes;
 
   bool verbose                 = false;
   std::string timer_level_name = "fine";
+  std::string spline_storage_name = "native";
+  std::string first_touch_name    = "block";
+  std::string spline_isa_name     = "auto";
+  std::string inverse_name        = "lapack";
+  InverseMethod inverse_method    = InverseMethod::lapack;
+  SPOSetOptions spo_options;
+  bool share_splines = false;
 
   if (!comm.root())
   {
     outputManager.shutOff();
   }
 
+  // insert the options of a file given by -L, e.g. written by miniqmc_autotune
+  OptionArgs option_args(argc, argv);
+  if (!option_args.valid())
+    return 1;
+  argc = option_args.argc();
+  argv = option_args.argv();
+
   int opt;
   while (optind < argc)
   {
-    if ((opt = getopt(argc, argv, "bhjvVa:c:g:m:n:N:r:s:t:k:w:x:")) != -1)
+    if ((opt = getopt(argc, argv, "AbBdhjpvVMa:c:D:e:f:F:g:m:n:N:r:Rs:t:T:u:k:K:l:w:x:")) != -1)
     {
       switch (opt)
       {
+      case 'A':
+        all_electron = true;
+        break;
       case 'a':
         tileSize = atoi(optarg);
         break;
       case 'b':
         useRef = true;
         break;
+      case 'B':
+        spo_options.bricks = true;
+        break;
       case 'c': // number of members per team
         team_size = atoi(optarg);
         break;
+      case 'd':
+        adaptive_delay = true;
+        break;
+      case 'D':
+        num_dets = atoi(optarg);
+        break;
+      case 'e':
+        recompute.threshold = atof(optarg);
+        break;
+      case 'f':
+        spline_storage_name = std::string(optarg);
+        break;
+      case 'F':
+        spo_options.spline_file = std::string(optarg);
+        break;
       case 'g': // tiling1 tiling2 tiling3
         sscanf(optarg, "%d %d %d", &na, &nb, &nc);
         break;
@@ -248,24 +312,45 @@ int main(int argc, char** argv)
         nz *= meshfactor;
       }
       break;
+      case 'M':
+        share_splines = true;
+        break;
       case 'n':
         nsteps = atoi(optarg);
         break;
       case 'N':
         nsubsteps = atoi(optarg);
         break;
+      case 'p':
+        pipelined = true;
+        break;
       case 'r':
         accept = atof(optarg);
         break;
+      case 'R':
+        spo_options.numa_replicas = true;
+        break;
       case 's':
         iseed = atoi(optarg);
         break;
       case 't':
         timer_level_name = std::string(optarg);
         break;
+      case 'T':
+        first_touch_name = std::string(optarg);
+        break;
+      case 'u':
+        recompute.period = atoi(optarg);
+        break;
       case 'k':
         delay_rank = atoi(optarg);
         break;
+      case 'K':
+        spline_isa_name = std::string(optarg);
+        break;
+      case 'l':
+        inverse_name = std::string(optarg);
+        break;
       case 'v':
         verbose = true;
         break;
@@ -307,6 +392,85 @@ int main(int argc, char** argv)
     return 1;
   }
 
+  if (!getSplineStorage(spline_storage_name, spo_options.storage))
+  {
+    app_error() << "Spline storage should be 'native', 'fp16' or 'bf16', name given: "
+                << spline_storage_name << endl;
+    return 1;
+  }
+  if (!getFirstTouch(first_touch_name, spo_options.first_touch))
+  {
+    app_error() << "First touch policy should be 'block' or 'interleave', name given: " << first_touch_name
+                << endl;
+    return 1;
+  }
+  if (!getSplineISA(spline_isa_name, spo_options.isa))
+  {
+    app_error() << "Spline kernels should be 'auto', 'portable', 'avx2' or 'avx512', name given: "
+                << spline_isa_name << endl;
+    return 1;
+  }
+  if (!getInverseMethod(inverse_name, inverse_method))
+  {
+    app_error() << "Inverse method should be 'lapack', 'mixed' or 'native', name given: " << inverse_name << endl;
+    return 1;
+  }
+  if (share_splines)
+    spo_options.node_comm = &comm;
+  if (share_splines && spo_options.numa_replicas)
+  {
+    app_error() << "The NUMA node copies of -R are private to each process, they cannot be shared with -M" << endl;
+    return 1;
+  }
+  if (num_dets < 1)
+  {
+    app_error() << "Number of determinants should be positive, given: " << num_dets << endl;
+    return 1;
+  }
+  if (num_dets > 1 && useRef)
+  {
+    app_error() << "Multiple determinants are not supported by the reference implementation" << endl;
+    return 1;
+  }
+  if (recompute.period < 0 || recompute.threshold < 0)
+  {
+    app_error() << "Recompute period and threshold should not be negative, given: " << recompute.period << " "
+                << recompute.threshold << endl;
+    return 1;
+  }
+  if ((recompute.period > 0 || recompute.threshold > 0) && useRef)
+  {
+    app_error() << "Recomputes are not supported by the reference implementation" << endl;
+    return 1;
+  }
+  if (pipelined && all_electron)
+  {
+    app_error() << "Prefetching applies to particle-by-particle moves, not to -A" << endl;
+    return 1;
+  }
+  if ((recompute.period > 0 || recompute.threshold > 0) && all_electron)
+  {
+    app_error() << "All-electron moves recompute the wavefunction at every move, -u and -e do not apply" << endl;
+    return 1;
+  }
+  if (team_size < 1)
+  {
+    app_error() << "Team size should be positive, given: " << team_size << endl;
+    return 1;
+  }
+  if (useRef && team_size > 1)
+  {
+    app_warning() << "Teams are not supported by the reference implementation, using one thread per walker"
+                  << endl;
+    team_size = 1;
+  }
+  // the threads are split in teams, a team moves one walker at a time
+  const int nteams = std::max(1, omp_get_max_threads() / team_size);
+  if (nmovers < 1)
+    nmovers = nteams;
+  if (team_size > 1)
+    omp_set_max_active_levels(2);
+
   TimerManager.set_timer_threshold(timer_level);
   TimerList_t Timers;
   setup_timers(Timers, MiniQMCTimerNames, timer_level_coarse);
@@ -322,6 +486,7 @@ int main(int argc, char** argv)
   print_version(verbose);
 
   SPOSet* spo_main;
+  SPOSet* spo_virtual = nullptr;
   int nTiles = 1;
 
   ParticleSet ions;
@@ -332,13 +497,27 @@ int main(int argc, char** argv)
     build_ions(ions, tmat, lattice_b);
     const int nels = count_electrons(ions, 1);
     const int norb = nels / 2;
-    tileSize       = (tileSize > 0) ? tileSize : norb;
-    nTiles         = norb / tileSize;
+    if (tileSize <= 0)
+    {
+      // the fewest tiles dividing the orbitals that give a tile to each thread of a team
+      nTiles = std::min(team_size, norb);
+      while (norb % nTiles != 0)
+        nTiles++;
+      tileSize = norb / nTiles;
+    }
+    nTiles = norb / tileSize;
+    if (nTiles < team_size)
+    {
+      app_error() << "Each of the " << team_size << " threads of a team needs a spline tile, the tile size "
+                  << tileSize << " gives " << nTiles << endl;
+      return 1;
+    }
 
     number_of_electrons = nels;
 
     const size_t SPO_coeff_size =
-        static_cast<size_t>(norb) * (nx + 3) * (ny + 3) * (nz + 3) * sizeof(RealType);
+        static_cast<size_t>(norb) * (nx + 3) * (ny + 3) * (nz + 3) *
+        (useRef ? sizeof(RealType) : getSplineStorageSize(spo_options.storage));
     const double SPO_coeff_size_MB = SPO_coeff_size * 1.0 / 1024 / 1024;
 
     app_summary() << "Number of orbitals/splines = " << norb << endl
@@ -353,13 +532,53 @@ int main(int argc, char** argv)
 #endif
     app_summary() << "OpenMP threads = " << omp_get_max_threads() << endl;
     app_summary() << "Number of walkers per rank = " << nmovers << endl;
+    app_summary() << "Number of teams = " << nteams << endl;
+    app_summary() << "Threads per team = " << team_size << endl;
 
     app_summary() << "\nSPO coefficients size = " << SPO_coeff_size << " bytes ("
                   << SPO_coeff_size_MB << " MB)" << endl;
+    if (!useRef)
+    {
+      app_summary() << "SPO coefficients storage = " << spline_storage_name << endl;
+      if (share_splines)
+        app_summary() << "SPO coefficients shared by the processes of a node" << endl;
+      if (!spo_options.spline_file.empty())
+        app_summary() << "SPO coefficients file = " << spo_options.spline_file << endl;
+      app_summary() << "SPO coefficients first touch = " << first_touch_name << endl;
+      if (spo_options.numa_replicas)
+        app_summary() << "SPO coefficients replicated per NUMA node" << endl;
+      if (spo_options.bricks)
+        app_summary() << "SPO coefficients stored in Morton-ordered bricks" << endl;
+      app_summary() << "SPO kernels = " << getSplineISAName(spo_options.isa) << endl;
+      app_summary() << "determinant inversion = " << inverse_name << endl;
+    }
     app_summary() << "delayed update rank = " << delay_rank << endl;
-
-
-    spo_main = build_SPOSet(useRef, nx, ny, nz, norb, nTiles, lattice_b);
+    if (adaptive_delay && !useRef)
+      app_summary() << "delayed update rank adapted during the run" << endl;
+    if (recompute.period > 0)
+      app_summary() << "determinants recomputed every " << recompute.period << " steps, staggered over the walkers"
+                    << endl;
+    if (recompute.threshold > 0)
+      app_summary() << "determinants recomputed if the residual of " << recompute.num_rows << " rows exceeds "
+                    << recompute.threshold << endl;
+    if (all_electron)
+      app_summary() << "all electrons moved at once, the wavefunction recomputed at each move" << endl;
+    if (pipelined)
+      app_summary() << "orbitals of the next move prefetched" << endl;
+
+
+    spo_main = build_SPOSet(useRef, nx, ny, nz, norb, nTiles, lattice_b, true, spo_options);
+    if (num_dets > 1)
+    {
+      // the virtual orbitals continue the random table of the occupied ones
+      SPOSetOptions virtual_options = spo_options;
+      virtual_options.spline_file.clear();
+      virtual_options.first_orbital = norb;
+      const int nvirt = std::min(norb, 32);
+      app_summary() << "Number of determinants = " << num_dets << endl
+                    << "Number of virtual orbitals = " << nvirt << endl;
+      spo_virtual = build_SPOSet(useRef, nx, ny, nz, nvirt, 1, lattice_b, true, virtual_options);
+    }
     Timers[Timer_Setup]->stop();
   }
 
@@ -376,22 +595,40 @@ int main(int argc, char** argv)
   Timers[Timer_Init]->start();
   std::vector<Mover*> mover_list(nmovers, nullptr);
 // prepare movers
-  #pragma omp parallel for
+  #pragma omp parallel for num_threads(nteams)
   for (int iw = 0; iw < nmovers; iw++)
   {
-    const int ip        = omp_get_thread_num();
-    const int member_id = ip % team_size;
+    const int ip = omp_get_thread_num();
+    if (team_size > 1)
+      omp_set_num_threads(team_size);
 
     // create and initialize movers
     Mover* thiswalker = new Mover(myPrimes[ip], ions);
     mover_list[iw]    = thiswalker;
 
-    // create wavefunction per mover
-    build_WaveFunction(useRef, spo_main, thiswalker->wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3);
+    // create wavefunction per mover, the recomputes of the walkers are staggered
+    RecomputePolicy walker_recompute = recompute;
+    walker_recompute.offset         = iw;
+    build_WaveFunction(useRef, spo_main, thiswalker->wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3, team_size, adaptive_delay, inverse_method, spo_virtual, num_dets, walker_recompute);
+    if (all_electron)
+      build_WaveFunction(useRef, spo_main, thiswalker->trial_wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3, team_size, adaptive_delay, inverse_method, spo_virtual, num_dets, walker_recompute);
 
     // initial computing
     thiswalker->els.update();
-    thiswalker->wavefunction.evaluateLog(thiswalker->els);
+  }
+
+  // initial computing, the walkers of a team together so that their inversions are batched
+  #pragma omp parallel for num_threads(nteams)
+  for (int team = 0; team < nteams; team++)
+  {
+    if (team_size > 1)
+      omp_set_num_threads(team_size);
+    int first, last;
+    FairDivideLow(nmovers, nteams, team, first, last);
+    if (first == last)
+      continue;
+    const std::vector<Mover*> Sub_list(extract_sub_list(mover_list, first, last));
+    mover_list[first]->wavefunction.flex_evaluateLog(extract_wf_list(Sub_list), extract_els_list(Sub_list));
   }
   Timers[Timer_Init]->stop();
 
@@ -405,16 +642,24 @@ int main(int argc, char** argv)
   int my_accepted = 0;
   for (int mc = 0; mc < nsteps; ++mc)
   {
-    #pragma omp parallel for reduction(+:my_accepted)
+    #pragma omp parallel for num_threads(nteams) reduction(+:my_accepted)
     for (int iw = 0; iw < nmovers; iw++)
     {
+      // nested regions, the spline evaluation and the delayed update, run on the team
+      if (team_size > 1)
+        omp_set_num_threads(team_size);
+
       auto& els          = mover_list[iw]->els;
       auto& random_th    = mover_list[iw]->rng;
       auto& wavefunction = mover_list[iw]->wavefunction;
+      auto& trial        = mover_list[iw]->trial_wavefunction;
       auto& ecp          = mover_list[iw]->nlpp;
 
       ParticlePos_t delta(nels);
       ParticlePos_t rOnSphere(nknots);
+      ParticlePos_t R_old;
+      ParticleSet::ParticleGradient_t G_old;
+      ParticleSet::ParticleLaplacian_t L_old;
 
       aligned_vector<RealType> ur(nels);
 
@@ -423,6 +668,35 @@ int main(int argc, char** argv)
       {
         random_th.generate_uniform(ur.data(), nels);
         random_th.generate_normal(&delta[0][0], nels3);
+        if (all_electron)
+        {
+          // move all the electrons, the trial wavefunction is recomputed with one LU per determinant
+          R_old = els.R;
+          G_old = els.G;
+          L_old = els.L;
+          for (int iel = 0; iel < nels; ++iel)
+            els.R[iel] += delta[iel];
+          els.update();
+          Timers[Timer_Recompute]->start();
+          trial.recompute(els);
+          Timers[Timer_Recompute]->stop();
+          if (ur[0] < accept)
+          {
+            wavefunction.swap(trial);
+            my_accepted += nels;
+          }
+          else
+          {
+            // a rejected move keeps the wavefunction of the old positions
+            els.R = R_old;
+            els.G = G_old;
+            els.L = L_old;
+            els.update();
+          }
+          continue;
+        }
+        if (pipelined)
+          wavefunction.prefetch(0, els.R[0] + delta[0]);
         for (int iel = 0; iel < nels; ++iel)
         {
           // Operate on electron with index iel
@@ -441,6 +715,10 @@ int main(int argc, char** argv)
           wavefunction.ratioGrad(els, iel, grad_new);
           Timers[Timer_ratioGrad]->stop();
 
+          // the next proposed position is known, its orbitals load during the update
+          if (pipelined && iel + 1 < nels)
+            wavefunction.prefetch(iel + 1, els.R[iel + 1] + delta[iel + 1]);
+
           // Accept/reject the trial move
           if (ur[iel] < accept) // MC
           {
@@ -462,8 +740,9 @@ int main(int argc, char** argv)
 
       els.donePbyP();
 
-      // evaluate Kinetic Energy
-      wavefunction.evaluateGL(els);
+      // evaluate Kinetic Energy, done by the recomputes of the all-electron moves
+      if (!all_electron)
+        wavefunction.evaluateGL(els);
 
       Timers[Timer_Diffusion]->stop();
 
@@ -499,12 +778,30 @@ int main(int argc, char** argv)
   } // nsteps
   Timers[Timer_Total]->stop();
 
+  RecomputeStats recompute_stats;
+  for (int iw = 0; iw < nmovers; iw++)
+    mover_list[iw]->wavefunction.getRecomputeStats(recompute_stats);
+  if (inverse_method == InverseMethod::mixed)
+    app_summary() << "\nLargest residual of the mixed precision inversions = "
+                  << recompute_stats.max_inverse_residual << endl;
+  if (recompute.period > 0 || recompute.threshold > 0)
+  {
+    app_summary() << "\nDeterminant recomputes = " << recompute_stats.scheduled + recompute_stats.triggered << " ("
+                  << recompute_stats.scheduled << " scheduled, " << recompute_stats.triggered << " by the residual)"
+                  << endl;
+    if (recompute.threshold > 0)
+      app_summary() << "Residual checks = " << recompute_stats.checks
+                    << ", largest residual = " << recompute_stats.max_residual << endl;
+    app_summary() << "Largest drift of log|det| found by a recompute = " << recompute_stats.max_drift << endl;
+  }
+
   // free all movers
   #pragma omp parallel for
   for (int iw = 0; iw < nmovers; iw++)
     delete mover_list[iw];
   mover_list.clear();
   delete spo_main;
+  delete spo_virtual;
 
   if (comm.root())
   {
@@ -0,0 +1,468 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/** @file miniqmc_autotune.cpp
+ * @brief Offline tuning of the performance options of miniqmc.
+ *
+ * Runs short trials of miniqmc or miniqmc_sync_move over the number of threads,
+ * the team or batch size (-c), the walkers (-w), the tile size (-a) and the
+ * delayed update rank (-k), and saves the options with the best "Total
+ * throughput" in a file the drivers load with -L.
+ *
+ * The space is searched one parameter at a time, starting from the defaults of
+ * the driver. The values of a parameter are tried outwards from the current one
+ * and a direction is abandoned after two trials slower than the best, assuming
+ * the throughput has a single maximum along each parameter. The sweeps are
+ * repeated until no parameter changes. The throughput is not normalized by the
+ * number of steps, so every trial runs the same steps, chosen from a one step
+ * calibration run for the defaults to last about the requested time. Under MPI
+ * only the root runs the trials, without the variables of the MPI launcher so
+ * that a trial built with MPI starts as a singleton, and broadcasts the best
+ * options.
+ */
+#include <Utilities/Configuration.h>
+#include <Utilities/Communicate.h>
+#include <Utilities/qmcpack_version.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <getopt.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace qmcplusplus;
+
+void print_help()
+{
+  // clang-format off
+  app_summary() << "usage:" << '\n';
+  app_summary() << "  miniqmc_autotune [-hvV] [-d driver] [-g \"n0 n1 n2\"] [-m meshfactor]" << '\n';
+  app_summary() << "                   [-e \"options\"] [-t \"threads\"] [-T seconds]"        << '\n';
+  app_summary() << "                   [-b trials] [-o file]"                               << '\n';
+  app_summary() << "options:"                                                          << '\n';
+  app_summary() << "  -b  maximal number of trials        default: 100"                << '\n';
+  app_summary() << "  -d  miniqmc or miniqmc_sync_move    default: miniqmc"            << '\n';
+  app_summary() << "  -e  other options of the trials     default: none"               << '\n';
+  app_summary() << "  -g  set the 3D tiling.              default: 1 1 1"              << '\n';
+  app_summary() << "  -h  print help and exit"                                         << '\n';
+  app_summary() << "  -m  meshfactor                      default: 1.0"                << '\n';
+  app_summary() << "  -o  file of the best options        default: miniqmc.opt"        << '\n';
+  app_summary() << "  -t  numbers of threads to try       default: powers of 2"        << '\n';
+  app_summary() << "  -T  target seconds per trial        default: 2"                  << '\n';
+  app_summary() << "  -v  verbose output"                                              << '\n';
+  app_summary() << "  -V  print version information and exit"                          << '\n';
+  // clang-format on
+
+  exit(1); // print help and exit
+}
+
+/// the tuned parameters
+enum TunedParameter
+{
+  Param_Threads,
+  Param_Team,
+  Param_Walkers,
+  Param_Tile,
+  Param_Delay,
+  Num_Params,
+};
+
+/// names in the report, in the order of TunedParameter
+const char* ParamNames[Num_Params] = {"threads", "c", "walkers per worker", "tile size", "delay rank"};
+
+/** a point of the search space
+ *
+ * The walkers are counted per worker, a team of miniqmc or a thread of
+ * miniqmc_sync_move moving a batch of c walkers, so that they stay a multiple of
+ * the workers when the threads or c change.
+ */
+using TrialConfig = std::array<int, Num_Params>;
+
+/// a run of the driver
+struct TrialResult
+{
+  bool ok = false;
+  int norb = 0, nels = 0;
+  double throughput = 0.0;
+};
+
+class AutoTuner
+{
+public:
+  std::string driver_path;
+  /// true for miniqmc_sync_move, c is the walkers per batch instead of the team size
+  bool sync_move = false;
+  /// options of every trial
+  std::string common_options;
+  std::vector<int> thread_counts;
+  double target_seconds = 2.0;
+  int max_trials        = 100;
+  int norb = 0, nels = 0;
+  /// "env -u ..." removing the variables of the MPI launcher, a trial would join the job of this process
+  std::string launcher_unset;
+
+  /// collect the variables set by mpirun in the environment of this process
+  void find_launcher_variables()
+  {
+    const std::array<std::string, 4> prefixes{"OMPI_", "PMIX_", "PMI_", "OPAL_"};
+    std::ostringstream os;
+    for (char** var = environ; *var != nullptr; var++)
+    {
+      const std::string entry(*var);
+      const size_t eq = entry.find('=');
+      for (const std::string& prefix : prefixes)
+        if (eq != std::string::npos && entry.compare(0, prefix.size(), prefix) == 0)
+        {
+          os << " -u " << entry.substr(0, eq);
+          break;
+        }
+    }
+    launcher_unset = os.str().empty() ? "" : "env" + os.str() + " ";
+  }
+
+  /// number of walkers of the driver
+  int walkers(const TrialConfig& config) const
+  {
+    const int workers = sync_move ? config[Param_Threads] * config[Param_Team]
+                                  : std::max(1, config[Param_Threads] / config[Param_Team]);
+    return workers * config[Param_Walkers];
+  }
+
+  /// command line options of a configuration
+  std::string options(const TrialConfig& config) const
+  {
+    std::ostringstream os;
+    os << "-w " << walkers(config) << " -c " << config[Param_Team] << " -a " << config[Param_Tile] << " -k "
+       << config[Param_Delay];
+    return os.str();
+  }
+
+  /// run the driver with nsteps steps
+  TrialResult run(const TrialConfig& config, int nsteps) const
+  {
+    std::ostringstream cmd;
+    cmd << launcher_unset << "OMP_NUM_THREADS=" << config[Param_Threads] << " " << driver_path << " "
+        << common_options << " -n " << nsteps;
+    if (config[Param_Tile] > 0)
+      cmd << " " << options(config);
+    cmd << " 2>&1";
+    app_debug() << "  " << cmd.str() << std::endl;
+
+    TrialResult result;
+    FILE* pipe = popen(cmd.str().c_str(), "r");
+    if (pipe == nullptr)
+      return result;
+    char line[1024];
+    while (fgets(line, sizeof(line), pipe) != nullptr)
+    {
+      const std::string text(line);
+      const size_t eq = text.find("= ");
+      if (eq == std::string::npos)
+        continue;
+      if (text.compare(0, 26, "Number of orbitals/splines") == 0)
+        result.norb = std::atoi(text.c_str() + eq + 2);
+      else if (text.compare(0, 19, "Number of electrons") == 0)
+        result.nels = std::atoi(text.c_str() + eq + 2);
+      else if (text.compare(0, 16, "Total throughput") == 0)
+      {
+        result.throughput = std::atof(text.c_str() + eq + 2);
+        result.ok         = std::isfinite(result.throughput) && result.throughput > 0;
+      }
+    }
+    if (pclose(pipe) != 0)
+      result.ok = false;
+    return result;
+  }
+
+  /// the values of a parameter allowed with the others of config, in increasing order
+  std::vector<int> candidates(int param, const TrialConfig& config) const
+  {
+    std::vector<int> values;
+    switch (param)
+    {
+    case Param_Threads:
+      values = thread_counts;
+      break;
+    case Param_Team:
+      // a team can not be larger than the threads, batches are tried up to 16 walkers
+      for (int c = 1; c <= (sync_move ? 16 : config[Param_Threads]); c *= 2)
+        values.push_back(c);
+      break;
+    case Param_Walkers:
+      values = {1, 2, 4, 8};
+      break;
+    case Param_Tile:
+      // divisors of the orbitals filling whole SIMD registers
+      for (int tile = 8; tile <= norb; tile += 8)
+        if (norb % tile == 0)
+          values.push_back(tile);
+      if (values.empty() || values.back() != norb)
+        values.push_back(norb);
+      break;
+    case Param_Delay:
+      for (int delay = 4; delay < norb; delay *= 2)
+        values.push_back(delay);
+      values.push_back(norb);
+      break;
+    }
+    return values;
+  }
+
+  /// throughput of a configuration, measured once
+  double measure(const TrialConfig& config)
+  {
+    auto it = measured.find(config);
+    if (it != measured.end())
+      return it->second;
+    if (static_cast<int>(measured.size()) >= max_trials)
+      return 0.0;
+    const TrialResult trial = run(config, nsteps);
+    const double throughput = trial.ok ? trial.throughput : 0.0;
+    measured[config]        = throughput;
+    app_log() << "trial " << measured.size() << ": OMP_NUM_THREADS=" << config[Param_Threads] << " "
+              << options(config) << "  throughput = " << throughput
+              << (trial.ok ? "" : "  (failed)") << std::endl;
+    return throughput;
+  }
+
+  /** tune the parameters one at a time until none changes
+   * @return false if the driver did not run with its defaults
+   */
+  bool tune(TrialConfig& best)
+  {
+    // the defaults of the driver give the system size and the first throughput
+    TrialConfig defaults{thread_counts.back(), 1, 1, 0, 0};
+    const TrialResult calibration = run(defaults, 1);
+    if (!calibration.ok || calibration.nels == 0)
+      return false;
+    norb = calibration.norb;
+    nels = calibration.nels;
+    // the defaults move one walker per thread
+    const double step_seconds = thread_counts.back() * std::pow(double(nels), 3) / calibration.throughput;
+    nsteps = static_cast<int>(std::min(100.0, std::max(1.0, std::round(target_seconds / step_seconds))));
+    app_summary() << "Calibration: " << norb << " orbitals, " << nels << " electrons, " << step_seconds
+                  << " seconds per step, trials of " << nsteps << " steps" << std::endl;
+
+    best            = {thread_counts.back(), 1, 1, norb, std::min(32, norb)};
+    best_throughput = measure(best);
+    if (best_throughput == 0.0)
+      return false;
+
+    bool changed = true;
+    while (changed && static_cast<int>(measured.size()) < max_trials)
+    {
+      changed = false;
+      for (int param = 0; param < Num_Params; param++)
+      {
+        const std::vector<int> values = candidates(param, best);
+        const int size  = values.size();
+        const int lower = std::lower_bound(values.begin(), values.end(), best[param]) - values.begin();
+        // the current value may not be a candidate, e.g. a team size after the threads changed
+        const int upper = (lower < size && values[lower] == best[param]) ? lower + 1 : lower;
+        int best_value  = best[param];
+        for (int dir : {1, -1})
+        {
+          int slower = 0;
+          for (int i = dir > 0 ? upper : lower - 1; i >= 0 && i < size && slower < 2; i += dir)
+          {
+            TrialConfig trial = best;
+            trial[param]      = values[i];
+            if (param == Param_Threads)
+              trial[Param_Team] = sync_move ? trial[Param_Team] : std::min(trial[Param_Team], values[i]);
+            const double throughput = measure(trial);
+            // ignore gains within the noise of a single short trial
+            if (throughput > best_throughput * (1 + noise))
+            {
+              best_throughput = throughput;
+              best_value      = values[i];
+              slower          = 0;
+            }
+            else
+              slower++;
+          }
+        }
+        if (best_value != best[param])
+        {
+          app_log() << "  " << ParamNames[param] << ": " << best[param] << " -> " << best_value << std::endl;
+          best[param] = best_value;
+          if (param == Param_Threads && !sync_move)
+            best[Param_Team] = std::min(best[Param_Team], best_value);
+          changed = true;
+        }
+      }
+    }
+    return true;
+  }
+
+  double best_throughput = 0.0;
+  /// steps of every trial
+  int nsteps = 1;
+  int num_trials() const { return measured.size(); }
+
+private:
+  /// relative gain required to change a parameter
+  const double noise = 0.02;
+  std::map<TrialConfig, double> measured;
+};
+
+int main(int argc, char** argv)
+{
+  Communicate comm(argc, argv);
+
+  AutoTuner tuner;
+  std::string driver      = "miniqmc";
+  std::string tiling      = "1 1 1";
+  std::string meshfactor  = "1.0";
+  std::string extra;
+  std::string output_name = "miniqmc.opt";
+  bool verbose            = false;
+
+  if (!comm.root())
+  {
+    outputManager.shutOff();
+  }
+
+  int opt;
+  while (optind < argc)
+  {
+    if ((opt = getopt(argc, argv, "hvVb:d:e:g:m:o:t:T:")) != -1)
+    {
+      switch (opt)
+      {
+      case 'b':
+        tuner.max_trials = atoi(optarg);
+        break;
+      case 'd':
+        driver = optarg;
+        break;
+      case 'e':
+        extra = optarg;
+        break;
+      case 'g':
+        tiling = optarg;
+        break;
+      case 'h':
+        print_help();
+        break;
+      case 'm':
+        meshfactor = optarg;
+        break;
+      case 'o':
+        output_name = optarg;
+        break;
+      case 't':
+      {
+        std::istringstream is(optarg);
+        int nt;
+        while (is >> nt)
+          tuner.thread_counts.push_back(nt);
+      }
+      break;
+      case 'T':
+        tuner.target_seconds = atof(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'V':
+        print_version(true);
+        return 1;
+        break;
+      default:
+        print_help();
+      }
+    }
+    else // disallow non-option arguments
+    {
+      app_error() << "Non-option arguments not allowed" << endl;
+      print_help();
+    }
+  }
+
+  if (comm.root())
+  {
+    if (verbose)
+      outputManager.setVerbosity(Verbosity::HIGH);
+    else
+      outputManager.setVerbosity(Verbosity::LOW);
+  }
+
+  print_version(verbose);
+
+  // the drivers are installed next to this one
+  const std::string self(argv[0]);
+  const size_t slash = self.rfind('/');
+  if (driver.find('/') != std::string::npos || slash == std::string::npos)
+    tuner.driver_path = driver;
+  else
+    tuner.driver_path = self.substr(0, slash + 1) + driver;
+  tuner.sync_move = driver.size() >= 17 && driver.compare(driver.size() - 17, 17, "miniqmc_sync_move") == 0;
+
+  if (tuner.thread_counts.empty())
+  {
+    for (int nt = 1; nt < omp_get_max_threads(); nt *= 2)
+      tuner.thread_counts.push_back(nt);
+    tuner.thread_counts.push_back(omp_get_max_threads());
+  }
+  std::sort(tuner.thread_counts.begin(), tuner.thread_counts.end());
+  if (tuner.thread_counts.front() < 1 || tuner.max_trials < 1 || tuner.target_seconds <= 0)
+  {
+    app_error() << "The threads, trials and seconds per trial must be positive" << std::endl;
+    return 1;
+  }
+
+  tuner.common_options = "-g '" + tiling + "' -m " + meshfactor + " " + extra;
+  tuner.find_launcher_variables();
+
+  // only the root runs the trials, the sweeps of several ranks would compete for the cores
+  TrialConfig best{};
+  int tuned = 0;
+  if (comm.root())
+    tuned = tuner.tune(best);
+  comm.bcast(&tuned, 1);
+  if (!tuned)
+  {
+    app_error() << "Failed to run " << tuner.driver_path << " " << tuner.common_options << std::endl;
+    return 1;
+  }
+  comm.bcast(best.data(), Num_Params);
+  comm.bcast(&tuner.nsteps, 1);
+  comm.bcast(tuner.best_throughput);
+
+  app_summary() << "Best of " << tuner.num_trials() << " trials: OMP_NUM_THREADS=" << best[Param_Threads] << " "
+                << tuner.options(best) << std::endl;
+  app_summary() << "Total throughput = " << tuner.best_throughput << " with " << tuner.nsteps << " steps" << std::endl;
+
+  if (comm.root())
+  {
+    std::ofstream fout(output_name);
+    fout << "# " << driver << " options tuned by miniqmc_autotune in " << tuner.num_trials() << " trials" << '\n';
+    fout << "# Total throughput = " << tuner.best_throughput << " with " << tuner.nsteps << " steps" << '\n';
+    fout << "# load with: " << driver << " -L " << output_name << '\n';
+    fout << "OMP_NUM_THREADS=" << best[Param_Threads] << '\n';
+    fout << "-g \"" << tiling << "\" -m " << meshfactor << '\n';
+    if (!extra.empty())
+      fout << extra << '\n';
+    fout << tuner.options(best) << '\n';
+    if (!fout)
+    {
+      app_error() << "Failed to write " << output_name << std::endl;
+      return 1;
+    }
+    app_summary() << "Options saved in " << output_name << std::endl;
+  }
+
+  return 0;
+}
@@ -111,6 +111,7 @@
 #include <Utilities/XMLWriter.h>
 #include <Utilities/RandomGenerator.h>
 #include <Utilities/qmcpack_version.h>
+#include <Utilities/OptionFile.h>
 #include <Input/Input.hpp>
 #include <QMCWaveFunctions/SPOSet.h>
 #include <QMCWaveFunctions/SPOSet_builder.h>
@@ -131,6 +132,7 @@ enum MiniQMCTimers
   Timer_evalGrad,
   Timer_ratioGrad,
   Timer_Update,
+  Timer_Recompute,
   Timer_Setup,
 };
 
@@ -143,6 +145,7 @@ TimerNameList_t<MiniQMCTimers> MiniQMCTimerNames = {
     {Timer_evalGrad, "Current Gradient"},
     {Timer_ratioGrad, "New Gradient"},
     {Timer_Update, "Update"},
+    {Timer_Recompute, "All-electron recompute"},
     {Timer_Setup, "Setup"},
 };
 
@@ -150,26 +153,44 @@ void print_help()
 {
   // clang-format off
   app_summary() << "usage:" << '\n';
-  app_summary() << "  miniqmc   [-bhjPvV] [-g \"n0 n1 n2\"] [-m meshfactor]"     << '\n';
+  app_summary() << "  miniqmc   [-AbdhjPvV] [-g \"n0 n1 n2\"] [-m meshfactor]"   << '\n';
   app_summary() << "            [-n steps] [-N substeps] [-x rmax]"              << '\n';
   app_summary() << "            [-r AcceptanceRatio] [-s seed] [-w walkers]"     << '\n';
   app_summary() << "            [-a tile_size] [-t timer_level] [-c nw_b]"       << '\n';
-  app_summary() << "            [-k delay_rank]"                                 << '\n';
+  app_summary() << "            [-k delay_rank] [-f storage] [-M]"               << '\n';
+  app_summary() << "            [-F file] [-T policy] [-R] [-B] [-K kernels]"    << '\n';
+  app_summary() << "            [-L file] [-l inverse] [-D num_dets]"            << '\n';
+  app_summary() << "            [-u period] [-e threshold]"                      << '\n';
   app_summary() << "options:"                                                    << '\n';
   app_summary() << "  -a  size of each spline tile       default: num of orbs"   << '\n';
+  app_summary() << "  -A  move all electrons at once     default: off"           << '\n';
   app_summary() << "  -b  use reference implementations  default: off"           << '\n';
+  app_summary() << "  -B  splines in Morton bricks       default: off"           << '\n';
   app_summary() << "  -c  number of walkers per batch    default: 1"             << '\n';
+  app_summary() << "  -d  adapt the delay rank up to -k  default: off"           << '\n';
+  app_summary() << "  -D  number of determinants         default: 1"             << '\n';
+  app_summary() << "  -e  recompute if residual exceeds  default: 0 (no check)"  << '\n';
+  app_summary() << "      useful above ~1e-5 mixed, ~1e-12 full precision"       << '\n';
+  app_summary() << "  -f  coefficients: native,fp16,bf16 default: native"        << '\n';
+  app_summary() << "  -F  spline file, made if missing   default: none"          << '\n';
   app_summary() << "  -g  set the 3D tiling.             default: 1 1 1"         << '\n';
   app_summary() << "  -h  print help and exit"                                   << '\n';
   app_summary() << "  -j  enable three body Jastrow      default: off"           << '\n';
   app_summary() << "  -m  meshfactor                     default: 1.0"           << '\n';
+  app_summary() << "  -M  share spline table in a node   default: off"           << '\n';
   app_summary() << "  -n  number of MC steps             default: 5"             << '\n';
   app_summary() << "  -N  number of MC substeps          default: 1"             << '\n';
   app_summary() << "  -P  not running pseudo potential   default: off"           << '\n';
   app_summary() << "  -r  set the acceptance ratio.      default: 0.5"           << '\n';
+  app_summary() << "  -R  spline table per NUMA node     default: off"           << '\n';
   app_summary() << "  -s  set the random seed.           default: 11"            << '\n';
   app_summary() << "  -t  timer level: coarse or fine    default: fine"          << '\n';
+  app_summary() << "  -T  first touch: block,interleave  default: block"         << '\n';
+  app_summary() << "  -u  steps between the recomputes   default: 0 (never)"     << '\n';
   app_summary() << "  -k  matrix delayed update rank     default: 32"            << '\n';
+  app_summary() << "  -l  inverse: lapack,mixed,native   default: lapack"        << '\n';
+  app_summary() << "  -L  file of options, see autotune  default: none"          << '\n';
+  app_summary() << "  -K  kernels: portable,avx2,avx512  default: auto"          << '\n';
   app_summary() << "  -v  verbose output"                                        << '\n';
   app_summary() << "  -V  print version information and exit"                    << '\n';
   app_summary() << "  -w  number of walker(movers)       default: num of threads"<< '\n';
@@ -181,6 +202,7 @@ int main(int argc, char** argv)
 {
   // clang-format off
   typedef QMCTraits::RealType           RealType;
+  typedef ParticleSet::ParticlePos_t    ParticlePos_t;
   typedef ParticleSet::PosType          PosType;
   typedef ParticleSet::GradType         GradType;
   typedef ParticleSet::ValueType        ValueType;
@@ -206,36 +228,75 @@ int main(int argc, char** argv)
   RealType Rmax(1.7);
   RealType accept  = 0.5;
   int delay_rank = 32;
+  int num_dets   = 1;
+  RecomputePolicy recompute;
   bool useRef   = false;
   bool enableJ3 = false;
+  bool adaptive_delay = false;
+  bool all_electron   = false;
   bool run_pseudo = true;
 
   PrimeNumberSet<uint32_t> myPrimes;
 
   bool verbose                 = false;
   std::string timer_level_name = "fine";
+  std::string spline_storage_name = "native";
+  std::string first_touch_name    = "block";
+  std::string spline_isa_name     = "auto";
+  std::string inverse_name        = "lapack";
+  InverseMethod inverse_method    = InverseMethod::lapack;
+  SPOSetOptions spo_options;
+  bool share_splines = false;
 
   if (!comm.root())
   {
     outputManager.shutOff();
   }
 
+  // insert the options of a file given by -L, e.g. written by miniqmc_autotune
+  OptionArgs option_args(argc, argv);
+  if (!option_args.valid())
+    return 1;
+  argc = option_args.argc();
+  argv = option_args.argv();
+
   int opt;
   while (optind < argc)
   {
-    if ((opt = getopt(argc, argv, "bhjPvVa:c:g:m:n:N:r:s:t:k:w:x:")) != -1)
+    if ((opt = getopt(argc, argv, "AbBdhjPvVMa:c:D:e:f:F:g:m:n:N:r:Rs:t:T:u:k:K:l:w:x:")) != -1)
     {
       switch (opt)
       {
+      case 'A':
+        all_electron = true;
+        break;
       case 'a':
         tileSize = atoi(optarg);
         break;
       case 'b':
         useRef = true;
         break;
+      case 'B':
+        spo_options.bricks = true;
+        break;
       case 'c': // number of walkers per batch
         nw_b = atoi(optarg);
         break;
+      case 'd':
+        adaptive_delay = true;
+        break;
+      case 'D':
+        num_dets = atoi(optarg);
+        break;
+      case 'e':
+        recompute.threshold = atof(optarg);
+        break;
+      case 'f':
+        spline_storage_name = std::string(optarg);
+        break;
+      case 'F':
+        spo_options.spline_file = std::string(optarg);
+        break;
       case 'g': // tiling1 tiling2 tiling3
         sscanf(optarg, "%d %d %d", &na, &nb, &nc);
         break;
@@ -254,6 +315,9 @@ int main(int argc, char** argv)
         nz *= meshfactor;
       }
       break;
+      case 'M':
+        share_splines = true;
+        break;
       case 'n':
         nsteps = atoi(optarg);
         break;
@@ -266,15 +330,30 @@ int main(int argc, char** argv)
       case 'r':
         accept = atof(optarg);
         break;
+      case 'R':
+        spo_options.numa_replicas = true;
+        break;
       case 's':
         iseed = atoi(optarg);
         break;
       case 't':
         timer_level_name = std::string(optarg);
         break;
+      case 'T':
+        first_touch_name = std::string(optarg);
+        break;
+      case 'u':
+        recompute.period = atoi(optarg);
+        break;
       case 'k':
         delay_rank = atoi(optarg);
         break;
+      case 'K':
+        spline_isa_name = std::string(optarg);
+        break;
+      case 'l':
+        inverse_name = std::string(optarg);
+        break;
       case 'v':
         verbose = true;
         break;
@@ -323,6 +402,63 @@ int main(int argc, char** argv)
     return 1;
   }
 
+  if (!getSplineStorage(spline_storage_name, spo_options.storage))
+  {
+    app_error() << "Spline storage should be 'native', 'fp16' or 'bf16', name given: "
+                << spline_storage_name << endl;
+    return 1;
+  }
+  if (!getFirstTouch(first_touch_name, spo_options.first_touch))
+  {
+    app_error() << "First touch policy should be 'block' or 'interleave', name given: " << first_touch_name
+                << endl;
+    return 1;
+  }
+  if (!getSplineISA(spline_isa_name, spo_options.isa))
+  {
+    app_error() << "Spline kernels should be 'auto', 'portable', 'avx2' or 'avx512', name given: "
+                << spline_isa_name << endl;
+    return 1;
+  }
+  if (!getInverseMethod(inverse_name, inverse_method))
+  {
+    app_error() << "Inverse method should be 'lapack', 'mixed' or 'native', name given: " << inverse_name << endl;
+    return 1;
+  }
+  if (share_splines)
+    spo_options.node_comm = &comm;
+  if (share_splines && spo_options.numa_replicas)
+  {
+    app_error() << "The NUMA node copies of -R are private to each process, they cannot be shared with -M" << endl;
+    return 1;
+  }
+  if (num_dets < 1)
+  {
+    app_error() << "Number of determinants should be positive, given: " << num_dets << endl;
+    return 1;
+  }
+  if (num_dets > 1 && useRef)
+  {
+    app_error() << "Multiple determinants are not supported by the reference implementation" << endl;
+    return 1;
+  }
+  if (recompute.period < 0 || recompute.threshold < 0)
+  {
+    app_error() << "Recompute period and threshold should not be negative, given: " << recompute.period << " "
+                << recompute.threshold << endl;
+    return 1;
+  }
+  if ((recompute.period > 0 || recompute.threshold > 0) && useRef)
+  {
+    app_error() << "Recomputes are not supported by the reference implementation" << endl;
+    return 1;
+  }
+  if ((recompute.period > 0 || recompute.threshold > 0) && all_electron)
+  {
+    app_error() << "All-electron moves recompute the wavefunction at every move, -u and -e do not apply" << endl;
+    return 1;
+  }
+
   TimerManager.set_timer_threshold(timer_level);
   TimerList_t Timers;
   setup_timers(Timers, MiniQMCTimerNames, timer_level_coarse);
@@ -338,6 +474,7 @@ int main(int argc, char** argv)
   print_version(verbose);
 
   SPOSet* spo_main;
+  SPOSet* spo_virtual = nullptr;
   int nTiles = 1;
 
   ParticleSet ions;
@@ -354,7 +491,8 @@ int main(int argc, char** argv)
     number_of_electrons = nels;
 
     const size_t SPO_coeff_size =
-        static_cast<size_t>(norb) * (nx + 3) * (ny + 3) * (nz + 3) * sizeof(RealType);
+        static_cast<size_t>(norb) * (nx + 3) * (ny + 3) * (nz + 3) *
+        (useRef ? sizeof(RealType) : getSplineStorageSize(spo_options.storage));
     const double SPO_coeff_size_MB = SPO_coeff_size * 1.0 / 1024 / 1024;
 
     app_summary() << "Number of orbitals/splines = " << norb << endl
@@ -373,9 +511,45 @@ int main(int argc, char** argv)
 
     app_summary() << "\nSPO coefficients size = " << SPO_coeff_size << " bytes ("
                   << SPO_coeff_size_MB << " MB)" << endl;
+    if (!useRef)
+    {
+      app_summary() << "SPO coefficients storage = " << spline_storage_name << endl;
+      if (share_splines)
+        app_summary() << "SPO coefficients shared by the processes of a node" << endl;
+      if (!spo_options.spline_file.empty())
+        app_summary() << "SPO coefficients file = " << spo_options.spline_file << endl;
+      app_summary() << "SPO coefficients first touch = " << first_touch_name << endl;
+      if (spo_options.numa_replicas)
+        app_summary() << "SPO coefficients replicated per NUMA node" << endl;
+      if (spo_options.bricks)
+        app_summary() << "SPO coefficients stored in Morton-ordered bricks" << endl;
+      app_summary() << "SPO kernels = " << getSplineISAName(spo_options.isa) << endl;
+      app_summary() << "determinant inversion = " << inverse_name << endl;
+    }
     app_summary() << "delayed update rank = " << delay_rank << endl;
-
-    spo_main = build_SPOSet(useRef, nx, ny, nz, norb, nTiles, lattice_b);
+    if (adaptive_delay && !useRef)
+      app_summary() << "delayed update rank adapted during the run" << endl;
+    if (recompute.period > 0)
+      app_summary() << "determinants recomputed every " << recompute.period << " steps, staggered over the walkers"
+                    << endl;
+    if (recompute.threshold > 0)
+      app_summary() << "determinants recomputed if the residual of " << recompute.num_rows << " rows exceeds "
+                    << recompute.threshold << endl;
+    if (all_electron)
+      app_summary() << "all electrons moved at once, the wavefunction recomputed at each move" << endl;
+
+    spo_main = build_SPOSet(useRef, nx, ny, nz, norb, nTiles, lattice_b, true, spo_options);
+    if (num_dets > 1)
+    {
+      // the virtual orbitals continue the random table of the occupied ones
+      SPOSetOptions virtual_options = spo_options;
+      virtual_options.spline_file.clear();
+      virtual_options.first_orbital = norb;
+      const int nvirt = std::min(norb, 32);
+      app_summary() << "Number of determinants = " << num_dets << endl
+                    << "Number of virtual orbitals = " << nvirt << endl;
+      spo_virtual = build_SPOSet(useRef, nx, ny, nz, nvirt, 1, lattice_b, true, virtual_options);
+    }
     Timers[Timer_Setup]->stop();
   }
 
@@ -400,8 +574,12 @@ int main(int argc, char** argv)
     Mover* thiswalker = new Mover(myPrimes[iw], ions);
     mover_list[iw]    = thiswalker;
 
-    // create wavefunction per mover
-    build_WaveFunction(useRef, spo_main, thiswalker->wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3);
+    // create wavefunction per mover, the recomputes of the walkers are staggered
+    RecomputePolicy walker_recompute = recompute;
+    walker_recompute.offset         = iw;
+    build_WaveFunction(useRef, spo_main, thiswalker->wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3, 1, adaptive_delay, inverse_method, spo_virtual, num_dets, walker_recompute);
+    if (all_electron)
+      build_WaveFunction(useRef, spo_main, thiswalker->trial_wavefunction, ions, thiswalker->els, thiswalker->rng, delay_rank, enableJ3, 1, adaptive_delay, inverse_method, spo_virtual, num_dets, walker_recompute);
 
     // initialize virtual particle sets
     thiswalker->nlpp.initialize_VPs(ions, thiswalker->els, Rmax);
@@ -454,10 +632,48 @@ int main(int argc, char** argv)
       aligned_vector<RealType> ur(nw_this_batch);
       /// masks for movers with valid moves
       std::vector<int> isValid(nw_this_batch);
+      /// moves of all the electrons, the positions and derivatives before them
+      ParticlePos_t delta_all(all_electron ? nels : 0);
+      std::vector<ParticlePos_t> R_old(all_electron ? nw_this_batch : 0);
+      std::vector<ParticleSet::ParticleGradient_t> G_old(all_electron ? nw_this_batch : 0);
+      std::vector<ParticleSet::ParticleLaplacian_t> L_old(all_electron ? nw_this_batch : 0);
+      const std::vector<WaveFunction*> trial_WF_list(all_electron ? extract_trial_wf_list(Sub_list)
+                                                                  : std::vector<WaveFunction*>());
 
       // synchronous walker moves
       for (int l = 0; l < nsubsteps; ++l) // drift-and-diffusion
       {
+        if (all_electron)
+        {
+          // move all the electrons, the trial wavefunctions are recomputed with one batched LU per determinant
+          Sub_list[0]->rng.generate_uniform(ur.data(), nw_this_batch);
+          for (int iw = 0; iw < nw_this_batch; iw++)
+          {
+            Sub_list[0]->rng.generate_normal(&delta_all[0][0], nels3);
+            R_old[iw] = P_list[iw]->R;
+            G_old[iw] = P_list[iw]->G;
+            L_old[iw] = P_list[iw]->L;
+            for (int iel = 0; iel < nels; ++iel)
+              P_list[iw]->R[iel] += delta_all[iel];
+            P_list[iw]->update();
+          }
+          Timers[Timer_Recompute]->start();
+          anon_mover.trial_wavefunction.flex_recompute(trial_WF_list, P_list);
+          Timers[Timer_Recompute]->stop();
+          // a rejected move keeps the wavefunction of the old positions
+          for (int iw = 0; iw < nw_this_batch; iw++)
+            if (ur[iw] < accept)
+              WF_list[iw]->swap(*trial_WF_list[iw]);
+            else
+            {
+              P_list[iw]->R = R_old[iw];
+              P_list[iw]->G = G_old[iw];
+              P_list[iw]->L = L_old[iw];
+              P_list[iw]->update();
+            }
+          continue;
+        }
+
         for (int iel = 0; iel < nels; ++iel)
         {
 	  // Operate on electron with index iel
@@ -507,8 +723,9 @@ int main(int argc, char** argv)
       for (int iw = 0; iw < nw_this_batch; iw++)
         Sub_list[iw]->els.donePbyP();
 
-      // evaluate Kinetic Energy
-      anon_mover.wavefunction.flex_evaluateGL(WF_list, P_list);
+      // evaluate Kinetic Energy, done by the recomputes of the all-electron moves
+      if (!all_electron)
+        anon_mover.wavefunction.flex_evaluateGL(WF_list, P_list);
 
       Timers[Timer_Diffusion]->stop();
 
@@ -522,12 +739,30 @@ int main(int argc, char** argv)
   } // nsteps
   Timers[Timer_Total]->stop();
 
+  RecomputeStats recompute_stats;
+  for (int iw = 0; iw < nmovers; iw++)
+    mover_list[iw]->wavefunction.getRecomputeStats(recompute_stats);
+  if (inverse_method == InverseMethod::mixed)
+    app_summary() << "\nLargest residual of the mixed precision inversions = "
+                  << recompute_stats.max_inverse_residual << endl;
+  if (recompute.period > 0 || recompute.threshold > 0)
+  {
+    app_summary() << "\nDeterminant recomputes = " << recompute_stats.scheduled + recompute_stats.triggered << " ("
+                  << recompute_stats.scheduled << " scheduled, " << recompute_stats.triggered << " by the residual)"
+                  << endl;
+    if (recompute.threshold > 0)
+      app_summary() << "Residual checks = " << recompute_stats.checks
+                    << ", largest residual = " << recompute_stats.max_residual << endl;
+    app_summary() << "Largest drift of log|det| found by a recompute = " << recompute_stats.max_drift << endl;
+  }
+
   // free all movers
   #pragma omp parallel for
   for (int iw = 0; iw < nmovers; iw++)
     delete mover_list[iw];
   mover_list.clear();
   delete spo_main;
+  delete spo_virtual;
 
   if (comm.root())
   {
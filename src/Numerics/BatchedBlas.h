@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file BatchedBlas.h
+ * @brief GEMM over batches of independent small matrices.
+ */
+#ifndef QMCPLUSPLUS_BATCHED_BLAS_H
+#define QMCPLUSPLUS_BATCHED_BLAS_H
+
+#include "config.h"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "Numerics/OhmmsBlas.h"
+#include "Utilities/Configuration.h"
+#if defined(HAVE_MKL)
+#include <mkl_blas.h>
+#endif
+
+/** batched BLAS
+ *
+ * Entry b of a batch computes C[b] = alpha op(A[b]) op(B[b]) + beta C[b] with
+ * its own sizes m[b] x n[b] x k[b] and leading dimensions, column-major like
+ * BLAS::gemm. The batched GEMM of MKL is used when available. Otherwise the
+ * entries are distributed over the threads of the next level, each calling a
+ * serial BLAS::gemm. Hand-written kernels were measured slower than OpenBLAS
+ * down to 32x32 matrices, so there is no native GEMM.
+ */
+struct BatchedBLAS
+{
+  template<typename T>
+  static void gemm_loop(char transa,
+                        char transb,
+                        const int* m,
+                        const int* n,
+                        const int* k,
+                        T alpha,
+                        const T* const* A,
+                        const int* lda,
+                        const T* const* B,
+                        const int* ldb,
+                        T beta,
+                        T* const* C,
+                        const int* ldc,
+                        int batch)
+  {
+    const int num_threads = std::min(batch, getNextLevelNumThreads());
+#pragma omp parallel for num_threads(num_threads) if (num_threads > 1)
+    for (int b = 0; b < batch; b++)
+      if (m[b] > 0 && n[b] > 0)
+        BLAS::gemm(transa, transb, m[b], n[b], k[b], alpha, A[b], lda[b], B[b], ldb[b], beta, C[b], ldc[b]);
+  }
+
+#if defined(HAVE_MKL)
+  /// one group of size one per entry, the sizes differ
+  static void gemm_mkl(const std::vector<char>& ta,
+                       const std::vector<char>& tb,
+                       const int* m,
+                       const int* n,
+                       const int* k,
+                       const std::vector<double>& alpha,
+                       const double** A,
+                       const int* lda,
+                       const double** B,
+                       const int* ldb,
+                       const std::vector<double>& beta,
+                       double** C,
+                       const int* ldc,
+                       int batch,
+                       const std::vector<int>& group_size)
+  {
+    dgemm_batch(ta.data(), tb.data(), m, n, k, alpha.data(), A, lda, B, ldb, beta.data(), C, ldc, &batch,
+                group_size.data());
+  }
+
+  static void gemm_mkl(const std::vector<char>& ta,
+                       const std::vector<char>& tb,
+                       const int* m,
+                       const int* n,
+                       const int* k,
+                       const std::vector<float>& alpha,
+                       const float** A,
+                       const int* lda,
+                       const float** B,
+                       const int* ldb,
+                       const std::vector<float>& beta,
+                       float** C,
+                       const int* ldc,
+                       int batch,
+                       const std::vector<int>& group_size)
+  {
+    sgemm_batch(ta.data(), tb.data(), m, n, k, alpha.data(), A, lda, B, ldb, beta.data(), C, ldc, &batch,
+                group_size.data());
+  }
+
+  template<typename T>
+  static void gemm(char transa,
+                   char transb,
+                   const int* m,
+                   const int* n,
+                   const int* k,
+                   T alpha,
+                   const T* const* A,
+                   const int* lda,
+                   const T* const* B,
+                   const int* ldb,
+                   T beta,
+                   T* const* C,
+                   const int* ldc,
+                   int batch,
+                   typename std::enable_if<std::is_floating_point<T>::value>::type* = nullptr)
+  {
+    if (batch == 0)
+      return;
+    gemm_mkl(std::vector<char>(batch, transa), std::vector<char>(batch, transb), m, n, k,
+             std::vector<T>(batch, alpha), const_cast<const T**>(A), lda, const_cast<const T**>(B), ldb,
+             std::vector<T>(batch, beta), const_cast<T**>(C), ldc, batch, std::vector<int>(batch, 1));
+  }
+
+  template<typename T>
+  static void gemm(char transa,
+                   char transb,
+                   const int* m,
+                   const int* n,
+                   const int* k,
+                   T alpha,
+                   const T* const* A,
+                   const int* lda,
+                   const T* const* B,
+                   const int* ldb,
+                   T beta,
+                   T* const* C,
+                   const int* ldc,
+                   int batch,
+                   typename std::enable_if<!std::is_floating_point<T>::value>::type* = nullptr)
+  {
+    gemm_loop(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batch);
+  }
+#else
+  template<typename T>
+  static void gemm(char transa,
+                   char transb,
+                   const int* m,
+                   const int* n,
+                   const int* k,
+                   T alpha,
+                   const T* const* A,
+                   const int* lda,
+                   const T* const* B,
+                   const int* ldb,
+                   T beta,
+                   T* const* C,
+                   const int* ldc,
+                   int batch)
+  {
+    gemm_loop(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batch);
+  }
+#endif
+};
+
+#endif
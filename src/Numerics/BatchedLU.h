@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file BatchedLU.h
+ * @brief inversion of batches of small matrices of the same size interleaved in the SIMD lanes
+ */
+#ifndef QMCPLUSPLUS_BATCHED_LU_H
+#define QMCPLUSPLUS_BATCHED_LU_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "Utilities/Configuration.h"
+#include "Utilities/SIMD/allocator.hpp"
+#include "Utilities/Constants.h"
+#include "Utilities/scalar_traits.h"
+
+namespace qmcplusplus
+{
+/** batched inversion with partial pivoting
+ *
+ * The matrices are inverted by groups of W, one 64-byte vector of T: element (i,j)
+ * of the matrix b of a group is stored at ((i n + j) W + b) so that the eliminations
+ * run over the W matrices in the SIMD lanes. Each matrix picks its own pivots and
+ * the rows are swapped lane by lane, O(n^2) per matrix against the O(n^3) of the
+ * elimination. The inverse is built in place by Gauss-Jordan elimination, the same
+ * 2 n^3 flops as getrf + getri. The pivots are the diagonal of U of the LU
+ * factorization and give the log determinant and the phase.
+ * The groups are distributed over the threads of the next level.
+ */
+struct BatchedLU
+{
+  /// number of matrices interleaved in a group
+  template<typename T>
+  static constexpr int lanes()
+  {
+    return sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+  }
+
+  /** invert the transposes of batch n x n row-major matrices
+   * @tparam T precision of the inversion
+   * @param a input matrices, leading dimension lda
+   * @param ainv inverses of the transposes, leading dimension ldinv
+   * @param logdet log of the absolute values of the determinants, -inf if singular
+   * @param phase phases of the determinants in [0, 2pi)
+   *
+   * The row-major inverse of the transpose is the column-major inverse, the layout
+   * of DiracMatrix::invert_transpose.
+   */
+  template<typename T, typename TA>
+  static void invert_transpose(int n,
+                               const TA* const* a,
+                               int lda,
+                               TA* const* ainv,
+                               int ldinv,
+                               typename scalar_traits<T>::real_type* logdet,
+                               typename scalar_traits<T>::real_type* phase,
+                               int batch)
+  {
+    constexpr int W        = lanes<T>();
+    const int num_groups   = (batch + W - 1) / W;
+    const int num_threads  = std::min(num_groups, getNextLevelNumThreads());
+    const size_t group_len = static_cast<size_t>(n) * n * W;
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+    {
+      aligned_vector<T> work(group_len);
+      std::vector<int> pivot(static_cast<size_t>(n) * W);
+      typename scalar_traits<T>::real_type group_logdet[W], group_phase[W];
+#pragma omp for
+      for (int g = 0; g < num_groups; g++)
+      {
+        const int first = g * W;
+        const int nb    = std::min(W, batch - first);
+        // the missing matrices of the last group are the identity
+        for (int b = 0; b < W; b++)
+          for (int j = 0; j < n; j++)
+            for (int i = 0; i < n; i++)
+              work[(static_cast<size_t>(i) * n + j) * W + b] = (b < nb) ? T(a[first + b][j * lda + i]) : T(i == j);
+        invert_group<T, W>(n, work.data(), pivot.data(), group_logdet, group_phase);
+        for (int b = 0; b < nb; b++)
+        {
+          TA* restrict x = ainv[first + b];
+          for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+              x[i * ldinv + j] = TA(work[(static_cast<size_t>(i) * n + j) * W + b]);
+          logdet[first + b] = group_logdet[b];
+          phase[first + b]  = group_phase[b];
+        }
+      }
+    }
+  }
+
+private:
+  template<typename R>
+  static void accumulate(R u, R& logdet, R& phase)
+  {
+    logdet += std::log(std::abs(u));
+    if (u < 0)
+      phase = (phase > 0) ? R(0) : R(M_PI);
+  }
+
+  template<typename R>
+  static void accumulate(const std::complex<R>& u, R& logdet, R& phase)
+  {
+    logdet += std::log(std::abs(u));
+    phase += std::arg(u);
+  }
+
+  /// subtract factor times the row k from the row wi, the column k becomes zero
+  template<typename T, int W>
+  static void eliminate_row(int n, T* restrict wi, const T* restrict wk, int k, T* restrict factor)
+  {
+    for (int b = 0; b < W; b++)
+    {
+      factor[b]     = wi[k * W + b];
+      wi[k * W + b] = T(0);
+    }
+    for (int j = 0; j < n; j++)
+    {
+      T* restrict wij       = wi + j * W;
+      const T* restrict wkj = wk + j * W;
+#pragma omp simd
+      for (int b = 0; b < W; b++)
+        wij[b] -= factor[b] * wkj[b];
+    }
+  }
+
+  /// invert the W interleaved n x n matrices of w in place
+  template<typename T, int W>
+  static void invert_group(int n,
+                           T* restrict w,
+                           int* restrict pivot,
+                           typename scalar_traits<T>::real_type* logdet,
+                           typename scalar_traits<T>::real_type* phase)
+  {
+    using real_type  = typename scalar_traits<T>::real_type;
+    const size_t row = static_cast<size_t>(n) * W;
+    alignas(64) T scale[W];
+    alignas(64) T factor[W];
+    alignas(64) T factor2[W];
+    for (int b = 0; b < W; b++)
+    {
+      logdet[b] = real_type(0);
+      phase[b]  = real_type(0);
+    }
+
+    for (int k = 0; k < n; k++)
+    {
+      T* restrict wk = w + k * row;
+      // the pivot of each matrix, the rows are swapped lane by lane
+      for (int b = 0; b < W; b++)
+      {
+        int p          = k;
+        real_type amax = std::abs(wk[k * W + b]);
+        for (int i = k + 1; i < n; i++)
+          if (std::abs(w[i * row + k * W + b]) > amax)
+          {
+            amax = std::abs(w[i * row + k * W + b]);
+            p    = i;
+          }
+        pivot[k * W + b] = p;
+        if (p != k)
+        {
+          T* restrict wp = w + p * row;
+          for (int j = 0; j < n; j++)
+            std::swap(wk[j * W + b], wp[j * W + b]);
+          accumulate(T(-1), logdet[b], phase[b]);
+        }
+        accumulate(wk[k * W + b], logdet[b], phase[b]);
+        scale[b]       = T(1) / wk[k * W + b];
+        wk[k * W + b] = T(1);
+      }
+
+      for (int j = 0; j < n; j++)
+      {
+        T* restrict wkj = wk + j * W;
+#pragma omp simd aligned(scale)
+        for (int b = 0; b < W; b++)
+          wkj[b] *= scale[b];
+      }
+
+      // eliminate the column k from the other rows, two at a time to reuse the row k
+      for (int i0 = 0; i0 < n; i0 += 2)
+      {
+        const int i1 = (i0 + 1 < n && i0 + 1 != k) ? i0 + 1 : -1;
+        if (i0 == k)
+        {
+          if (i1 >= 0)
+            eliminate_row<T, W>(n, w + i1 * row, wk, k, factor);
+          continue;
+        }
+        if (i1 < 0)
+        {
+          eliminate_row<T, W>(n, w + i0 * row, wk, k, factor);
+          continue;
+        }
+        T* restrict wa = w + i0 * row;
+        T* restrict wb = w + i1 * row;
+        for (int b = 0; b < W; b++)
+        {
+          factor[b]     = wa[k * W + b];
+          factor2[b]    = wb[k * W + b];
+          wa[k * W + b] = T(0);
+          wb[k * W + b] = T(0);
+        }
+        for (int j = 0; j < n; j++)
+        {
+          const T* restrict wkj = wk + j * W;
+          T* restrict waj       = wa + j * W;
+          T* restrict wbj       = wb + j * W;
+#pragma omp simd aligned(factor, factor2)
+          for (int b = 0; b < W; b++)
+          {
+            waj[b] -= factor[b] * wkj[b];
+            wbj[b] -= factor2[b] * wkj[b];
+          }
+        }
+      }
+    }
+
+    // A^{-1} = (P A)^{-1} P, interchange the columns in reverse order
+    for (int k = n - 1; k >= 0; k--)
+      for (int b = 0; b < W; b++)
+      {
+        const int p = pivot[k * W + b];
+        if (p != k)
+          for (int i = 0; i < n; i++)
+            std::swap(w[i * row + k * W + b], w[i * row + p * W + b]);
+      }
+
+    for (int b = 0; b < W; b++)
+      phase[b] -= std::floor(phase[b] / TWOPI) * TWOPI;
+  }
+};
+
+} // namespace qmcplusplus
+
+#endif
@@ -46,6 +46,10 @@
 #define sgemm sgemm_
 #define zgemm zgemm_
 #define cgemm cgemm_
+#define dtrmm dtrmm_
+#define strmm strmm_
+#define ztrmm ztrmm_
+#define ctrmm ctrmm_
 #define dgemv dgemv_
 #define sgemv sgemv_
 #define zgemv zgemv_
@@ -164,6 +168,24 @@ void cgemm(const char &, const char &, const int &, const int &, const int &,
            const int &, const std::complex<float> *, const int &,
            const std::complex<float> &, std::complex<float> *, const int &);
 
+void dtrmm(const char &side, const char &uplo, const char &transa,
+           const char &diag, const int &m, const int &n, const double &alpha,
+           const double *A, const int &lda, double *B, const int &ldb);
+
+void strmm(const char &side, const char &uplo, const char &transa,
+           const char &diag, const int &m, const int &n, const float &alpha,
+           const float *A, const int &lda, float *B, const int &ldb);
+
+void ztrmm(const char &side, const char &uplo, const char &transa,
+           const char &diag, const int &m, const int &n,
+           const std::complex<double> &alpha, const std::complex<double> *A,
+           const int &lda, std::complex<double> *B, const int &ldb);
+
+void ctrmm(const char &side, const char &uplo, const char &transa,
+           const char &diag, const int &m, const int &n,
+           const std::complex<float> &alpha, const std::complex<float> *A,
+           const int &lda, std::complex<float> *B, const int &ldb);
+
 void dgemv(const char &trans, const int &nr, const int &nc, const double &alpha,
            const double *amat, const int &lda, const double *bv,
            const int &incx, const double &beta, double *cv, const int &incy);
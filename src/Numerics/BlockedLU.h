@@ -0,0 +1,268 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file BlockedLU.h
+ * @brief LU factorization and inversion of dense matrices with OpenMP tasks
+ */
+#ifndef QMCPLUSPLUS_BLOCKED_LU_H
+#define QMCPLUSPLUS_BLOCKED_LU_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+#include "Numerics/OhmmsBlas.h"
+#include "Numerics/BlasThreadingEnv.h"
+#include "Utilities/Configuration.h"
+#include "Utilities/Constants.h"
+#include "Utilities/scalar_traits.h"
+
+namespace qmcplusplus
+{
+/** blocked LU factorization with partial pivoting and inversion, getrf + getri
+ *
+ * Matrices are column major as in LAPACK. The factorization is right-looking:
+ * a panel of block columns is factorized, then the trailing column tiles are
+ * updated by OpenMP tasks. The inverse solves L U X = P for independent block
+ * columns of the identity, one task each, and costs the same as getri.
+ * The tasks run on the threads of the next level and multiply the tiles
+ * with a serial BLAS::gemm, the panel and the diagonal blocks use plain loops.
+ * The log determinant and the phase are accumulated from the pivots.
+ */
+template<typename T>
+class BlockedLU
+{
+  using real_type = typename scalar_traits<T>::real_type;
+
+  /// block size of the panels and the tiles, 0 to choose by the matrix size
+  int block_size;
+  /// block size in use
+  int block;
+  /// row interchanges, 1-based as LAPACK
+  std::vector<int> pivot;
+  /// inverse before the column interchanges
+  std::vector<T> work;
+  /// a zero pivot was found
+  bool singular;
+
+  /// column major element access
+  static T& at(T* a, int lda, int i, int j) { return a[i + static_cast<size_t>(j) * lda]; }
+
+  /// B = L^{-1} B, L the unit lower triangle of the m x m block a
+  static void solve_lower_unit(int m, int ncols, const T* a, int lda, T* b, int ldb)
+  {
+    for (int c = 0; c < ncols; c++)
+    {
+      T* restrict bc = b + static_cast<size_t>(c) * ldb;
+      for (int i = 0; i < m; i++)
+      {
+        const T* restrict ai = a + static_cast<size_t>(i) * lda;
+        const T bi           = bc[i];
+        for (int r = i + 1; r < m; r++)
+          bc[r] -= ai[r] * bi;
+      }
+    }
+  }
+
+  /// B = U^{-1} B, U the upper triangle of the m x m block a
+  static void solve_upper(int m, int ncols, const T* a, int lda, T* b, int ldb)
+  {
+    for (int c = 0; c < ncols; c++)
+    {
+      T* restrict bc = b + static_cast<size_t>(c) * ldb;
+      for (int i = m - 1; i >= 0; i--)
+      {
+        const T* restrict ai = a + static_cast<size_t>(i) * lda;
+        bc[i] /= ai[i];
+        const T bi = bc[i];
+        for (int r = 0; r < i; r++)
+          bc[r] -= ai[r] * bi;
+      }
+    }
+  }
+
+  /// factorize the columns [k, k+kb) over the rows [k, n), unblocked
+  void factorize_panel(T* a, int n, int lda, int k, int kb)
+  {
+    for (int j = k; j < k + kb; j++)
+    {
+      T* restrict aj = a + static_cast<size_t>(j) * lda;
+      int p          = j;
+      real_type amax = std::abs(aj[j]);
+      for (int i = j + 1; i < n; i++)
+        if (std::abs(aj[i]) > amax)
+        {
+          amax = std::abs(aj[i]);
+          p    = i;
+        }
+      pivot[j] = p + 1;
+      if (amax == real_type(0))
+      {
+        singular = true;
+        continue;
+      }
+      if (p != j)
+        for (int c = k; c < k + kb; c++)
+          std::swap(at(a, lda, j, c), at(a, lda, p, c));
+      const T inv_pivot = T(1) / aj[j];
+      for (int i = j + 1; i < n; i++)
+        aj[i] *= inv_pivot;
+      for (int c = j + 1; c < k + kb; c++)
+      {
+        T* restrict ac = a + static_cast<size_t>(c) * lda;
+        const T ajc    = ac[j];
+        for (int i = j + 1; i < n; i++)
+          ac[i] -= aj[i] * ajc;
+      }
+    }
+  }
+
+  /// apply the interchanges of the panel [k, k+kb) to the columns [c0, c1)
+  void swap_rows(T* a, int lda, int k, int kb, int c0, int c1) const
+  {
+    for (int c = c0; c < c1; c++)
+      for (int j = k; j < k + kb; j++)
+        if (pivot[j] != j + 1)
+          std::swap(at(a, lda, j, c), at(a, lda, pivot[j] - 1, c));
+  }
+
+  /// LU factorization in place, must be called by a single thread of a parallel region
+  void factorize(T* a, int n, int lda)
+  {
+    for (int k = 0; k < n; k += block)
+    {
+      const int kb = std::min(block, n - k);
+      factorize_panel(a, n, lda, k, kb);
+      if (k > 0)
+      {
+#pragma omp task
+        swap_rows(a, lda, k, kb, 0, k);
+      }
+      for (int j0 = k + kb; j0 < n; j0 += block)
+      {
+#pragma omp task firstprivate(j0)
+        {
+          const int jb = std::min(block, n - j0);
+          swap_rows(a, lda, k, kb, j0, j0 + jb);
+          solve_lower_unit(kb, jb, &at(a, lda, k, k), lda, &at(a, lda, k, j0), lda);
+          if (k + kb < n)
+            BLAS::gemm('N', 'N', n - k - kb, jb, kb, T(-1), &at(a, lda, k + kb, k), lda, &at(a, lda, k, j0), lda, T(1),
+                       &at(a, lda, k + kb, j0), lda);
+        }
+      }
+#pragma omp taskwait
+    }
+  }
+
+  /** the block column [j0, j0+jb) of (L U)^{-1} into x
+   *
+   * L^{-1} applied to the identity has no rows above j0, U^{-1} fills the column.
+   */
+  void invert_block_column(const T* a, int n, int lda, int j0, int jb, T* x)
+  {
+    for (int c = j0; c < j0 + jb; c++)
+    {
+      T* restrict xc = x + static_cast<size_t>(c) * lda;
+      std::fill_n(xc, n, T(0));
+      xc[c] = T(1);
+    }
+    // right-looking substitutions, the tall updates run faster in BLAS
+    for (int i0 = j0; i0 < n; i0 += block)
+    {
+      const int ib = std::min(block, n - i0);
+      const int i1 = i0 + ib;
+      solve_lower_unit(ib, jb, a + i0 + static_cast<size_t>(i0) * lda, lda, x + i0 + static_cast<size_t>(j0) * lda,
+                       lda);
+      if (i1 < n)
+        BLAS::gemm('N', 'N', n - i1, jb, ib, T(-1), a + i1 + static_cast<size_t>(i0) * lda, lda,
+                   x + i0 + static_cast<size_t>(j0) * lda, lda, T(1), x + i1 + static_cast<size_t>(j0) * lda, lda);
+    }
+    for (int i0 = ((n - 1) / block) * block; i0 >= 0; i0 -= block)
+    {
+      const int ib = std::min(block, n - i0);
+      solve_upper(ib, jb, a + i0 + static_cast<size_t>(i0) * lda, lda, x + i0 + static_cast<size_t>(j0) * lda, lda);
+      if (i0 > 0)
+        BLAS::gemm('N', 'N', i0, jb, ib, T(-1), a + static_cast<size_t>(i0) * lda, lda,
+                   x + i0 + static_cast<size_t>(j0) * lda, lda, T(1), x + static_cast<size_t>(j0) * lda, lda);
+    }
+  }
+
+  static void accumulate(real_type u, real_type& logdet, real_type& phase)
+  {
+    logdet += std::log(std::abs(u));
+    if (u < 0)
+      phase = (phase > 0) ? real_type(0) : real_type(M_PI);
+  }
+
+  static void accumulate(const std::complex<real_type>& u, real_type& logdet, real_type& phase)
+  {
+    logdet += std::log(std::abs(u));
+    phase += std::arg(u);
+  }
+
+public:
+  explicit BlockedLU(int block_size = 0) : block_size(block_size), block(block_size), singular(false) {}
+
+  /** invert the n x n column-major matrix a in place
+   * @param phase phase of the determinant in [0, 2pi)
+   * @return log of the absolute value of the determinant, -inf if singular and a is left factorized
+   */
+  real_type invert(T* a, int n, int lda, real_type& phase)
+  {
+    // small blocks were faster up to 256x256 on a single core
+    block = (block_size > 0) ? block_size : ((n <= 256) ? 32 : 64);
+    pivot.resize(n);
+    work.resize(static_cast<size_t>(n) * lda);
+    singular = false;
+    BlasThreadingEnv knob(1);
+    const int num_threads = getNextLevelNumThreads();
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+#pragma omp single
+    factorize(a, n, lda);
+
+    real_type logdet(0);
+    phase = real_type(0);
+    if (singular)
+      return -std::numeric_limits<real_type>::infinity();
+    for (int i = 0; i < n; i++)
+    {
+      accumulate(at(a, lda, i, i), logdet, phase);
+      if (pivot[i] != i + 1)
+        accumulate(T(-1), logdet, phase);
+    }
+    phase -= std::floor(phase / TWOPI) * TWOPI;
+
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+#pragma omp single
+    {
+      for (int j0 = 0; j0 < n; j0 += block)
+      {
+#pragma omp task firstprivate(j0)
+        invert_block_column(a, n, lda, j0, std::min(block, n - j0), work.data());
+      }
+    }
+
+    // X = (L U)^{-1} P^T, interchange the columns in reverse order
+    for (int j = n - 1; j >= 0; j--)
+      if (pivot[j] != j + 1)
+        std::swap_ranges(work.begin() + static_cast<size_t>(j) * lda, work.begin() + static_cast<size_t>(j) * lda + n,
+                         work.begin() + static_cast<size_t>(pivot[j] - 1) * lda);
+    for (int j = 0; j < n; j++)
+      std::copy_n(work.begin() + static_cast<size_t>(j) * lda, n, a + static_cast<size_t>(j) * lda);
+    return logdet;
+  }
+};
+
+} // namespace qmcplusplus
+
+#endif
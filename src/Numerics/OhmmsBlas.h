@@ -262,6 +262,36 @@ struct BLAS
     cgemm(Atrans, Btrans, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
   }
 
+  inline static void trmm(char side, char uplo, char Atrans, char diag, int M,
+                          int N, double alpha, const double *A, int lda,
+                          double *B, int ldb)
+  {
+    dtrmm(side, uplo, Atrans, diag, M, N, alpha, A, lda, B, ldb);
+  }
+
+  inline static void trmm(char side, char uplo, char Atrans, char diag, int M,
+                          int N, float alpha, const float *A, int lda,
+                          float *B, int ldb)
+  {
+    strmm(side, uplo, Atrans, diag, M, N, alpha, A, lda, B, ldb);
+  }
+
+  inline static void trmm(char side, char uplo, char Atrans, char diag, int M,
+                          int N, std::complex<double> alpha,
+                          const std::complex<double> *A, int lda,
+                          std::complex<double> *B, int ldb)
+  {
+    ztrmm(side, uplo, Atrans, diag, M, N, alpha, A, lda, B, ldb);
+  }
+
+  inline static void trmm(char side, char uplo, char Atrans, char diag, int M,
+                          int N, std::complex<float> alpha,
+                          const std::complex<float> *A, int lda,
+                          std::complex<float> *B, int ldb)
+  {
+    ctrmm(side, uplo, Atrans, diag, M, N, alpha, A, lda, B, ldb);
+  }
+
   template <typename T>
   inline static T dot(int n, const T *restrict a, const T *restrict b)
   {
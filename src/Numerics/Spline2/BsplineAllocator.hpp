@@ -18,9 +18,24 @@
 #include "Utilities/SIMD/Mallocator.hpp"
 #include "Numerics/Spline2/bspline_traits.hpp"
 #include <Numerics/OhmmsPETE/OhmmsArray.h>
+#include <Utilities/RandomGenerator.h>
+#include <vector>
 
 namespace qmcplusplus
 {
+/** placement of the coefficient pages by the threads initializing them
+ *
+ * block: each thread fills a contiguous range of x planes, so a thread's
+ *        pages land on its socket.
+ * interleave: x planes are dealt round-robin over the threads, spreading
+ *        every table over all the sockets.
+ */
+enum class FirstTouch
+{
+  block,
+  interleave
+};
+
 template<typename T, size_t ALIGN = QMC_CLINE, typename ALLOC = Mallocator<T, ALIGN>>
 class BsplineAllocator
 {
@@ -49,9 +64,26 @@ public:
     delete (spline);
   }
 
-  ///allocate a multi-bspline structure
-  SplineType* allocateMultiBspline(
-      Ugrid x_grid, Ugrid y_grid, Ugrid z_grid, BCType xBC, BCType yBC, BCType zBC, int num_splines);
+  /// replace the coefficients of a spline by n uninitialized values
+  void reallocateCoefs(SplineType* spline, size_t n)
+  {
+    if (spline->coefs)
+      mAllocator.deallocate(spline->coefs, spline->coefs_size);
+    spline->coefs      = mAllocator.allocate(n);
+    spline->coefs_size = n;
+  }
+
+  /** allocate a multi-bspline structure
+   * @param allocate_coefs if false, coefs is left null for the caller to provide
+   */
+  SplineType* allocateMultiBspline(Ugrid x_grid,
+                                   Ugrid y_grid,
+                                   Ugrid z_grid,
+                                   BCType xBC,
+                                   BCType yBC,
+                                   BCType zBC,
+                                   int num_splines,
+                                   bool allocate_coefs = true);
 
   /** allocate a multi_UBspline_3d_(s,d)
    * @tparam T datatype
@@ -60,14 +92,41 @@ public:
    */
   template<typename ValT, typename IntT>
   typename bspline_traits<T, 3>::SplineType*
-  createMultiBspline(T dummy, ValT& start, ValT& end, IntT& ng, bc_code bc, int num_splines);
+  createMultiBspline(T dummy,
+                     ValT& start,
+                     ValT& end,
+                     IntT& ng,
+                     bc_code bc,
+                     int num_splines,
+                     bool allocate_coefs = true);
 
   /** Set coefficients for a single orbital (band)
    * @param i index of the orbital
-   * @param coeff array of coefficients
+   * @param coeff array of coefficients, converted to the storage type T
    * @param spline target MultibsplineType
    */
-  void setCoefficientsForOneOrbital(int i, Array<T, 3>& coeff, SplineType* spline);
+  template<typename VT>
+  void setCoefficientsForOneOrbital(int i, Array<VT, 3>& coeff, SplineType* spline);
+
+  /** Set the coefficients of all the orbitals to uniform random numbers in [0,1)
+   * @tparam VT type of the generated numbers, converted to the storage type T
+   * @param splines blocks of num_splines orbitals each, orbital j of block b is orbital b*num_splines+j
+   * @param nblocks number of blocks
+   * @param seed base seed
+   * @param policy distribution of the x planes over the threads
+   * @param first_orbital index of the first orbital, a table starting at it holds the
+   *        same orbitals as the corresponding part of a larger table
+   *
+   * Every (orbital, x plane) pair has its own stream, the coefficients do not depend
+   * on the number of threads or the blocking. Padding is zeroed.
+   * This is the first touch of the coefficients.
+   */
+  template<typename VT>
+  void setRandomCoefficients(SplineType* const* splines,
+                             int nblocks,
+                             uint32_t seed,
+                             FirstTouch policy = FirstTouch::block,
+                             int first_orbital = 0);
 
   /** copy a UBSpline_3d_X to multi_UBspline_3d_X at i-th band
      * @param single  UBspline_3d_X
@@ -82,8 +141,14 @@ public:
 
 template<typename T, size_t ALIGN, typename ALLOC>
 typename BsplineAllocator<T, ALIGN, ALLOC>::SplineType*
-BsplineAllocator<T, ALIGN, ALLOC>::allocateMultiBspline(
-    Ugrid x_grid, Ugrid y_grid, Ugrid z_grid, BCType xBC, BCType yBC, BCType zBC, int num_splines)
+BsplineAllocator<T, ALIGN, ALLOC>::allocateMultiBspline(Ugrid x_grid,
+                                                        Ugrid y_grid,
+                                                        Ugrid z_grid,
+                                                        BCType xBC,
+                                                        BCType yBC,
+                                                        BCType zBC,
+                                                        int num_splines,
+                                                        bool allocate_coefs)
 {
   // Create new spline
   SplineType* restrict spline = new SplineType;
@@ -129,7 +194,7 @@ BsplineAllocator<T, ALIGN, ALLOC>::allocateMultiBspline(
   spline->z_stride = N;
 
   spline->coefs_size = (size_t)Nx * spline->x_stride;
-  spline->coefs      = mAllocator.allocate(spline->coefs_size);
+  spline->coefs      = allocate_coefs ? mAllocator.allocate(spline->coefs_size) : nullptr;
 
   return spline;
 }
@@ -137,7 +202,7 @@ BsplineAllocator<T, ALIGN, ALLOC>::allocateMultiBspline(
 template<typename T, size_t ALIGN, typename ALLOC>
 template<typename ValT, typename IntT>
 typename bspline_traits<T, 3>::SplineType* BsplineAllocator<T, ALIGN, ALLOC>::createMultiBspline(
-    T dummy, ValT& start, ValT& end, IntT& ng, bc_code bc, int num_splines)
+    T dummy, ValT& start, ValT& end, IntT& ng, bc_code bc, int num_splines, bool allocate_coefs)
 {
   Ugrid x_grid, y_grid, z_grid;
   typename bspline_traits<T, 3>::BCType xBC, yBC, zBC;
@@ -153,12 +218,13 @@ typename bspline_traits<T, 3>::SplineType* BsplineAllocator<T, ALIGN, ALLOC>::cr
   xBC.lCode = xBC.rCode = bc;
   yBC.lCode = yBC.rCode = bc;
   zBC.lCode = zBC.rCode = bc;
-  return allocateMultiBspline(x_grid, y_grid, z_grid, xBC, yBC, zBC, num_splines);
+  return allocateMultiBspline(x_grid, y_grid, z_grid, xBC, yBC, zBC, num_splines, allocate_coefs);
 }
 
 template<typename T, size_t ALIGN, typename ALLOC>
+template<typename VT>
 void BsplineAllocator<T, ALIGN, ALLOC>::setCoefficientsForOneOrbital(int i,
-                                                                     Array<T, 3>& coeff,
+                                                                     Array<VT, 3>& coeff,
                                                                      SplineType* spline)
 {
 #pragma omp parallel for collapse(3)
@@ -171,12 +237,63 @@ void BsplineAllocator<T, ALIGN, ALLOC>::setCoefficientsForOneOrbital(int i,
         intptr_t xs                                    = spline->x_stride;
         intptr_t ys                                    = spline->y_stride;
         intptr_t zs                                    = spline->z_stride;
-        spline->coefs[ix * xs + iy * ys + iz * zs + i] = coeff(ix, iy, iz);
+        spline->coefs[ix * xs + iy * ys + iz * zs + i] = static_cast<T>(coeff(ix, iy, iz));
       }
     }
   }
 }
 
+/// seed of the stream of an orbital on an x plane, splitmix64 finalizer
+inline uint32_t orbitalPlaneSeed(uint32_t seed, size_t orbital, int ix)
+{
+  uint64_t z = (static_cast<uint64_t>(seed) << 32) ^ (static_cast<uint64_t>(orbital) << 12) ^ ix;
+  z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  // zero would request a time-based seed
+  return static_cast<uint32_t>(z) | 1u;
+}
+
+template<typename T, size_t ALIGN, typename ALLOC>
+template<typename VT>
+void BsplineAllocator<T, ALIGN, ALLOC>::setRandomCoefficients(SplineType* const* splines,
+                                                              int nblocks,
+                                                              uint32_t seed,
+                                                              FirstTouch policy,
+                                                              int first_orbital)
+{
+  const int num_splines = splines[0]->num_splines;
+  const int Nx          = splines[0]->x_grid.num + 3;
+  const int Ny          = splines[0]->y_grid.num + 3;
+  const int Nz          = splines[0]->z_grid.num + 3;
+  const int nplanes     = nblocks * Nx;
+  const int nthreads    = omp_get_max_threads();
+  const int chunk       = policy == FirstTouch::interleave ? 1 : (nplanes + nthreads - 1) / nthreads;
+#pragma omp parallel
+  {
+    std::vector<RandomGenerator<VT>> streams(num_splines, RandomGenerator<VT>(seed));
+#pragma omp for schedule(static, chunk)
+    for (int plane = 0; plane < nplanes; plane++)
+    {
+      const int ib               = plane / Nx;
+      const int ix               = plane % Nx;
+      SplineType* restrict spline = splines[ib];
+      for (int j = 0; j < num_splines; j++)
+        streams[j].seed(orbitalPlaneSeed(seed, first_orbital + static_cast<size_t>(ib) * num_splines + j, ix));
+      const intptr_t zs = spline->z_stride;
+      for (int iy = 0; iy < Ny; iy++)
+        for (int iz = 0; iz < Nz; iz++)
+        {
+          T* restrict coefs = spline->coefs + ix * spline->x_stride + iy * spline->y_stride + iz * zs;
+          for (int j = 0; j < num_splines; j++)
+            coefs[j] = static_cast<T>(streams[j]());
+          for (int j = num_splines; j < zs; j++)
+            coefs[j] = T(0);
+        }
+    }
+  }
+}
+
 template<typename T, size_t ALIGN, typename ALLOC>
 template<typename UBT, typename MBT>
 void BsplineAllocator<T, ALIGN, ALLOC>::copy(
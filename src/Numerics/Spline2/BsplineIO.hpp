@@ -0,0 +1,278 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/** @file BsplineIO.hpp
+ * @brief binary file format for blocks of multi_UBspline_3d tables
+ *
+ * A file holds a fixed header describing the grid, boundary conditions,
+ * strides and number of splines shared by all the blocks, followed by the
+ * coefficients of each block. Every block starts at a multiple of
+ * SplineFileAlignment so that a mapped file can be used in place.
+ * Files are only read back on machines with the same byte order and for the
+ * same inputs of the coefficient generator.
+ */
+#ifndef QMCPLUSPLUS_SPLINE2_BSPLINE_IO_HPP
+#define QMCPLUSPLUS_SPLINE2_BSPLINE_IO_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Numerics/Spline2/bspline_traits.hpp"
+
+namespace qmcplusplus
+{
+namespace spline2
+{
+/// identifies the coefficient type stored in a file
+template<typename T>
+struct spline_file_type_id
+{};
+
+template<>
+struct spline_file_type_id<float>
+{
+  static constexpr uint32_t value = 1;
+};
+
+template<>
+struct spline_file_type_id<double>
+{
+  static constexpr uint32_t value = 2;
+};
+
+template<>
+struct spline_file_type_id<float16>
+{
+  static constexpr uint32_t value = 3;
+};
+
+template<>
+struct spline_file_type_id<bfloat16>
+{
+  static constexpr uint32_t value = 4;
+};
+
+constexpr char SplineFileMagic[8]      = "MQMCSPL";
+/// 2: per orbital and x plane generator streams, the header holds the generator inputs
+constexpr uint32_t SplineFileVersion   = 2;
+constexpr uint32_t SplineFileByteOrder = 0x01020304u;
+/// alignment of each block of coefficients in the file
+constexpr size_t SplineFileAlignment = 4096;
+
+/// inputs of the generator of the coefficients, see BsplineAllocator::setRandomCoefficients
+struct SplineFileGenerator
+{
+  uint32_t seed;
+  /// global index of the first orbital of the table
+  int32_t first_orbital;
+  /// spline_file_type_id of the precision of the generator
+  uint32_t type_id;
+
+  bool operator==(const SplineFileGenerator& other) const
+  {
+    return seed == other.seed && first_orbital == other.first_orbital && type_id == other.type_id;
+  }
+};
+
+/// header at the start of a spline file
+struct SplineFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t type_id;
+  uint32_t type_size;
+  uint32_t num_blocks;
+  int32_t num_splines;
+  double start[3];
+  double end[3];
+  int32_t num[3];
+  int32_t bc[3];
+  int64_t strides[3];
+  /// number of coefficients per block
+  uint64_t coefs_size;
+  /// distance in bytes between consecutive blocks
+  uint64_t block_bytes;
+  /// offset in bytes of the first block
+  uint64_t data_offset;
+  SplineFileGenerator generator;
+};
+
+inline size_t alignSplineFileOffset(size_t n)
+{
+  return (n + SplineFileAlignment - 1) / SplineFileAlignment * SplineFileAlignment;
+}
+
+/** write blocks of splines with identical shapes
+ * @param fname file name
+ * @param splines the blocks
+ * @param nblocks number of blocks
+ * @param generator inputs of the generator of the coefficients
+ * @return true on success
+ *
+ * The file is written under a temporary name and renamed at the end so that
+ * concurrent readers and writers never see a partial file.
+ */
+template<typename SplineType>
+bool writeMultiBsplines(const std::string& fname,
+                        SplineType* const* splines,
+                        int nblocks,
+                        const SplineFileGenerator& generator)
+{
+  using value_type      = typename bspline_type<SplineType>::value_type;
+  const SplineType& spl = *splines[0];
+
+  SplineFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SplineFileMagic, sizeof(header.magic));
+  header.version     = SplineFileVersion;
+  header.byte_order  = SplineFileByteOrder;
+  header.type_id     = spline_file_type_id<value_type>::value;
+  header.type_size   = sizeof(value_type);
+  header.num_blocks  = nblocks;
+  header.num_splines = spl.num_splines;
+  const Ugrid* grids[3] = {&spl.x_grid, &spl.y_grid, &spl.z_grid};
+  const bc_code bcs[3]  = {spl.xBC.lCode, spl.yBC.lCode, spl.zBC.lCode};
+  for (int d = 0; d < 3; ++d)
+  {
+    header.start[d] = grids[d]->start;
+    header.end[d]   = grids[d]->end;
+    header.num[d]   = grids[d]->num;
+    header.bc[d]    = bcs[d];
+  }
+  header.strides[0]  = spl.x_stride;
+  header.strides[1]  = spl.y_stride;
+  header.strides[2]  = spl.z_stride;
+  header.coefs_size  = spl.coefs_size;
+  header.block_bytes = alignSplineFileOffset(spl.coefs_size * sizeof(value_type));
+  header.data_offset = alignSplineFileOffset(sizeof(header));
+  header.generator   = generator;
+
+  const std::string tmpname = fname + ".tmp." + std::to_string(getpid());
+  std::ofstream fout(tmpname, std::ios::binary);
+  if (!fout)
+    return false;
+  const std::vector<char> padding(SplineFileAlignment, 0);
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fout.write(padding.data(), header.data_offset - sizeof(header));
+  const size_t block_used = spl.coefs_size * sizeof(value_type);
+  for (int i = 0; i < nblocks; ++i)
+  {
+    fout.write(reinterpret_cast<const char*>(splines[i]->coefs), block_used);
+    fout.write(padding.data(), header.block_bytes - block_used);
+  }
+  fout.close();
+  if (!fout || std::rename(tmpname.c_str(), fname.c_str()) != 0)
+  {
+    std::remove(tmpname.c_str());
+    return false;
+  }
+  return true;
+}
+
+/** read-only mapping of a spline file
+ *
+ * Pages are read from the file when first touched. Processes mapping the
+ * same file share the page cache.
+ */
+class MappedBsplineFile
+{
+public:
+  MappedBsplineFile() : mapping(nullptr), mapping_bytes(0) {}
+  ~MappedBsplineFile()
+  {
+    if (mapping)
+      munmap(mapping, mapping_bytes);
+  }
+  MappedBsplineFile(const MappedBsplineFile&) = delete;
+  MappedBsplineFile& operator=(const MappedBsplineFile&) = delete;
+
+  /** map a file
+   * @return false if the file is missing, truncated or of another format or version
+   */
+  bool open(const std::string& fname)
+  {
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SplineFileHeader))
+    {
+      close(fd);
+      return false;
+    }
+    mapping_bytes = st.st_size;
+    mapping       = mmap(nullptr, mapping_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+      mapping = nullptr;
+      return false;
+    }
+    const SplineFileHeader& h = header();
+    if (std::memcmp(h.magic, SplineFileMagic, sizeof(h.magic)) != 0 || h.version != SplineFileVersion ||
+        h.byte_order != SplineFileByteOrder ||
+        h.data_offset + static_cast<uint64_t>(h.num_blocks) * h.block_bytes > mapping_bytes)
+    {
+      munmap(mapping, mapping_bytes);
+      mapping = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  const SplineFileHeader& header() const { return *static_cast<const SplineFileHeader*>(mapping); }
+
+  /** check that the file holds splines of the given type and shape, generated the same way
+   * @param spl a spline with the expected grid, strides and number of splines
+   * @param nblocks expected number of blocks
+   * @param generator expected inputs of the generator of the coefficients
+   */
+  template<typename SplineType>
+  bool matches(const SplineType& spl, int nblocks, const SplineFileGenerator& generator) const
+  {
+    using value_type        = typename bspline_type<SplineType>::value_type;
+    const SplineFileHeader& h = header();
+    const Ugrid* grids[3]   = {&spl.x_grid, &spl.y_grid, &spl.z_grid};
+    const bc_code bcs[3]    = {spl.xBC.lCode, spl.yBC.lCode, spl.zBC.lCode};
+    bool same = h.type_id == spline_file_type_id<value_type>::value && h.type_size == sizeof(value_type) &&
+        h.num_blocks == static_cast<uint32_t>(nblocks) && h.num_splines == spl.num_splines &&
+        h.strides[0] == spl.x_stride && h.strides[1] == spl.y_stride && h.strides[2] == spl.z_stride &&
+        h.coefs_size == spl.coefs_size && h.generator == generator;
+    for (int d = 0; d < 3; ++d)
+      same = same && h.start[d] == grids[d]->start && h.end[d] == grids[d]->end && h.num[d] == grids[d]->num &&
+          h.bc[d] == bcs[d];
+    return same;
+  }
+
+  /// coefficients of the i-th block
+  template<typename T>
+  T* block(int i) const
+  {
+    const SplineFileHeader& h = header();
+    return reinterpret_cast<T*>(static_cast<char*>(mapping) + h.data_offset + i * h.block_bytes);
+  }
+
+private:
+  void* mapping;
+  size_t mapping_bytes;
+};
+
+} // namespace spline2
+} // namespace qmcplusplus
+#endif
@@ -18,6 +18,8 @@
  * Master header file to define MultiBspline
  *
  * Contains 3D spline evaluation routines.
+ * The coefficients are stored in bspline_type<SplineType>::value_type, which
+ * can be narrower than the evaluation type T. They are widened to T on load.
  */
 #ifndef QMCPLUSPLUS_MULTIEINSPLINE_COMMON_HPP
 #define QMCPLUSPLUS_MULTIEINSPLINE_COMMON_HPP
@@ -26,15 +28,18 @@
 #include <Numerics/Spline2/MultiBsplineData.hpp>
 #include <Numerics/Spline2/MultiBsplineEvalHelper.hpp>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 namespace qmcplusplus
 {
 namespace MultiBsplineEval
 {
-template<typename T>
-inline void evaluate_v(const typename bspline_traits<T, 3>::SplineType* restrict spline_m, T x, T y,
-                       T z, T* restrict vals, size_t num_splines)
+template<typename SplineType, typename T>
+inline void evaluate_v(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                       size_t num_splines)
 {
+  using CT = typename bspline_type<SplineType>::value_type;
   int ix, iy, iz;
   T a[4], b[4], c[4];
 
@@ -52,21 +57,66 @@ inline void evaluate_v(const typename bspline_traits<T, 3>::SplineType* restrict
     for (size_t j = 0; j < 4; j++)
     {
       const T pre00           = a[i] * b[j];
-      const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
+      const CT* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
       ASSUME_ALIGNED(coefs);
       //#pragma omp simd
       for (size_t n = 0; n < num_splines; n++)
         vals[n] += pre00 *
-            (c[0] * coefs[n] + c[1] * coefs[n + zs] + c[2] * coefs[n + 2 * zs] +
-             c[3] * coefs[n + 3 * zs]);
+            (c[0] * static_cast<T>(coefs[n]) + c[1] * static_cast<T>(coefs[n + zs]) +
+             c[2] * static_cast<T>(coefs[n + 2 * zs]) + c[3] * static_cast<T>(coefs[n + 3 * zs]));
     }
 }
 
-template<typename T>
-inline void
-evaluate_vgl(const typename bspline_traits<T, 3>::SplineType* restrict spline_m, T x, T y, T z,
-             T* restrict vals, T* restrict grads, T* restrict lapl, size_t num_splines)
+/** evaluate the dot product of the values with row, without storing the values
+ * @param row num_splines weights, e.g. a row of the inverse Slater matrix
+ * @return \f$\sum_n row[n] \phi_n(x,y,z)\f$
+ *
+ * The dot product is linear in the coefficients, each stencil row contributes
+ * its own weighted sum.
+ */
+template<typename SplineType, typename T>
+inline T evaluate_v_dot(const SplineType* restrict spline_m, T x, T y, T z, const T* restrict row,
+                        size_t num_splines)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  T result(0);
+  for (size_t i = 0; i < 4; i++)
+    for (size_t j = 0; j < 4; j++)
+    {
+      const CT* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
+      ASSUME_ALIGNED(coefs);
+      T partial(0);
+#pragma omp simd reduction(+ : partial)
+      for (size_t n = 0; n < num_splines; n++)
+        partial += row[n] *
+            (c[0] * static_cast<T>(coefs[n]) + c[1] * static_cast<T>(coefs[n + zs]) +
+             c[2] * static_cast<T>(coefs[n + 2 * zs]) + c[3] * static_cast<T>(coefs[n + 3 * zs]));
+      result += a[i] * b[j] * partial;
+    }
+  return result;
+}
+
+/** evaluate values, gradients and laplacians
+ * @param grads gradients, component d starts at grads + d * out_offset
+ * @param lapl laplacians, a single component
+ *
+ * The outputs can be the rows of the caller, out_offset and the pointers must be aligned.
+ */
+template<typename SplineType, typename T>
+inline void evaluate_vgl(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                         T* restrict grads, T* restrict lapl, size_t num_splines, size_t out_offset)
 {
+  using CT = typename bspline_type<SplineType>::value_type;
+
   int ix, iy, iz;
   T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
 
@@ -77,8 +127,6 @@ evaluate_vgl(const typename bspline_traits<T, 3>::SplineType* restrict spline_m,
   const intptr_t ys = spline_m->y_stride;
   const intptr_t zs = spline_m->z_stride;
 
-  const size_t out_offset = spline_m->num_splines;
-
   ASSUME_ALIGNED(vals);
   T* restrict gx = grads;
   ASSUME_ALIGNED(gx);
@@ -86,38 +134,38 @@ evaluate_vgl(const typename bspline_traits<T, 3>::SplineType* restrict spline_m,
   ASSUME_ALIGNED(gy);
   T* restrict gz = grads + 2 * out_offset;
   ASSUME_ALIGNED(gz);
-  T* restrict lx = lapl;
-  ASSUME_ALIGNED(lx);
-  T* restrict ly = lapl + out_offset;
-  ASSUME_ALIGNED(ly);
-  T* restrict lz = lapl + 2 * out_offset;
-  ASSUME_ALIGNED(lz);
+  ASSUME_ALIGNED(lapl);
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  const T dxInv2 = dxInv * dxInv;
+  const T dyInv2 = dyInv * dyInv;
+  const T dzInv2 = dzInv * dzInv;
 
   std::fill(vals, vals + num_splines, T());
   std::fill(gx, gx + num_splines, T());
   std::fill(gy, gy + num_splines, T());
   std::fill(gz, gz + num_splines, T());
-  std::fill(lx, lx + num_splines, T());
-  std::fill(ly, ly + num_splines, T());
-  std::fill(lz, lz + num_splines, T());
+  std::fill(lapl, lapl + num_splines, T());
 
   for (int i = 0; i < 4; i++)
     for (int j = 0; j < 4; j++)
     {
-      const T pre20 = d2a[i] * b[j];
+      const T pre2  = d2a[i] * b[j] * dxInv2 + a[i] * d2b[j] * dyInv2;
+      const T pre0z = a[i] * b[j] * dzInv2;
       const T pre10 = da[i] * b[j];
       const T pre00 = a[i] * b[j];
-      const T pre11 = da[i] * db[j];
       const T pre01 = a[i] * db[j];
-      const T pre02 = a[i] * d2b[j];
 
-      const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
+      const CT* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
       ASSUME_ALIGNED(coefs);
-      const T* restrict coefszs = coefs + zs;
+      const CT* restrict coefszs = coefs + zs;
       ASSUME_ALIGNED(coefszs);
-      const T* restrict coefs2zs = coefs + 2 * zs;
+      const CT* restrict coefs2zs = coefs + 2 * zs;
       ASSUME_ALIGNED(coefs2zs);
-      const T* restrict coefs3zs = coefs + 3 * zs;
+      const CT* restrict coefs3zs = coefs + 3 * zs;
       ASSUME_ALIGNED(coefs3zs);
 
 #pragma noprefetch
@@ -135,36 +183,26 @@ evaluate_vgl(const typename bspline_traits<T, 3>::SplineType* restrict spline_m,
         gx[n] += pre10 * sum0;
         gy[n] += pre01 * sum0;
         gz[n] += pre00 * sum1;
-        lx[n] += pre20 * sum0;
-        ly[n] += pre02 * sum0;
-        lz[n] += pre00 * sum2;
+        lapl[n] += pre2 * sum0 + pre0z * sum2;
         vals[n] += pre00 * sum0;
       }
     }
 
-  const T dxInv = spline_m->x_grid.delta_inv;
-  const T dyInv = spline_m->y_grid.delta_inv;
-  const T dzInv = spline_m->z_grid.delta_inv;
-
-  const T dxInv2 = dxInv * dxInv;
-  const T dyInv2 = dyInv * dyInv;
-  const T dzInv2 = dzInv * dzInv;
-
 #pragma omp simd
   for (int n = 0; n < num_splines; n++)
   {
     gx[n] *= dxInv;
     gy[n] *= dyInv;
     gz[n] *= dzInv;
-    lx[n] = lx[n] * dxInv2 + ly[n] * dyInv2 + lz[n] * dzInv2;
   }
 }
 
-template<typename T>
-inline void
-evaluate_vgh(const typename bspline_traits<T, 3>::SplineType* restrict spline_m, T x, T y, T z,
-             T* restrict vals, T* restrict grads, T* restrict hess, size_t num_splines)
+template<typename SplineType, typename T>
+inline void evaluate_vgh(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                         T* restrict grads, T* restrict hess, size_t num_splines)
 {
+  using CT = typename bspline_type<SplineType>::value_type;
+
   int ix, iy, iz;
   T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
 
@@ -212,13 +250,13 @@ evaluate_vgh(const typename bspline_traits<T, 3>::SplineType* restrict spline_m,
   for (int i = 0; i < 4; i++)
     for (int j = 0; j < 4; j++)
     {
-      const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
+      const CT* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs);
       ASSUME_ALIGNED(coefs);
-      const T* restrict coefszs = coefs + zs;
+      const CT* restrict coefszs = coefs + zs;
       ASSUME_ALIGNED(coefszs);
-      const T* restrict coefs2zs = coefs + 2 * zs;
+      const CT* restrict coefs2zs = coefs + 2 * zs;
       ASSUME_ALIGNED(coefs2zs);
-      const T* restrict coefs3zs = coefs + 3 * zs;
+      const CT* restrict coefs3zs = coefs + 3 * zs;
       ASSUME_ALIGNED(coefs3zs);
 
       const T pre20 = d2a[i] * b[j];
@@ -279,6 +317,337 @@ evaluate_vgh(const typename bspline_traits<T, 3>::SplineType* restrict spline_m,
   }
 }
 
+/** evaluate values, gradients and hessians at a batch of positions
+ * @param spline_m spline table shared by all the positions
+ * @param x,y,z coordinates of nw positions
+ * @param vals,grads,hess nw output buffers, each laid out as in evaluate_vgh
+ * @param num_splines number of splines to evaluate
+ * @param nw number of positions
+ *
+ * The stencil setup of all the positions is done up front and the positions are
+ * visited in the order of their grid cells. Positions falling in the same cell
+ * are evaluated together so that each row of coefficients is streamed once.
+ */
+template<typename SplineType, typename T>
+inline void mw_evaluate_vgh(const SplineType* restrict spline_m,
+                            const T* restrict x, const T* restrict y, const T* restrict z,
+                            T* const* restrict vals, T* const* restrict grads,
+                            T* const* restrict hess, size_t num_splines, int nw)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+
+  struct Stencil
+  {
+    int ix, iy, iz;
+    T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+  };
+
+  std::vector<Stencil> stencils(nw);
+  std::vector<int> order(nw);
+  for (int iw = 0; iw < nw; iw++)
+  {
+    Stencil& s = stencils[iw];
+    spline2::computeLocationAndFractional(spline_m, x[iw], y[iw], z[iw], s.ix, s.iy, s.iz, s.a, s.b,
+                                          s.c, s.da, s.db, s.dc, s.d2a, s.d2b, s.d2c);
+    order[iw] = iw;
+  }
+
+  auto same_cell = [&](int l, int r) {
+    return stencils[l].ix == stencils[r].ix && stencils[l].iy == stencils[r].iy &&
+        stencils[l].iz == stencils[r].iz;
+  };
+  std::sort(order.begin(), order.end(), [&](int l, int r) {
+    const Stencil& sl = stencils[l];
+    const Stencil& sr = stencils[r];
+    if (sl.ix != sr.ix)
+      return sl.ix < sr.ix;
+    if (sl.iy != sr.iy)
+      return sl.iy < sr.iy;
+    return sl.iz < sr.iz;
+  });
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  const size_t out_offset = spline_m->num_splines;
+
+  for (int iw = 0; iw < nw; iw++)
+  {
+    std::fill(vals[iw], vals[iw] + num_splines, T());
+    for (int d = 0; d < 3; d++)
+      std::fill(grads[iw] + d * out_offset, grads[iw] + d * out_offset + num_splines, T());
+    for (int d = 0; d < 6; d++)
+      std::fill(hess[iw] + d * out_offset, hess[iw] + d * out_offset + num_splines, T());
+  }
+
+  for (int first = 0, last = 0; first < nw; first = last)
+  {
+    // [first, last) share the same stencil rows
+    for (last = first + 1; last < nw && same_cell(order[first], order[last]); last++)
+      ;
+    const Stencil& s0 = stencils[order[first]];
+
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const CT* restrict coefs = spline_m->coefs + ((s0.ix + i) * xs + (s0.iy + j) * ys + s0.iz * zs);
+        ASSUME_ALIGNED(coefs);
+        const CT* restrict coefszs = coefs + zs;
+        ASSUME_ALIGNED(coefszs);
+        const CT* restrict coefs2zs = coefs + 2 * zs;
+        ASSUME_ALIGNED(coefs2zs);
+        const CT* restrict coefs3zs = coefs + 3 * zs;
+        ASSUME_ALIGNED(coefs3zs);
+
+        for (int k = first; k < last; k++)
+        {
+          const int iw     = order[k];
+          const Stencil& s = stencils[iw];
+
+          const T pre20 = s.d2a[i] * s.b[j];
+          const T pre10 = s.da[i] * s.b[j];
+          const T pre00 = s.a[i] * s.b[j];
+          const T pre11 = s.da[i] * s.db[j];
+          const T pre01 = s.a[i] * s.db[j];
+          const T pre02 = s.a[i] * s.d2b[j];
+
+          const T c[4]   = {s.c[0], s.c[1], s.c[2], s.c[3]};
+          const T dc[4]  = {s.dc[0], s.dc[1], s.dc[2], s.dc[3]};
+          const T d2c[4] = {s.d2c[0], s.d2c[1], s.d2c[2], s.d2c[3]};
+
+          T* restrict v = vals[iw];
+          ASSUME_ALIGNED(v);
+          T* restrict gx = grads[iw];
+          ASSUME_ALIGNED(gx);
+          T* restrict gy = grads[iw] + out_offset;
+          ASSUME_ALIGNED(gy);
+          T* restrict gz = grads[iw] + 2 * out_offset;
+          ASSUME_ALIGNED(gz);
+          T* restrict hxx = hess[iw];
+          ASSUME_ALIGNED(hxx);
+          T* restrict hxy = hess[iw] + out_offset;
+          ASSUME_ALIGNED(hxy);
+          T* restrict hxz = hess[iw] + 2 * out_offset;
+          ASSUME_ALIGNED(hxz);
+          T* restrict hyy = hess[iw] + 3 * out_offset;
+          ASSUME_ALIGNED(hyy);
+          T* restrict hyz = hess[iw] + 4 * out_offset;
+          ASSUME_ALIGNED(hyz);
+          T* restrict hzz = hess[iw] + 5 * out_offset;
+          ASSUME_ALIGNED(hzz);
+
+          const int iSplitPoint = num_splines;
+#pragma omp simd
+          for (int n = 0; n < iSplitPoint; n++)
+          {
+            T coefsv    = coefs[n];
+            T coefsvzs  = coefszs[n];
+            T coefsv2zs = coefs2zs[n];
+            T coefsv3zs = coefs3zs[n];
+
+            T sum0 = c[0] * coefsv + c[1] * coefsvzs + c[2] * coefsv2zs + c[3] * coefsv3zs;
+            T sum1 = dc[0] * coefsv + dc[1] * coefsvzs + dc[2] * coefsv2zs + dc[3] * coefsv3zs;
+            T sum2 = d2c[0] * coefsv + d2c[1] * coefsvzs + d2c[2] * coefsv2zs + d2c[3] * coefsv3zs;
+
+            hxx[n] += pre20 * sum0;
+            hxy[n] += pre11 * sum0;
+            hxz[n] += pre10 * sum1;
+            hyy[n] += pre02 * sum0;
+            hyz[n] += pre01 * sum1;
+            hzz[n] += pre00 * sum2;
+            gx[n] += pre10 * sum0;
+            gy[n] += pre01 * sum0;
+            gz[n] += pre00 * sum1;
+            v[n] += pre00 * sum0;
+          }
+        }
+      }
+  }
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+  const T dxx   = dxInv * dxInv;
+  const T dyy   = dyInv * dyInv;
+  const T dzz   = dzInv * dzInv;
+  const T dxy   = dxInv * dyInv;
+  const T dxz   = dxInv * dzInv;
+  const T dyz   = dyInv * dzInv;
+
+  for (int iw = 0; iw < nw; iw++)
+  {
+    T* restrict gx  = grads[iw];
+    T* restrict gy  = grads[iw] + out_offset;
+    T* restrict gz  = grads[iw] + 2 * out_offset;
+    T* restrict hxx = hess[iw];
+    T* restrict hxy = hess[iw] + out_offset;
+    T* restrict hxz = hess[iw] + 2 * out_offset;
+    T* restrict hyy = hess[iw] + 3 * out_offset;
+    T* restrict hyz = hess[iw] + 4 * out_offset;
+    T* restrict hzz = hess[iw] + 5 * out_offset;
+#pragma omp simd
+    for (int n = 0; n < num_splines; n++)
+    {
+      gx[n] *= dxInv;
+      gy[n] *= dyInv;
+      gz[n] *= dzInv;
+      hxx[n] *= dxx;
+      hyy[n] *= dyy;
+      hzz[n] *= dzz;
+      hxy[n] *= dxy;
+      hxz[n] *= dxz;
+      hyz[n] *= dyz;
+    }
+  }
+}
+
+/** visit the stencil rows of a batch of positions
+ * @param f called as f(iw, pre00, c, coefs) for each position iw and each of its 16 rows,
+ *          coefs + k * zs, k = 0..3, are the rows weighted by c[k]
+ *
+ * The 16 rows of every position are visited in the order of their (x, y) grid
+ * column and then of their z offset, so that the rows of knots whose stencils
+ * overlap without sharing a cell are read one after the other and come from the
+ * cache after the first. The knots of a virtual particle set lie on a sphere
+ * around an ion and overlap only partially.
+ */
+template<typename SplineType, typename T, typename F>
+inline void mw_for_each_stencil_row(const SplineType* restrict spline_m,
+                                    const T* restrict x, const T* restrict y, const T* restrict z, int nw, F f)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+
+  struct Stencil
+  {
+    int ix, iy, iz;
+    T a[4], b[4], c[4];
+  };
+
+  /// row j of column i of the stencil of position iw, at the grid column (gx, gy)
+  struct Row
+  {
+    int gx, gy, gz;
+    int iw, i, j;
+  };
+
+  std::vector<Stencil> stencils(nw);
+  std::vector<Row> rows;
+  rows.reserve(16 * nw);
+  for (int iw = 0; iw < nw; iw++)
+  {
+    Stencil& s = stencils[iw];
+    spline2::computeLocationAndFractional(spline_m, x[iw], y[iw], z[iw], s.ix, s.iy, s.iz, s.a, s.b, s.c);
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+        rows.push_back(Row{s.ix + i, s.iy + j, s.iz, iw, i, j});
+  }
+
+  std::sort(rows.begin(), rows.end(), [](const Row& l, const Row& r) {
+    if (l.gx != r.gx)
+      return l.gx < r.gx;
+    if (l.gy != r.gy)
+      return l.gy < r.gy;
+    return l.gz < r.gz;
+  });
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  for (const Row& r : rows)
+  {
+    const Stencil& s         = stencils[r.iw];
+    const CT* restrict coefs = spline_m->coefs + (r.gx * xs + r.gy * ys + r.gz * zs);
+    f(r.iw, s.a[r.i] * s.b[r.j], s.c, coefs);
+  }
+}
+
+/** evaluate values at a batch of positions
+ * @param spline_m spline table shared by all the positions
+ * @param x,y,z coordinates of nw positions
+ * @param vals nw output buffers
+ * @param num_splines number of splines to evaluate
+ * @param nw number of positions
+ */
+template<typename SplineType, typename T>
+inline void mw_evaluate_v(const SplineType* restrict spline_m,
+                          const T* restrict x, const T* restrict y, const T* restrict z,
+                          T* const* restrict vals, size_t num_splines, int nw)
+{
+  using CT          = typename bspline_type<SplineType>::value_type;
+  const intptr_t zs = spline_m->z_stride;
+
+  for (int iw = 0; iw < nw; iw++)
+    std::fill(vals[iw], vals[iw] + num_splines, T());
+
+  mw_for_each_stencil_row(spline_m, x, y, z, nw, [&](int iw, T pre00, const T* c, const CT* restrict coefs) {
+    T* restrict v = vals[iw];
+    ASSUME_ALIGNED(v);
+    ASSUME_ALIGNED(coefs);
+#pragma omp simd
+    for (size_t n = 0; n < num_splines; n++)
+      v[n] += pre00 *
+          (c[0] * static_cast<T>(coefs[n]) + c[1] * static_cast<T>(coefs[n + zs]) +
+           c[2] * static_cast<T>(coefs[n + 2 * zs]) + c[3] * static_cast<T>(coefs[n + 3 * zs]));
+  });
+}
+
+/** evaluate_v_dot at a batch of positions
+ * @param row num_splines weights shared by all the positions
+ * @param results nw dot products, accumulated
+ */
+template<typename SplineType, typename T>
+inline void mw_evaluate_v_dot(const SplineType* restrict spline_m,
+                              const T* restrict x, const T* restrict y, const T* restrict z,
+                              const T* restrict row, T* restrict results, size_t num_splines, int nw)
+{
+  using CT          = typename bspline_type<SplineType>::value_type;
+  const intptr_t zs = spline_m->z_stride;
+
+  mw_for_each_stencil_row(spline_m, x, y, z, nw, [&](int iw, T pre00, const T* c, const CT* restrict coefs) {
+    ASSUME_ALIGNED(coefs);
+    T partial(0);
+#pragma omp simd reduction(+ : partial)
+    for (size_t n = 0; n < num_splines; n++)
+      partial += row[n] *
+          (c[0] * static_cast<T>(coefs[n]) + c[1] * static_cast<T>(coefs[n + zs]) +
+           c[2] * static_cast<T>(coefs[n + 2 * zs]) + c[3] * static_cast<T>(coefs[n + 3 * zs]));
+    results[iw] += pre00 * partial;
+  });
+}
+
+/** prefetch the coefficients read by an evaluation at (x,y,z)
+ * @param lead_lines number of cache lines requested at the start of each stencil row
+ *
+ * Issues software prefetches for the 16 stencil rows without waiting for
+ * them, so that evaluate_v/vgl/vgh at the same position, called after some
+ * other work, does not start on cold memory. Only the leading lines of a row
+ * are requested, the hardware stream prefetcher follows the rest of the row.
+ * Requesting whole rows stalls the calling thread once the miss buffers are full.
+ */
+template<typename SplineType, typename T>
+inline void prefetch_stencil(const SplineType* restrict spline_m, T x, T y, T z, size_t lead_lines = 2)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+  int ix, iy, iz;
+  spline2::computeLocation(spline_m, x, y, z, ix, iy, iz);
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  // the 4 z points of a stencil row are contiguous
+  const size_t row_bytes = std::min(4 * zs * sizeof(CT), lead_lines * spline2::prefetch_line_size);
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+    {
+      const char* row = reinterpret_cast<const char*>(spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs));
+      for (size_t offset = 0; offset < row_bytes; offset += spline2::prefetch_line_size)
+        spline2::prefetchLine(row + offset);
+    }
+}
+
 } // namespace MultiBsplineEval
 } // namespace qmcplusplus
 #endif
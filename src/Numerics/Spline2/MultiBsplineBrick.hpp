@@ -0,0 +1,263 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/**@file MultiBsplineBrick.hpp
+ *
+ * 3D spline evaluation routines for coefficients stored in BrickLayout.
+ * Same arithmetic as MultiBspline.hpp, only the location of the 64 stencil
+ * rows differs. The strides of the spline are not used.
+ */
+#ifndef QMCPLUSPLUS_MULTIEINSPLINE_BRICK_HPP
+#define QMCPLUSPLUS_MULTIEINSPLINE_BRICK_HPP
+
+#include <Numerics/Spline2/MultiBsplineData.hpp>
+#include <Numerics/Spline2/MultiBsplineEvalHelper.hpp>
+#include <algorithm>
+
+namespace qmcplusplus
+{
+namespace MultiBsplineEval
+{
+template<typename SplineType, typename T>
+inline void evaluate_v(const SplineType* restrict spline_m, const BrickLayout& layout, T x, T y, T z,
+                       T* restrict vals, size_t num_splines)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  constexpr T zero(0);
+  ASSUME_ALIGNED(vals);
+  std::fill(vals, vals + num_splines, zero);
+
+  for (size_t i = 0; i < 4; i++)
+    for (size_t j = 0; j < 4; j++)
+    {
+      const T pre00              = a[i] * b[j];
+      const CT* restrict coefs    = spline_m->coefs + layout.offset(ix + i, iy + j, iz);
+      const CT* restrict coefszs  = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 1);
+      const CT* restrict coefs2zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 2);
+      const CT* restrict coefs3zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 3);
+      ASSUME_ALIGNED(coefs);
+      ASSUME_ALIGNED(coefszs);
+      ASSUME_ALIGNED(coefs2zs);
+      ASSUME_ALIGNED(coefs3zs);
+#pragma omp simd
+      for (size_t n = 0; n < num_splines; n++)
+        vals[n] += pre00 *
+            (c[0] * static_cast<T>(coefs[n]) + c[1] * static_cast<T>(coefszs[n]) +
+             c[2] * static_cast<T>(coefs2zs[n]) + c[3] * static_cast<T>(coefs3zs[n]));
+    }
+}
+
+template<typename SplineType, typename T>
+inline void evaluate_vgl(const SplineType* restrict spline_m, const BrickLayout& layout, T x, T y, T z,
+                         T* restrict vals, T* restrict grads, T* restrict lapl, size_t num_splines,
+                         size_t out_offset)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a,
+                                        d2b, d2c);
+
+  ASSUME_ALIGNED(vals);
+  T* restrict gx = grads;
+  ASSUME_ALIGNED(gx);
+  T* restrict gy = grads + out_offset;
+  ASSUME_ALIGNED(gy);
+  T* restrict gz = grads + 2 * out_offset;
+  ASSUME_ALIGNED(gz);
+  ASSUME_ALIGNED(lapl);
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  const T dxInv2 = dxInv * dxInv;
+  const T dyInv2 = dyInv * dyInv;
+  const T dzInv2 = dzInv * dzInv;
+
+  std::fill(vals, vals + num_splines, T());
+  std::fill(gx, gx + num_splines, T());
+  std::fill(gy, gy + num_splines, T());
+  std::fill(gz, gz + num_splines, T());
+  std::fill(lapl, lapl + num_splines, T());
+
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+    {
+      const T pre2  = d2a[i] * b[j] * dxInv2 + a[i] * d2b[j] * dyInv2;
+      const T pre0z = a[i] * b[j] * dzInv2;
+      const T pre10 = da[i] * b[j];
+      const T pre00 = a[i] * b[j];
+      const T pre01 = a[i] * db[j];
+
+      const CT* restrict coefs    = spline_m->coefs + layout.offset(ix + i, iy + j, iz);
+      const CT* restrict coefszs  = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 1);
+      const CT* restrict coefs2zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 2);
+      const CT* restrict coefs3zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 3);
+      ASSUME_ALIGNED(coefs);
+      ASSUME_ALIGNED(coefszs);
+      ASSUME_ALIGNED(coefs2zs);
+      ASSUME_ALIGNED(coefs3zs);
+
+#pragma omp simd
+      for (int n = 0; n < num_splines; n++)
+      {
+        const T coefsv    = coefs[n];
+        const T coefsvzs  = coefszs[n];
+        const T coefsv2zs = coefs2zs[n];
+        const T coefsv3zs = coefs3zs[n];
+
+        T sum0 = c[0] * coefsv + c[1] * coefsvzs + c[2] * coefsv2zs + c[3] * coefsv3zs;
+        T sum1 = dc[0] * coefsv + dc[1] * coefsvzs + dc[2] * coefsv2zs + dc[3] * coefsv3zs;
+        T sum2 = d2c[0] * coefsv + d2c[1] * coefsvzs + d2c[2] * coefsv2zs + d2c[3] * coefsv3zs;
+        gx[n] += pre10 * sum0;
+        gy[n] += pre01 * sum0;
+        gz[n] += pre00 * sum1;
+        lapl[n] += pre2 * sum0 + pre0z * sum2;
+        vals[n] += pre00 * sum0;
+      }
+    }
+
+#pragma omp simd
+  for (int n = 0; n < num_splines; n++)
+  {
+    gx[n] *= dxInv;
+    gy[n] *= dyInv;
+    gz[n] *= dzInv;
+  }
+}
+
+template<typename SplineType, typename T>
+inline void evaluate_vgh(const SplineType* restrict spline_m, const BrickLayout& layout, T x, T y, T z,
+                         T* restrict vals, T* restrict grads, T* restrict hess, size_t num_splines)
+{
+  using CT = typename bspline_type<SplineType>::value_type;
+
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a,
+                                        d2b, d2c);
+
+  const size_t out_offset = spline_m->num_splines;
+
+  ASSUME_ALIGNED(vals);
+  T* restrict gx = grads;
+  ASSUME_ALIGNED(gx);
+  T* restrict gy = grads + out_offset;
+  ASSUME_ALIGNED(gy);
+  T* restrict gz = grads + 2 * out_offset;
+  ASSUME_ALIGNED(gz);
+
+  T* restrict hxx = hess;
+  ASSUME_ALIGNED(hxx);
+  T* restrict hxy = hess + out_offset;
+  ASSUME_ALIGNED(hxy);
+  T* restrict hxz = hess + 2 * out_offset;
+  ASSUME_ALIGNED(hxz);
+  T* restrict hyy = hess + 3 * out_offset;
+  ASSUME_ALIGNED(hyy);
+  T* restrict hyz = hess + 4 * out_offset;
+  ASSUME_ALIGNED(hyz);
+  T* restrict hzz = hess + 5 * out_offset;
+  ASSUME_ALIGNED(hzz);
+
+  std::fill(vals, vals + num_splines, T());
+  std::fill(gx, gx + num_splines, T());
+  std::fill(gy, gy + num_splines, T());
+  std::fill(gz, gz + num_splines, T());
+  std::fill(hxx, hxx + num_splines, T());
+  std::fill(hxy, hxy + num_splines, T());
+  std::fill(hxz, hxz + num_splines, T());
+  std::fill(hyy, hyy + num_splines, T());
+  std::fill(hyz, hyz + num_splines, T());
+  std::fill(hzz, hzz + num_splines, T());
+
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+    {
+      const CT* restrict coefs    = spline_m->coefs + layout.offset(ix + i, iy + j, iz);
+      const CT* restrict coefszs  = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 1);
+      const CT* restrict coefs2zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 2);
+      const CT* restrict coefs3zs = spline_m->coefs + layout.offset(ix + i, iy + j, iz + 3);
+      ASSUME_ALIGNED(coefs);
+      ASSUME_ALIGNED(coefszs);
+      ASSUME_ALIGNED(coefs2zs);
+      ASSUME_ALIGNED(coefs3zs);
+
+      const T pre20 = d2a[i] * b[j];
+      const T pre10 = da[i] * b[j];
+      const T pre00 = a[i] * b[j];
+      const T pre11 = da[i] * db[j];
+      const T pre01 = a[i] * db[j];
+      const T pre02 = a[i] * d2b[j];
+
+      const int iSplitPoint = num_splines;
+#pragma omp simd
+      for (int n = 0; n < iSplitPoint; n++)
+      {
+        T coefsv    = coefs[n];
+        T coefsvzs  = coefszs[n];
+        T coefsv2zs = coefs2zs[n];
+        T coefsv3zs = coefs3zs[n];
+
+        T sum0 = c[0] * coefsv + c[1] * coefsvzs + c[2] * coefsv2zs + c[3] * coefsv3zs;
+        T sum1 = dc[0] * coefsv + dc[1] * coefsvzs + dc[2] * coefsv2zs + dc[3] * coefsv3zs;
+        T sum2 = d2c[0] * coefsv + d2c[1] * coefsvzs + d2c[2] * coefsv2zs + d2c[3] * coefsv3zs;
+
+        hxx[n] += pre20 * sum0;
+        hxy[n] += pre11 * sum0;
+        hxz[n] += pre10 * sum1;
+        hyy[n] += pre02 * sum0;
+        hyz[n] += pre01 * sum1;
+        hzz[n] += pre00 * sum2;
+        gx[n] += pre10 * sum0;
+        gy[n] += pre01 * sum0;
+        gz[n] += pre00 * sum1;
+        vals[n] += pre00 * sum0;
+      }
+    }
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+  const T dxx   = dxInv * dxInv;
+  const T dyy   = dyInv * dyInv;
+  const T dzz   = dzInv * dzInv;
+  const T dxy   = dxInv * dyInv;
+  const T dxz   = dxInv * dzInv;
+  const T dyz   = dyInv * dzInv;
+
+#pragma omp simd
+  for (int n = 0; n < num_splines; n++)
+  {
+    gx[n] *= dxInv;
+    gy[n] *= dyInv;
+    gz[n] *= dzInv;
+    hxx[n] *= dxx;
+    hyy[n] *= dyy;
+    hzz[n] *= dzz;
+    hxy[n] *= dxy;
+    hxz[n] *= dxz;
+    hyz[n] *= dyz;
+  }
+}
+
+} // namespace MultiBsplineEval
+} // namespace qmcplusplus
+#endif
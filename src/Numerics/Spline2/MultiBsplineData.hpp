@@ -16,6 +16,11 @@
 #ifndef QMCPLUSPLUS_MULTIEINSPLINE_DATA_HPP
 #define QMCPLUSPLUS_MULTIEINSPLINE_DATA_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 namespace qmcplusplus
 {
 /** class for cublic spline parameters
@@ -107,6 +112,67 @@ struct MultiBsplineData
   }
 };
 
+/** blocked layout of the coefficients in 4x4x4 bricks of grid points
+ *
+ * The bricks are stored along a Morton curve and the 64 grid points of a brick
+ * are stored row-major, each holding stride coefficients like the plain layout.
+ * A 4x4x4 stencil spans at most 8 bricks which are close along the curve.
+ * Bricks are ranked by their Morton code so that no memory is wasted when the
+ * number of bricks is not a power of two.
+ */
+struct BrickLayout
+{
+  /// grid points along each edge of a brick
+  static constexpr int brick_size = 4;
+  /// number of bricks in each direction
+  int nbx, nby, nbz;
+  /// number of coefficients per grid point, the z_stride of the plain layout
+  intptr_t stride;
+  /// number of coefficients of the bricked table
+  size_t coefs_size;
+  /// position of each brick along the curve, indexed by brick coordinates
+  std::vector<int> brick_rank;
+
+  /** set up the layout of a table
+   * @param Nx,Ny,Nz number of grid points including the boundary padding
+   * @param stride_in number of coefficients per grid point
+   */
+  BrickLayout(int Nx, int Ny, int Nz, intptr_t stride_in)
+      : nbx((Nx + brick_size - 1) / brick_size),
+        nby((Ny + brick_size - 1) / brick_size),
+        nbz((Nz + brick_size - 1) / brick_size),
+        stride(stride_in)
+  {
+    const int nbricks = nbx * nby * nbz;
+    std::vector<std::pair<uint64_t, int>> codes(nbricks);
+    for (int bx = 0, b = 0; bx < nbx; bx++)
+      for (int by = 0; by < nby; by++)
+        for (int bz = 0; bz < nbz; bz++, b++)
+          codes[b] = std::make_pair((spread_bits(bx) << 2) | (spread_bits(by) << 1) | spread_bits(bz), b);
+    std::sort(codes.begin(), codes.end());
+    brick_rank.resize(nbricks);
+    for (int r = 0; r < nbricks; r++)
+      brick_rank[codes[r].second] = r;
+    coefs_size = static_cast<size_t>(nbricks) * brick_size * brick_size * brick_size * stride;
+  }
+
+  /// offset of the coefficients of grid point (ix, iy, iz)
+  inline intptr_t offset(int ix, int iy, int iz) const
+  {
+    const intptr_t brick = brick_rank[((ix >> 2) * nby + (iy >> 2)) * nbz + (iz >> 2)];
+    return ((brick << 6) + ((ix & 3) << 4) + ((iy & 3) << 2) + (iz & 3)) * stride;
+  }
+
+  /// spread the bits of i to every third bit
+  static uint64_t spread_bits(uint64_t i)
+  {
+    uint64_t r = 0;
+    for (int bit = 0; bit < 21; bit++)
+      r |= ((i >> bit) & 1u) << (3 * bit);
+    return r;
+  }
+};
+
 } // namespace qmcplusplus
 
 #endif
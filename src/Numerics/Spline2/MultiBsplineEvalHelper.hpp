@@ -63,13 +63,35 @@ inline void getSplineBound(T x, TRESIDUAL& dx, int& ind, int nmax)
   }
 }
 
+/** compute only the location of the spline grid point, see computeLocationAndFractional
+ */
+template<typename SplineType, typename T>
+inline void computeLocation(const SplineType* restrict spline_m, T x, T y, T z, int& ix, int& iy, int& iz)
+{
+  T tx, ty, tz;
+  getSplineBound((x - spline_m->x_grid.start) * spline_m->x_grid.delta_inv, tx, ix, spline_m->x_grid.num - 1);
+  getSplineBound((y - spline_m->y_grid.start) * spline_m->y_grid.delta_inv, ty, iy, spline_m->y_grid.num - 1);
+  getSplineBound((z - spline_m->z_grid.start) * spline_m->z_grid.delta_inv, tz, iz, spline_m->z_grid.num - 1);
+}
+
+/// size of the cache lines touched by prefetchLine
+constexpr size_t prefetch_line_size = 64;
+
+/// prefetch the cache line holding p into L2 for reading, a no-op if the compiler has no prefetch builtin
+inline void prefetchLine(const void* p)
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(p, 0, 2);
+#endif
+}
+
 /** define computeLocationAndFractional: common to any implementation
  * compute the location of the spline grid point and residual coordinates
  * also it precomputes auxilary array a, b and c
  */
-template<typename T>
+template<typename SplineType, typename T>
 inline void computeLocationAndFractional(
-    const typename qmcplusplus::bspline_traits<T, 3>::SplineType* restrict spline_m, T x, T y, T z,
+    const SplineType* restrict spline_m, T x, T y, T z,
     int& ix, int& iy, int& iz, T a[4], T b[4], T c[4])
 {
   x -= spline_m->x_grid.start;
@@ -91,9 +113,9 @@ inline void computeLocationAndFractional(
  * compute the location of the spline grid point and residual coordinates
  * also it precomputes auxilary array (a,b,c) (da,db,dc) (d2a,d2b,d2c)
  */
-template<typename T>
+template<typename SplineType, typename T>
 inline void computeLocationAndFractional(
-    const typename qmcplusplus::bspline_traits<T, 3>::SplineType* restrict spline_m, T x, T y, T z,
+    const SplineType* restrict spline_m, T x, T y, T z,
     int& ix, int& iy, int& iz, T a[4], T b[4], T c[4], T da[4], T db[4], T dc[4], T d2a[4],
     T d2b[4], T d2c[4])
 {
@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/**@file MultiBsplineSIMD.hpp
+ *
+ * AVX2 and AVX-512 versions of the 3D spline evaluation routines and their
+ * runtime selection. The kernels are compiled for their instruction set
+ * regardless of the compiler flags and only called when the cpu supports it,
+ * so a portable build still uses the widest vectors available at run time.
+ *
+ * Only float and double coefficients evaluated in the same precision are
+ * dispatched. The other combinations use the portable MultiBspline.hpp kernels.
+ * Tiles of 16, 32, 64 or 128 splines use kernels specialized for the width.
+ */
+#ifndef QMCPLUSPLUS_MULTIEINSPLINE_SIMD_HPP
+#define QMCPLUSPLUS_MULTIEINSPLINE_SIMD_HPP
+
+#include <Numerics/Spline2/MultiBspline.hpp>
+#include <string>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__INTEL_COMPILER)
+#define QMC_SPLINE_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace qmcplusplus
+{
+/// instruction sets of the spline kernels, ordered by vector width
+enum class SplineISA
+{
+  portable,
+  avx2,
+  avx512
+};
+
+/// widest instruction set supported by the running cpu
+inline SplineISA detectSplineISA()
+{
+#ifdef QMC_SPLINE_SIMD
+  static const SplineISA detected = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return SplineISA::avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return SplineISA::avx2;
+    return SplineISA::portable;
+  }();
+  return detected;
+#else
+  return SplineISA::portable;
+#endif
+}
+
+inline bool isSplineISASupported(SplineISA isa) { return isa <= detectSplineISA(); }
+
+inline std::string getSplineISAName(SplineISA isa)
+{
+  switch (isa)
+  {
+  case SplineISA::avx2:
+    return "avx2";
+  case SplineISA::avx512:
+    return "avx512";
+  default:
+    return "portable";
+  }
+}
+
+#ifdef QMC_SPLINE_SIMD
+
+/** number of chunks of a fixed-width kernel accumulated together
+ * @param chunks vector chunks in the tile, a power of two
+ * @param budget chunks whose accumulators fit in the free registers
+ */
+constexpr int simd_group_size(int chunks, int budget)
+{
+  return (chunks > 1 && budget >= 2) ? 2 * simd_group_size(chunks / 2, budget / 2) : 1;
+}
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+namespace spline2_avx2
+{
+template<typename T>
+struct vec;
+
+template<>
+struct vec<double>
+{
+  using reg                      = __m256d;
+  using mask                     = __m256i;
+  static constexpr int width     = 4;
+  static constexpr int registers = 16;
+  static inline reg zero() { return _mm256_setzero_pd(); }
+  static inline reg set1(double a) { return _mm256_set1_pd(a); }
+  static inline reg load(const double* p) { return _mm256_loadu_pd(p); }
+  static inline reg load(const double* p, mask m) { return _mm256_maskload_pd(p, m); }
+  static inline reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+  static inline void store(double* p, reg a) { _mm256_storeu_pd(p, a); }
+  static inline void store(double* p, reg a, mask m) { _mm256_maskstore_pd(p, m, a); }
+  /// lanes below n enabled
+  static inline mask tail_mask(size_t n)
+  {
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast<long long>(n)), _mm256_setr_epi64x(0, 1, 2, 3));
+  }
+};
+
+template<>
+struct vec<float>
+{
+  using reg                      = __m256;
+  using mask                     = __m256i;
+  static constexpr int width     = 8;
+  static constexpr int registers = 16;
+  static inline reg zero() { return _mm256_setzero_ps(); }
+  static inline reg set1(float a) { return _mm256_set1_ps(a); }
+  static inline reg load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline reg load(const float* p, mask m) { return _mm256_maskload_ps(p, m); }
+  static inline reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+  static inline void store(float* p, reg a) { _mm256_storeu_ps(p, a); }
+  static inline void store(float* p, reg a, mask m) { _mm256_maskstore_ps(p, m, a); }
+  static inline mask tail_mask(size_t n)
+  {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(n < 8 ? n : 8)),
+                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+};
+
+#include <Numerics/Spline2/MultiBsplineSIMDKernels.hpp>
+} // namespace spline2_avx2
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace spline2_avx512
+{
+template<typename T>
+struct vec;
+
+template<>
+struct vec<double>
+{
+  using reg                      = __m512d;
+  using mask                     = __mmask8;
+  static constexpr int width     = 8;
+  static constexpr int registers = 32;
+  static inline reg zero() { return _mm512_setzero_pd(); }
+  static inline reg set1(double a) { return _mm512_set1_pd(a); }
+  static inline reg load(const double* p) { return _mm512_loadu_pd(p); }
+  static inline reg load(const double* p, mask m) { return _mm512_maskz_loadu_pd(m, p); }
+  static inline reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+  static inline void store(double* p, reg a) { _mm512_storeu_pd(p, a); }
+  static inline void store(double* p, reg a, mask m) { _mm512_mask_storeu_pd(p, m, a); }
+  static inline mask tail_mask(size_t n) { return n < 8 ? static_cast<mask>((1u << n) - 1) : mask(0xff); }
+};
+
+template<>
+struct vec<float>
+{
+  using reg                      = __m512;
+  using mask                     = __mmask16;
+  static constexpr int width     = 16;
+  static constexpr int registers = 32;
+  static inline reg zero() { return _mm512_setzero_ps(); }
+  static inline reg set1(float a) { return _mm512_set1_ps(a); }
+  static inline reg load(const float* p) { return _mm512_loadu_ps(p); }
+  static inline reg load(const float* p, mask m) { return _mm512_maskz_loadu_ps(m, p); }
+  static inline reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+  static inline void store(float* p, reg a) { _mm512_storeu_ps(p, a); }
+  static inline void store(float* p, reg a, mask m) { _mm512_mask_storeu_ps(p, m, a); }
+  static inline mask tail_mask(size_t n) { return n < 16 ? static_cast<mask>((1u << n) - 1) : mask(0xffff); }
+};
+
+#include <Numerics/Spline2/MultiBsplineSIMDKernels.hpp>
+} // namespace spline2_avx512
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
+
+namespace MultiBsplineEval
+{
+/// calls the kernels of an instruction set if the coefficient and value types allow it
+template<bool SAME_TYPE>
+struct simd_dispatch
+{
+  template<typename SplineType, typename T>
+  static bool evaluate_v(SplineISA, const SplineType*, T, T, T, T*, size_t)
+  {
+    return false;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_v_dot(SplineISA, const SplineType*, T, T, T, const T*, size_t, T&)
+  {
+    return false;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_vgl(SplineISA, const SplineType*, T, T, T, T*, T*, T*, size_t, size_t)
+  {
+    return false;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_vgh(SplineISA, const SplineType*, T, T, T, T*, T*, T*, size_t)
+  {
+    return false;
+  }
+};
+
+#ifdef QMC_SPLINE_SIMD
+template<>
+struct simd_dispatch<true>
+{
+  template<typename SplineType, typename T>
+  static bool evaluate_v(SplineISA isa, const SplineType* spline_m, T x, T y, T z, T* vals, size_t num_splines)
+  {
+    if (isa == SplineISA::avx512)
+      spline2_avx512::evaluate_v_tile(spline_m, x, y, z, vals, num_splines);
+    else if (isa == SplineISA::avx2)
+      spline2_avx2::evaluate_v_tile(spline_m, x, y, z, vals, num_splines);
+    else
+      return false;
+    return true;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_v_dot(SplineISA isa, const SplineType* spline_m, T x, T y, T z, const T* row,
+                             size_t num_splines, T& result)
+  {
+    if (isa == SplineISA::avx512)
+      result = spline2_avx512::evaluate_v_dot_tile(spline_m, x, y, z, row, num_splines);
+    else if (isa == SplineISA::avx2)
+      result = spline2_avx2::evaluate_v_dot_tile(spline_m, x, y, z, row, num_splines);
+    else
+      return false;
+    return true;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_vgl(SplineISA isa, const SplineType* spline_m, T x, T y, T z, T* vals, T* grads, T* lapl,
+                           size_t num_splines, size_t out_offset)
+  {
+    if (isa == SplineISA::avx512)
+      spline2_avx512::evaluate_vgl_tile(spline_m, x, y, z, vals, grads, lapl, num_splines, out_offset);
+    else if (isa == SplineISA::avx2)
+      spline2_avx2::evaluate_vgl_tile(spline_m, x, y, z, vals, grads, lapl, num_splines, out_offset);
+    else
+      return false;
+    return true;
+  }
+  template<typename SplineType, typename T>
+  static bool evaluate_vgh(SplineISA isa, const SplineType* spline_m, T x, T y, T z, T* vals, T* grads, T* hess,
+                           size_t num_splines)
+  {
+    if (isa == SplineISA::avx512)
+      spline2_avx512::evaluate_vgh_tile(spline_m, x, y, z, vals, grads, hess, num_splines);
+    else if (isa == SplineISA::avx2)
+      spline2_avx2::evaluate_vgh_tile(spline_m, x, y, z, vals, grads, hess, num_splines);
+    else
+      return false;
+    return true;
+  }
+};
+#endif
+
+template<typename SplineType, typename T>
+using is_simd_dispatched =
+    std::integral_constant<bool,
+                           std::is_same<typename bspline_type<SplineType>::value_type, T>::value &&
+                               (std::is_same<T, float>::value || std::is_same<T, double>::value)>;
+
+/** evaluate_v with the kernels of isa, falling back to the portable ones
+ *
+ * isa must be supported by the running cpu, see isSplineISASupported.
+ */
+template<typename SplineType, typename T>
+inline void evaluate_v(SplineISA isa, const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                       size_t num_splines)
+{
+  if (!simd_dispatch<is_simd_dispatched<SplineType, T>::value>::evaluate_v(isa, spline_m, x, y, z, vals,
+                                                                            num_splines))
+    evaluate_v(spline_m, x, y, z, vals, num_splines);
+}
+
+template<typename SplineType, typename T>
+inline T evaluate_v_dot(SplineISA isa, const SplineType* restrict spline_m, T x, T y, T z, const T* restrict row,
+                        size_t num_splines)
+{
+  T result;
+  if (!simd_dispatch<is_simd_dispatched<SplineType, T>::value>::evaluate_v_dot(isa, spline_m, x, y, z, row,
+                                                                                num_splines, result))
+    result = evaluate_v_dot(spline_m, x, y, z, row, num_splines);
+  return result;
+}
+
+template<typename SplineType, typename T>
+inline void evaluate_vgl(SplineISA isa, const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                         T* restrict grads, T* restrict lapl, size_t num_splines, size_t out_offset)
+{
+  if (!simd_dispatch<is_simd_dispatched<SplineType, T>::value>::evaluate_vgl(isa, spline_m, x, y, z, vals, grads,
+                                                                              lapl, num_splines, out_offset))
+    evaluate_vgl(spline_m, x, y, z, vals, grads, lapl, num_splines, out_offset);
+}
+
+template<typename SplineType, typename T>
+inline void evaluate_vgh(SplineISA isa, const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                         T* restrict grads, T* restrict hess, size_t num_splines)
+{
+  if (!simd_dispatch<is_simd_dispatched<SplineType, T>::value>::evaluate_vgh(isa, spline_m, x, y, z, vals, grads,
+                                                                              hess, num_splines))
+    evaluate_vgh(spline_m, x, y, z, vals, grads, hess, num_splines);
+}
+
+} // namespace MultiBsplineEval
+} // namespace qmcplusplus
+#endif
@@ -0,0 +1,640 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/**@file MultiBsplineSIMDKernels.hpp
+ *
+ * Explicitly vectorized 3D spline evaluation, written against the vec<T>
+ * operations of the enclosing namespace. There is no include guard: the file is
+ * included by MultiBsplineSIMD.hpp once per instruction set, inside a region
+ * compiled for that instruction set.
+ *
+ * Each chunk of vec<T>::width splines accumulates all the 64 stencil
+ * contributions in registers and is stored once. Only the last chunk is masked.
+ * The *_fixed variants take the number of splines as a template parameter,
+ * *_tile pick one of them from the runtime width.
+ */
+
+template<typename T, typename SplineType>
+inline void evaluate_v(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals, size_t num_splines)
+{
+  using V   = vec<T>;
+  using reg = typename V::reg;
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  const reg c0 = V::set1(c[0]), c1 = V::set1(c[1]), c2 = V::set1(c[2]), c3 = V::set1(c[3]);
+
+  for (size_t n0 = 0; n0 < num_splines; n0 += V::width)
+  {
+    const bool full   = n0 + V::width <= num_splines;
+    const auto m      = V::tail_mask(num_splines - n0);
+    reg v             = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs) + n0;
+        const reg r0   = full ? V::load(coefs) : V::load(coefs, m);
+        const reg r1   = full ? V::load(coefs + zs) : V::load(coefs + zs, m);
+        const reg r2   = full ? V::load(coefs + 2 * zs) : V::load(coefs + 2 * zs, m);
+        const reg r3   = full ? V::load(coefs + 3 * zs) : V::load(coefs + 3 * zs, m);
+        const reg sum0 = V::fmadd(c3, r3, V::fmadd(c2, r2, V::fmadd(c1, r1, V::mul(c0, r0))));
+        v              = V::fmadd(V::set1(a[i] * b[j]), sum0, v);
+      }
+    if (full)
+      V::store(vals + n0, v);
+    else
+      V::store(vals + n0, v, m);
+  }
+}
+
+/// evaluate_v_dot, each chunk of values is reduced with the row instead of being stored
+template<typename T, typename SplineType>
+inline T evaluate_v_dot(const SplineType* restrict spline_m, T x, T y, T z, const T* restrict row, size_t num_splines)
+{
+  using V   = vec<T>;
+  using reg = typename V::reg;
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  const reg c0 = V::set1(c[0]), c1 = V::set1(c[1]), c2 = V::set1(c[2]), c3 = V::set1(c[3]);
+
+  reg acc = V::zero();
+  for (size_t n0 = 0; n0 < num_splines; n0 += V::width)
+  {
+    const bool full = n0 + V::width <= num_splines;
+    const auto m    = V::tail_mask(num_splines - n0);
+    reg v           = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs) + n0;
+        const reg r0   = full ? V::load(coefs) : V::load(coefs, m);
+        const reg r1   = full ? V::load(coefs + zs) : V::load(coefs + zs, m);
+        const reg r2   = full ? V::load(coefs + 2 * zs) : V::load(coefs + 2 * zs, m);
+        const reg r3   = full ? V::load(coefs + 3 * zs) : V::load(coefs + 3 * zs, m);
+        const reg sum0 = V::fmadd(c3, r3, V::fmadd(c2, r2, V::fmadd(c1, r1, V::mul(c0, r0))));
+        v              = V::fmadd(V::set1(a[i] * b[j]), sum0, v);
+      }
+    // masked lanes of v and of the row are zero
+    acc = V::fmadd(v, full ? V::load(row + n0) : V::load(row + n0, m), acc);
+  }
+  T lanes[V::width];
+  V::store(lanes, acc);
+  T result(0);
+  for (int l = 0; l < V::width; l++)
+    result += lanes[l];
+  return result;
+}
+
+template<typename T, typename SplineType>
+inline void evaluate_vgl(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals, T* restrict grads,
+                         T* restrict lapl, size_t num_splines, size_t out_offset)
+{
+  using V   = vec<T>;
+  using reg = typename V::reg;
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a, d2b, d2c);
+
+  const intptr_t xs = spline_m->x_stride;
+  const intptr_t ys = spline_m->y_stride;
+  const intptr_t zs = spline_m->z_stride;
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  T* restrict gx = grads;
+  T* restrict gy = grads + out_offset;
+  T* restrict gz = grads + 2 * out_offset;
+
+  for (size_t n0 = 0; n0 < num_splines; n0 += V::width)
+  {
+    const bool full = n0 + V::width <= num_splines;
+    const auto m    = V::tail_mask(num_splines - n0);
+    reg v = V::zero(), vgx = V::zero(), vgy = V::zero(), vgz = V::zero();
+    reg vl = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre2  = V::set1(d2a[i] * b[j] * dxInv * dxInv + a[i] * d2b[j] * dyInv * dyInv);
+        const reg pre0z = V::set1(a[i] * b[j] * dzInv * dzInv);
+        const reg pre10 = V::set1(da[i] * b[j]);
+        const reg pre00 = V::set1(a[i] * b[j]);
+        const reg pre01 = V::set1(a[i] * db[j]);
+
+        const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs) + n0;
+        const reg r0 = full ? V::load(coefs) : V::load(coefs, m);
+        const reg r1 = full ? V::load(coefs + zs) : V::load(coefs + zs, m);
+        const reg r2 = full ? V::load(coefs + 2 * zs) : V::load(coefs + 2 * zs, m);
+        const reg r3 = full ? V::load(coefs + 3 * zs) : V::load(coefs + 3 * zs, m);
+
+        const reg sum0 =
+            V::fmadd(V::set1(c[3]), r3, V::fmadd(V::set1(c[2]), r2, V::fmadd(V::set1(c[1]), r1, V::mul(V::set1(c[0]), r0))));
+        const reg sum1 = V::fmadd(V::set1(dc[3]), r3,
+                                  V::fmadd(V::set1(dc[2]), r2, V::fmadd(V::set1(dc[1]), r1, V::mul(V::set1(dc[0]), r0))));
+        const reg sum2 = V::fmadd(V::set1(d2c[3]), r3,
+                                  V::fmadd(V::set1(d2c[2]), r2,
+                                           V::fmadd(V::set1(d2c[1]), r1, V::mul(V::set1(d2c[0]), r0))));
+
+        vgx = V::fmadd(pre10, sum0, vgx);
+        vgy = V::fmadd(pre01, sum0, vgy);
+        vgz = V::fmadd(pre00, sum1, vgz);
+        vl  = V::fmadd(pre2, sum0, V::fmadd(pre0z, sum2, vl));
+        v   = V::fmadd(pre00, sum0, v);
+      }
+    vgx = V::mul(vgx, V::set1(dxInv));
+    vgy = V::mul(vgy, V::set1(dyInv));
+    vgz = V::mul(vgz, V::set1(dzInv));
+    if (full)
+    {
+      V::store(vals + n0, v);
+      V::store(gx + n0, vgx);
+      V::store(gy + n0, vgy);
+      V::store(gz + n0, vgz);
+      V::store(lapl + n0, vl);
+    }
+    else
+    {
+      V::store(vals + n0, v, m);
+      V::store(gx + n0, vgx, m);
+      V::store(gy + n0, vgy, m);
+      V::store(gz + n0, vgz, m);
+      V::store(lapl + n0, vl, m);
+    }
+  }
+}
+
+template<typename T, typename SplineType>
+inline void evaluate_vgh(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals, T* restrict grads,
+                         T* restrict hess, size_t num_splines)
+{
+  using V   = vec<T>;
+  using reg = typename V::reg;
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a, d2b, d2c);
+
+  const intptr_t xs       = spline_m->x_stride;
+  const intptr_t ys       = spline_m->y_stride;
+  const intptr_t zs       = spline_m->z_stride;
+  const size_t out_offset = spline_m->num_splines;
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  T* restrict out[10] = {vals,
+                         grads,
+                         grads + out_offset,
+                         grads + 2 * out_offset,
+                         hess,
+                         hess + out_offset,
+                         hess + 2 * out_offset,
+                         hess + 3 * out_offset,
+                         hess + 4 * out_offset,
+                         hess + 5 * out_offset};
+  const T scale[10] = {T(1),
+                       dxInv,
+                       dyInv,
+                       dzInv,
+                       dxInv * dxInv,
+                       dxInv * dyInv,
+                       dxInv * dzInv,
+                       dyInv * dyInv,
+                       dyInv * dzInv,
+                       dzInv * dzInv};
+
+  for (size_t n0 = 0; n0 < num_splines; n0 += V::width)
+  {
+    const bool full = n0 + V::width <= num_splines;
+    const auto m    = V::tail_mask(num_splines - n0);
+    reg v = V::zero(), vgx = V::zero(), vgy = V::zero(), vgz = V::zero();
+    reg hxx = V::zero(), hxy = V::zero(), hxz = V::zero(), hyy = V::zero(), hyz = V::zero(), hzz = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre20 = V::set1(d2a[i] * b[j]);
+        const reg pre10 = V::set1(da[i] * b[j]);
+        const reg pre00 = V::set1(a[i] * b[j]);
+        const reg pre11 = V::set1(da[i] * db[j]);
+        const reg pre01 = V::set1(a[i] * db[j]);
+        const reg pre02 = V::set1(a[i] * d2b[j]);
+
+        const T* restrict coefs = spline_m->coefs + ((ix + i) * xs + (iy + j) * ys + iz * zs) + n0;
+        const reg r0 = full ? V::load(coefs) : V::load(coefs, m);
+        const reg r1 = full ? V::load(coefs + zs) : V::load(coefs + zs, m);
+        const reg r2 = full ? V::load(coefs + 2 * zs) : V::load(coefs + 2 * zs, m);
+        const reg r3 = full ? V::load(coefs + 3 * zs) : V::load(coefs + 3 * zs, m);
+
+        const reg sum0 =
+            V::fmadd(V::set1(c[3]), r3, V::fmadd(V::set1(c[2]), r2, V::fmadd(V::set1(c[1]), r1, V::mul(V::set1(c[0]), r0))));
+        const reg sum1 = V::fmadd(V::set1(dc[3]), r3,
+                                  V::fmadd(V::set1(dc[2]), r2, V::fmadd(V::set1(dc[1]), r1, V::mul(V::set1(dc[0]), r0))));
+        const reg sum2 = V::fmadd(V::set1(d2c[3]), r3,
+                                  V::fmadd(V::set1(d2c[2]), r2,
+                                           V::fmadd(V::set1(d2c[1]), r1, V::mul(V::set1(d2c[0]), r0))));
+
+        hxx = V::fmadd(pre20, sum0, hxx);
+        hxy = V::fmadd(pre11, sum0, hxy);
+        hxz = V::fmadd(pre10, sum1, hxz);
+        hyy = V::fmadd(pre02, sum0, hyy);
+        hyz = V::fmadd(pre01, sum1, hyz);
+        hzz = V::fmadd(pre00, sum2, hzz);
+        vgx = V::fmadd(pre10, sum0, vgx);
+        vgy = V::fmadd(pre01, sum0, vgy);
+        vgz = V::fmadd(pre00, sum1, vgz);
+        v   = V::fmadd(pre00, sum0, v);
+      }
+    const reg acc[10] = {v, vgx, vgy, vgz, hxx, hxy, hxz, hyy, hyz, hzz};
+    for (int k = 0; k < 10; k++)
+    {
+      const reg r = k == 0 ? acc[k] : V::mul(acc[k], V::set1(scale[k]));
+      if (full)
+        V::store(out[k] + n0, r);
+      else
+        V::store(out[k] + n0, r, m);
+    }
+  }
+}
+
+/** evaluate_v for exactly NS splines stored without padding
+ *
+ * The z stride is NS and the chunk loop has a compile-time trip count.
+ * Several chunks are accumulated together to share the stencil weights
+ * as long as their accumulators fit in the vector registers.
+ */
+template<int NS, typename T, typename SplineType>
+inline void evaluate_v_fixed(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals)
+{
+  using V               = vec<T>;
+  using reg             = typename V::reg;
+  constexpr int W       = V::width;
+  constexpr int G       = simd_group_size(NS / W, V::registers - 8);
+  constexpr intptr_t zs = NS;
+  static_assert(NS % (W * G) == 0, "NS must be a multiple of the chunk group");
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  const intptr_t xs      = spline_m->x_stride;
+  const intptr_t ys      = spline_m->y_stride;
+  const T* restrict base = spline_m->coefs + ix * xs + iy * ys + iz * zs;
+
+  const reg c0 = V::set1(c[0]), c1 = V::set1(c[1]), c2 = V::set1(c[2]), c3 = V::set1(c[3]);
+
+  for (int n0 = 0; n0 < NS; n0 += W * G)
+  {
+    reg v[G];
+    for (int g = 0; g < G; g++)
+      v[g] = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre00         = V::set1(a[i] * b[j]);
+        const T* restrict coefs = base + i * xs + j * ys + n0;
+        for (int g = 0; g < G; g++)
+        {
+          const T* restrict p = coefs + g * W;
+          const reg sum0 = V::fmadd(c3, V::load(p + 3 * zs),
+                                    V::fmadd(c2, V::load(p + 2 * zs), V::fmadd(c1, V::load(p + zs), V::mul(c0, V::load(p)))));
+          v[g] = V::fmadd(pre00, sum0, v[g]);
+        }
+      }
+    for (int g = 0; g < G; g++)
+      V::store(vals + n0 + g * W, v[g]);
+  }
+}
+
+/// evaluate_v_dot for exactly NS splines stored without padding, see evaluate_v_fixed
+template<int NS, typename T, typename SplineType>
+inline T evaluate_v_dot_fixed(const SplineType* restrict spline_m, T x, T y, T z, const T* restrict row)
+{
+  using V               = vec<T>;
+  using reg             = typename V::reg;
+  constexpr int W       = V::width;
+  constexpr int G       = simd_group_size(NS / W, (V::registers - 8) / 2);
+  constexpr intptr_t zs = NS;
+  static_assert(NS % (W * G) == 0, "NS must be a multiple of the chunk group");
+  int ix, iy, iz;
+  T a[4], b[4], c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c);
+
+  const intptr_t xs      = spline_m->x_stride;
+  const intptr_t ys      = spline_m->y_stride;
+  const T* restrict base = spline_m->coefs + ix * xs + iy * ys + iz * zs;
+
+  const reg c0 = V::set1(c[0]), c1 = V::set1(c[1]), c2 = V::set1(c[2]), c3 = V::set1(c[3]);
+
+  reg acc[G];
+  for (int g = 0; g < G; g++)
+    acc[g] = V::zero();
+  for (int n0 = 0; n0 < NS; n0 += W * G)
+  {
+    reg v[G];
+    for (int g = 0; g < G; g++)
+      v[g] = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre00         = V::set1(a[i] * b[j]);
+        const T* restrict coefs = base + i * xs + j * ys + n0;
+        for (int g = 0; g < G; g++)
+        {
+          const T* restrict p = coefs + g * W;
+          const reg sum0 = V::fmadd(c3, V::load(p + 3 * zs),
+                                    V::fmadd(c2, V::load(p + 2 * zs), V::fmadd(c1, V::load(p + zs), V::mul(c0, V::load(p)))));
+          v[g] = V::fmadd(pre00, sum0, v[g]);
+        }
+      }
+    for (int g = 0; g < G; g++)
+      acc[g] = V::fmadd(v[g], V::load(row + n0 + g * W), acc[g]);
+  }
+  T lanes[W];
+  T result(0);
+  for (int g = 0; g < G; g++)
+  {
+    V::store(lanes, acc[g]);
+    for (int l = 0; l < W; l++)
+      result += lanes[l];
+  }
+  return result;
+}
+
+template<int NS, typename T, typename SplineType>
+inline void evaluate_vgl_fixed(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                               T* restrict grads, T* restrict lapl, size_t out_offset)
+{
+  using V               = vec<T>;
+  using reg             = typename V::reg;
+  constexpr int W       = V::width;
+  constexpr int G       = simd_group_size(NS / W, (V::registers - 8) / 5);
+  constexpr intptr_t zs = NS;
+  static_assert(NS % (W * G) == 0, "NS must be a multiple of the chunk group");
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a, d2b, d2c);
+
+  const intptr_t xs      = spline_m->x_stride;
+  const intptr_t ys      = spline_m->y_stride;
+  const T* restrict base = spline_m->coefs + ix * xs + iy * ys + iz * zs;
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  for (int n0 = 0; n0 < NS; n0 += W * G)
+  {
+    reg v[G], vgx[G], vgy[G], vgz[G], vl[G];
+    for (int g = 0; g < G; g++)
+      v[g] = vgx[g] = vgy[g] = vgz[g] = vl[g] = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre2  = V::set1(d2a[i] * b[j] * dxInv * dxInv + a[i] * d2b[j] * dyInv * dyInv);
+        const reg pre0z = V::set1(a[i] * b[j] * dzInv * dzInv);
+        const reg pre10 = V::set1(da[i] * b[j]);
+        const reg pre00 = V::set1(a[i] * b[j]);
+        const reg pre01 = V::set1(a[i] * db[j]);
+
+        const T* restrict coefs = base + i * xs + j * ys + n0;
+        for (int g = 0; g < G; g++)
+        {
+          const T* restrict p = coefs + g * W;
+          const reg r0 = V::load(p);
+          const reg r1 = V::load(p + zs);
+          const reg r2 = V::load(p + 2 * zs);
+          const reg r3 = V::load(p + 3 * zs);
+
+          const reg sum0 = V::fmadd(V::set1(c[3]), r3,
+                                    V::fmadd(V::set1(c[2]), r2, V::fmadd(V::set1(c[1]), r1, V::mul(V::set1(c[0]), r0))));
+          const reg sum1 = V::fmadd(V::set1(dc[3]), r3,
+                                    V::fmadd(V::set1(dc[2]), r2, V::fmadd(V::set1(dc[1]), r1, V::mul(V::set1(dc[0]), r0))));
+          const reg sum2 = V::fmadd(V::set1(d2c[3]), r3,
+                                    V::fmadd(V::set1(d2c[2]), r2,
+                                             V::fmadd(V::set1(d2c[1]), r1, V::mul(V::set1(d2c[0]), r0))));
+
+          vgx[g] = V::fmadd(pre10, sum0, vgx[g]);
+          vgy[g] = V::fmadd(pre01, sum0, vgy[g]);
+          vgz[g] = V::fmadd(pre00, sum1, vgz[g]);
+          vl[g]  = V::fmadd(pre2, sum0, V::fmadd(pre0z, sum2, vl[g]));
+          v[g]   = V::fmadd(pre00, sum0, v[g]);
+        }
+      }
+    for (int g = 0; g < G; g++)
+    {
+      const int n = n0 + g * W;
+      V::store(vals + n, v[g]);
+      V::store(grads + n, V::mul(vgx[g], V::set1(dxInv)));
+      V::store(grads + out_offset + n, V::mul(vgy[g], V::set1(dyInv)));
+      V::store(grads + 2 * out_offset + n, V::mul(vgz[g], V::set1(dzInv)));
+      V::store(lapl + n, vl[g]);
+    }
+  }
+}
+
+template<int NS, typename T, typename SplineType>
+inline void evaluate_vgh_fixed(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                               T* restrict grads, T* restrict hess)
+{
+  using V               = vec<T>;
+  using reg             = typename V::reg;
+  constexpr int W       = V::width;
+  constexpr int G       = simd_group_size(NS / W, (V::registers - 8) / 10);
+  constexpr intptr_t zs = NS;
+  static_assert(NS % (W * G) == 0, "NS must be a multiple of the chunk group");
+  int ix, iy, iz;
+  T a[4], b[4], c[4], da[4], db[4], dc[4], d2a[4], d2b[4], d2c[4];
+
+  spline2::computeLocationAndFractional(spline_m, x, y, z, ix, iy, iz, a, b, c, da, db, dc, d2a, d2b, d2c);
+
+  const intptr_t xs      = spline_m->x_stride;
+  const intptr_t ys      = spline_m->y_stride;
+  const T* restrict base = spline_m->coefs + ix * xs + iy * ys + iz * zs;
+
+  const T dxInv = spline_m->x_grid.delta_inv;
+  const T dyInv = spline_m->y_grid.delta_inv;
+  const T dzInv = spline_m->z_grid.delta_inv;
+
+  T* restrict out[10] = {vals,
+                         grads,
+                         grads + NS,
+                         grads + 2 * NS,
+                         hess,
+                         hess + NS,
+                         hess + 2 * NS,
+                         hess + 3 * NS,
+                         hess + 4 * NS,
+                         hess + 5 * NS};
+  const T scale[10]   = {T(1),
+                       dxInv,
+                       dyInv,
+                       dzInv,
+                       dxInv * dxInv,
+                       dxInv * dyInv,
+                       dxInv * dzInv,
+                       dyInv * dyInv,
+                       dyInv * dzInv,
+                       dzInv * dzInv};
+
+  for (int n0 = 0; n0 < NS; n0 += W * G)
+  {
+    // v, gx, gy, gz, hxx, hxy, hxz, hyy, hyz, hzz
+    reg acc[10][G];
+    for (int k = 0; k < 10; k++)
+      for (int g = 0; g < G; g++)
+        acc[k][g] = V::zero();
+    for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+        const reg pre20 = V::set1(d2a[i] * b[j]);
+        const reg pre10 = V::set1(da[i] * b[j]);
+        const reg pre00 = V::set1(a[i] * b[j]);
+        const reg pre11 = V::set1(da[i] * db[j]);
+        const reg pre01 = V::set1(a[i] * db[j]);
+        const reg pre02 = V::set1(a[i] * d2b[j]);
+
+        const T* restrict coefs = base + i * xs + j * ys + n0;
+        for (int g = 0; g < G; g++)
+        {
+          const T* restrict p = coefs + g * W;
+          const reg r0 = V::load(p);
+          const reg r1 = V::load(p + zs);
+          const reg r2 = V::load(p + 2 * zs);
+          const reg r3 = V::load(p + 3 * zs);
+
+          const reg sum0 = V::fmadd(V::set1(c[3]), r3,
+                                    V::fmadd(V::set1(c[2]), r2, V::fmadd(V::set1(c[1]), r1, V::mul(V::set1(c[0]), r0))));
+          const reg sum1 = V::fmadd(V::set1(dc[3]), r3,
+                                    V::fmadd(V::set1(dc[2]), r2, V::fmadd(V::set1(dc[1]), r1, V::mul(V::set1(dc[0]), r0))));
+          const reg sum2 = V::fmadd(V::set1(d2c[3]), r3,
+                                    V::fmadd(V::set1(d2c[2]), r2,
+                                             V::fmadd(V::set1(d2c[1]), r1, V::mul(V::set1(d2c[0]), r0))));
+
+          acc[4][g] = V::fmadd(pre20, sum0, acc[4][g]);
+          acc[5][g] = V::fmadd(pre11, sum0, acc[5][g]);
+          acc[6][g] = V::fmadd(pre10, sum1, acc[6][g]);
+          acc[7][g] = V::fmadd(pre02, sum0, acc[7][g]);
+          acc[8][g] = V::fmadd(pre01, sum1, acc[8][g]);
+          acc[9][g] = V::fmadd(pre00, sum2, acc[9][g]);
+          acc[1][g] = V::fmadd(pre10, sum0, acc[1][g]);
+          acc[2][g] = V::fmadd(pre01, sum0, acc[2][g]);
+          acc[3][g] = V::fmadd(pre00, sum1, acc[3][g]);
+          acc[0][g] = V::fmadd(pre00, sum0, acc[0][g]);
+        }
+      }
+    for (int g = 0; g < G; g++)
+    {
+      V::store(out[0] + n0 + g * W, acc[0][g]);
+      for (int k = 1; k < 10; k++)
+        V::store(out[k] + n0 + g * W, V::mul(acc[k][g], V::set1(scale[k])));
+    }
+  }
+}
+
+/// true if spline_m holds exactly num_splines splines without padding
+template<typename SplineType>
+inline bool is_fixed_tile(const SplineType* spline_m, size_t num_splines)
+{
+  return spline_m->num_splines == num_splines && spline_m->z_stride == num_splines;
+}
+
+/** evaluate_v, specialized for tiles of 16, 32, 64 and 128 splines
+ *
+ * Other widths and padded tables use the runtime-width kernel.
+ */
+template<typename T, typename SplineType>
+inline void evaluate_v_tile(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals, size_t num_splines)
+{
+  if (!is_fixed_tile(spline_m, num_splines))
+    evaluate_v(spline_m, x, y, z, vals, num_splines);
+  else if (num_splines == 16)
+    evaluate_v_fixed<16>(spline_m, x, y, z, vals);
+  else if (num_splines == 32)
+    evaluate_v_fixed<32>(spline_m, x, y, z, vals);
+  else if (num_splines == 64)
+    evaluate_v_fixed<64>(spline_m, x, y, z, vals);
+  else if (num_splines == 128)
+    evaluate_v_fixed<128>(spline_m, x, y, z, vals);
+  else
+    evaluate_v(spline_m, x, y, z, vals, num_splines);
+}
+
+template<typename T, typename SplineType>
+inline T evaluate_v_dot_tile(const SplineType* restrict spline_m, T x, T y, T z, const T* restrict row,
+                             size_t num_splines)
+{
+  if (!is_fixed_tile(spline_m, num_splines))
+    return evaluate_v_dot(spline_m, x, y, z, row, num_splines);
+  else if (num_splines == 16)
+    return evaluate_v_dot_fixed<16>(spline_m, x, y, z, row);
+  else if (num_splines == 32)
+    return evaluate_v_dot_fixed<32>(spline_m, x, y, z, row);
+  else if (num_splines == 64)
+    return evaluate_v_dot_fixed<64>(spline_m, x, y, z, row);
+  else if (num_splines == 128)
+    return evaluate_v_dot_fixed<128>(spline_m, x, y, z, row);
+  else
+    return evaluate_v_dot(spline_m, x, y, z, row, num_splines);
+}
+
+template<typename T, typename SplineType>
+inline void evaluate_vgl_tile(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                              T* restrict grads, T* restrict lapl, size_t num_splines, size_t out_offset)
+{
+  if (!is_fixed_tile(spline_m, num_splines))
+    evaluate_vgl(spline_m, x, y, z, vals, grads, lapl, num_splines, out_offset);
+  else if (num_splines == 16)
+    evaluate_vgl_fixed<16>(spline_m, x, y, z, vals, grads, lapl, out_offset);
+  else if (num_splines == 32)
+    evaluate_vgl_fixed<32>(spline_m, x, y, z, vals, grads, lapl, out_offset);
+  else if (num_splines == 64)
+    evaluate_vgl_fixed<64>(spline_m, x, y, z, vals, grads, lapl, out_offset);
+  else if (num_splines == 128)
+    evaluate_vgl_fixed<128>(spline_m, x, y, z, vals, grads, lapl, out_offset);
+  else
+    evaluate_vgl(spline_m, x, y, z, vals, grads, lapl, num_splines, out_offset);
+}
+
+template<typename T, typename SplineType>
+inline void evaluate_vgh_tile(const SplineType* restrict spline_m, T x, T y, T z, T* restrict vals,
+                              T* restrict grads, T* restrict hess, size_t num_splines)
+{
+  if (!is_fixed_tile(spline_m, num_splines))
+    evaluate_vgh(spline_m, x, y, z, vals, grads, hess, num_splines);
+  else if (num_splines == 16)
+    evaluate_vgh_fixed<16>(spline_m, x, y, z, vals, grads, hess);
+  else if (num_splines == 32)
+    evaluate_vgh_fixed<32>(spline_m, x, y, z, vals, grads, hess);
+  else if (num_splines == 64)
+    evaluate_vgh_fixed<64>(spline_m, x, y, z, vals, grads, hess);
+  else if (num_splines == 128)
+    evaluate_vgh_fixed<128>(spline_m, x, y, z, vals, grads, hess);
+  else
+    evaluate_vgh(spline_m, x, y, z, vals, grads, hess, num_splines);
+}
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+// -*- C++ -*-
+/** @file ReducedPrecision.hpp
+ *
+ * 16-bit floating point storage types for spline coefficients.
+ * Values are stored as float16 (IEEE 754 binary16) or bfloat16 and widened
+ * to float when read. Arithmetic is never done in 16 bits.
+ */
+#ifndef QMCPLUSPLUS_SPLINE2_REDUCED_PRECISION_HPP
+#define QMCPLUSPLUS_SPLINE2_REDUCED_PRECISION_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace qmcplusplus
+{
+namespace spline2
+{
+inline uint32_t float_as_bits(float f)
+{
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+inline float bits_as_float(uint32_t u)
+{
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+/** convert binary16 bits to float
+ *
+ * Written without branches on the data so that it vectorizes inside the
+ * spline kernels. Subnormals are computed from the integer mantissa and are
+ * therefore not affected by denormals-are-zero modes.
+ */
+inline float half_to_float(uint16_t h)
+{
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+  const uint32_t exp  = h & 0x7c00u;
+  // rebias the exponent, inf and nan keep the maximal exponent
+  const uint32_t bias = (exp == 0x7c00u) ? (255u - 31u) << 23 : (127u - 15u) << 23;
+  const float normal  = bits_as_float((((h & 0x7fffu) << 13) + bias) | sign);
+  // 2^-24 is the unit of the subnormal mantissa
+  const float subnormal = static_cast<float>(h & 0x03ffu) * 5.9604644775390625e-8f;
+  return (exp == 0) ? (sign ? -subnormal : subnormal) : normal;
+}
+
+/// convert float to binary16 bits with round to nearest even
+inline uint16_t float_to_half(float f)
+{
+  uint32_t u          = float_as_bits(f);
+  const uint32_t sign = (u >> 16) & 0x8000u;
+  u &= 0x7fffffffu;
+  // inf and nan
+  if (u >= 0x7f800000u)
+    return sign | 0x7c00u | (u > 0x7f800000u ? 0x0200u : 0u);
+  // rounds to inf, 65520 and above
+  if (u >= 0x477ff000u)
+    return sign | 0x7c00u;
+  // subnormal or zero, below 2^-14
+  if (u < 0x38800000u)
+  {
+    // at most half of the smallest subnormal rounds to zero
+    if (u <= 0x33000000u)
+      return sign;
+    const uint32_t shift = 126u - (u >> 23);
+    const uint32_t mant  = (u & 0x007fffffu) | 0x00800000u;
+    const uint32_t rem   = mant & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1u);
+    uint32_t r           = mant >> shift;
+    if (rem > halfway || (rem == halfway && (r & 1u)))
+      r++;
+    return sign | r;
+  }
+  // normal number: rebias and round the 13 dropped bits
+  u += ((15u - 127u) << 23) + 0x0fffu + ((u >> 13) & 1u);
+  return sign | (u >> 13);
+}
+
+/// convert float to bfloat16 bits with round to nearest even
+inline uint16_t float_to_bfloat(float f)
+{
+  uint32_t u = float_as_bits(f);
+  // keep nan a quiet nan after truncation
+  if ((u & 0x7fffffffu) > 0x7f800000u)
+    return (u >> 16) | 0x0040u;
+  u += 0x7fffu + ((u >> 16) & 1u);
+  return u >> 16;
+}
+
+inline float bfloat_to_float(uint16_t b) { return bits_as_float(static_cast<uint32_t>(b) << 16); }
+
+} // namespace spline2
+
+/** IEEE 754 binary16 storage type: 5-bit exponent, 10-bit mantissa
+ */
+struct float16
+{
+  uint16_t bits;
+
+  float16() = default;
+  float16(float f) : bits(spline2::float_to_half(f)) {}
+  inline operator float() const { return spline2::half_to_float(bits); }
+};
+
+/** bfloat16 storage type: the upper half of a float, 8-bit exponent and 7-bit mantissa
+ */
+struct bfloat16
+{
+  uint16_t bits;
+
+  bfloat16() = default;
+  bfloat16(float f) : bits(spline2::float_to_bfloat(f)) {}
+  inline operator float() const { return spline2::bfloat_to_float(bits); }
+};
+
+} // namespace qmcplusplus
+#endif
@@ -18,9 +18,28 @@
 #define QMCPLUSPLUS_BSPLINE_SPLINE2_TRAITS_H
 
 #include <Numerics/Einspline/bspline.h>
+#include <Numerics/Spline2/ReducedPrecision.hpp>
 
 namespace qmcplusplus
 {
+/** multi_UBspline_3d with 16-bit coefficient storage
+ * @tparam CT coefficient storage type, float16 or bfloat16
+ *
+ * Same layout as multi_UBspline_3d_s. Evaluation widens the coefficients.
+ */
+template<typename CT>
+struct multi_UBspline_3d_rp
+{
+  spline_code spcode;
+  type_code tcode;
+  CT* restrict coefs;
+  intptr_t x_stride, y_stride, z_stride;
+  Ugrid x_grid, y_grid, z_grid;
+  BCtype_s xBC, yBC, zBC;
+  int num_splines;
+  size_t coefs_size;
+};
+
 /** trait class to map (datatype,D) to Einspline engine type */
 template<typename T, unsigned D>
 struct bspline_traits
@@ -46,6 +65,26 @@ struct bspline_traits<double, 3>
   typedef double value_type;
 };
 
+template<>
+struct bspline_traits<float16, 3>
+{
+  typedef multi_UBspline_3d_rp<float16> SplineType;
+  typedef UBspline_3d_s SingleSplineType;
+  typedef BCtype_s BCType;
+  typedef float16 real_type;
+  typedef float16 value_type;
+};
+
+template<>
+struct bspline_traits<bfloat16, 3>
+{
+  typedef multi_UBspline_3d_rp<bfloat16> SplineType;
+  typedef UBspline_3d_s SingleSplineType;
+  typedef BCtype_s BCType;
+  typedef bfloat16 real_type;
+  typedef bfloat16 value_type;
+};
+
 /** helper class to determine the value_type of einspline objects
  */
 template<typename ST>
@@ -64,6 +103,12 @@ struct bspline_type<multi_UBspline_3d_d>
   typedef double value_type;
 };
 
+template<typename CT>
+struct bspline_type<multi_UBspline_3d_rp<CT>>
+{
+  typedef CT value_type;
+};
+
 template<>
 struct bspline_type<UBspline_3d_s>
 {
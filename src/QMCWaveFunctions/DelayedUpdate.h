@@ -16,11 +16,138 @@
 #include <Numerics/OhmmsPETE/OhmmsVector.h>
 #include <Numerics/OhmmsPETE/OhmmsMatrix.h>
 #include "Numerics/OhmmsBlas.h"
+#include "Numerics/BatchedBlas.h"
+#include "Numerics/BatchedLU.h"
 #include "QMCWaveFunctions/DiracMatrix.h"
 #include "Numerics/BlasThreadingEnv.h"
+#include "Utilities/Clock.h"
 
 namespace qmcplusplus
 {
+/** online selection of the delay rank of DelayedUpdate
+ *
+ * The time of getInvRow, acceptRow and updateInvMat per accepted move is
+ * measured over windows of accepted moves. The first two grow with the delay
+ * while the rank-k update of Ainv gets more efficient. The current delay is
+ * compared with twice and half of it, the fastest is kept and, once neither
+ * neighbor is faster, held for a number of windows before exploring again, so
+ * that the optimum is followed when the acceptance changes.
+ */
+class DelayRankTuner
+{
+  enum Phase
+  {
+    Measure,
+    ProbeUp,
+    ProbeDown,
+    Hold,
+  };
+
+  /// accepted moves per window, per unit of delay
+  const int window_per_delay = 4;
+  /// minimal accepted moves per window
+  const int min_window = 64;
+  /// windows spent at the optimum before exploring again
+  const int hold_windows = 16;
+  /// relative gain required to change the delay, the windows are noisy
+  const double tolerance = 0.03;
+
+  Phase phase = Measure;
+  int max_delay = 1;
+  int center = 1, hold_count = 0;
+  double center_cost = 0, up_cost = 0, down_cost = 0;
+  /// time and accepted moves of the current window
+  double elapsed = 0;
+  int accepted   = 0;
+
+  int up(int delay) const { return std::min(2 * delay, max_delay); }
+  int down(int delay) const { return std::max(1, delay / 2); }
+
+  int decide()
+  {
+    int best         = center;
+    double best_cost = center_cost * (1 - tolerance);
+    if (up(center) != center && up_cost < best_cost)
+    {
+      best      = up(center);
+      best_cost = up_cost;
+    }
+    if (down(center) != center && down_cost < best_cost)
+      best = down(center);
+
+    if (best == center)
+    {
+      phase      = Hold;
+      hold_count = 0;
+    }
+    else
+    {
+#pragma omp critical
+      app_log() << "DelayedUpdate: delay rank " << center << " -> " << best << ", "
+                << center_cost * 1e6 << " us per accepted move at " << center << std::endl;
+      phase = Measure;
+    }
+    return best;
+  }
+
+public:
+  void reset(int delay)
+  {
+    max_delay = delay;
+    phase     = Measure;
+    elapsed   = 0;
+    accepted  = 0;
+  }
+
+  void addTime(double seconds) { elapsed += seconds; }
+  void addAccepted() { accepted++; }
+
+  /// true when the window of the given delay is complete
+  bool windowDone(int delay) const { return accepted >= std::max(min_window, window_per_delay * delay); }
+
+  /** close a window measured with delay
+   * @return the delay of the next window
+   */
+  int update(int delay)
+  {
+    const double cost = elapsed / accepted;
+    elapsed           = 0;
+    accepted          = 0;
+    switch (phase)
+    {
+    case Measure:
+      center      = delay;
+      center_cost = cost;
+      if (up(center) != center)
+      {
+        phase = ProbeUp;
+        return up(center);
+      }
+      if (down(center) != center)
+      {
+        phase = ProbeDown;
+        return down(center);
+      }
+      return decide();
+    case ProbeUp:
+      up_cost = cost;
+      if (down(center) != center)
+      {
+        phase = ProbeDown;
+        return down(center);
+      }
+      return decide();
+    case ProbeDown:
+      down_cost = cost;
+      return decide();
+    default:
+      if (++hold_count >= hold_windows)
+        phase = Measure;
+      return delay;
+    }
+  }
+};
+
 /** implements delayed update on CPU using BLAS
  * @tparam T base precision for most computation
  * @tparam T_FP high precision for matrix inversion, T_FP >= T
@@ -46,12 +173,29 @@ class DelayedUpdate
   std::vector<int> delay_list;
   /// current number of delays, increase one for each acceptance, reset to 0 after updating Ainv
   int delay_count;
+  /// delay triggering the update of Ainv, at most the allocated maximum Binv.cols()
+  int delay;
+  /// adjust delay during the run
+  bool adaptive_delay;
+  DelayRankTuner tuner;
   /// matrix inversion engine
   DiracMatrix<T_FP, T> detEng;
 
 public:
   /// default constructor
-  DelayedUpdate() : delay_count(0) {}
+  DelayedUpdate() : delay_count(0), delay(1), adaptive_delay(false) {}
+
+  /// let the delay change during the run within the maximum given to resize, see DelayRankTuner
+  void setAdaptiveDelay(bool adaptive) { adaptive_delay = adaptive; }
+
+  /// the delay in use
+  int getDelay() const { return delay; }
+
+  /// select how Ainv is computed from scratch
+  void setInverseMethod(InverseMethod method) { detEng.setInverseMethod(method); }
+
+  /// residual |I - A A^{-1}| of the last invert_transpose, zero unless InverseMethod::mixed
+  double getInverseResidual() const { return detEng.getResidual(); }
 
   /** resize the internal storage
    * @param norb number of electrons/orbitals
@@ -66,6 +210,8 @@ public:
     tempMat.resize(norb, delay);
     Binv.resize(delay, delay);
     delay_list.resize(delay);
+    this->delay = delay;
+    tuner.reset(delay);
   }
 
   /** compute the inverse of the transpose of matrix A
@@ -79,6 +225,72 @@ public:
     delay_count = 0;
   }
 
+  /** compute the inverses of the transposes of the matrices of several walkers
+   * @param engines the engines of the walkers
+   * @param logdetT_list orbital value matrices
+   * @param Ainv_list inverse matrices
+   * @param LogValues log of the absolute values of the determinants
+   * @param PhaseValues phases of the determinants
+   *
+   * The LAPACK inversions of small matrices run together by BatchedLU, interleaved
+   * in the SIMD lanes, when there are enough walkers to fill the lanes.
+   * The other engines call invert_transpose one by one.
+   */
+  static void mw_invert_transpose(const std::vector<DelayedUpdate*>& engines,
+                                  const std::vector<const Matrix<T>*>& logdetT_list,
+                                  const std::vector<Matrix<T>*>& Ainv_list,
+                                  std::vector<real_type>& LogValues,
+                                  std::vector<real_type>& PhaseValues)
+  {
+    using real_type_fp = typename scalar_traits<T_FP>::real_type;
+    // BatchedLU was slower than getrf + getri above 48x48 or with half empty lanes
+    const int max_size  = 48;
+    const int min_batch = BatchedLU::lanes<T_FP>() / 2;
+
+    LogValues.resize(engines.size());
+    PhaseValues.resize(engines.size());
+    std::vector<int> batch;
+    for (int iw = 0; iw < engines.size(); iw++)
+    {
+      const int n = Ainv_list[iw]->rows();
+      if (engines[iw]->detEng.getInverseMethod() == InverseMethod::lapack && n <= max_size &&
+          (batch.empty() || n == Ainv_list[batch[0]]->rows()))
+        batch.push_back(iw);
+    }
+    if (batch.size() < min_batch)
+      batch.clear();
+
+    std::vector<bool> batched(engines.size(), false);
+    const int nb = batch.size();
+    if (nb > 0)
+    {
+      const int n   = Ainv_list[batch[0]]->rows();
+      const int lda = logdetT_list[batch[0]]->cols();
+      const int ldx = Ainv_list[batch[0]]->cols();
+      std::vector<const T*> A(nb);
+      std::vector<T*> X(nb);
+      std::vector<real_type_fp> logdet(nb), phase(nb);
+      for (int ib = 0; ib < nb; ib++)
+      {
+        A[ib]              = logdetT_list[batch[ib]]->data();
+        X[ib]              = Ainv_list[batch[ib]]->data();
+        batched[batch[ib]] = true;
+      }
+      BatchedLU::invert_transpose<T_FP>(n, A.data(), lda, X.data(), ldx, logdet.data(), phase.data(), nb);
+      for (int ib = 0; ib < nb; ib++)
+      {
+        LogValues[batch[ib]]   = logdet[ib];
+        PhaseValues[batch[ib]] = phase[ib];
+        // safe mechanism
+        engines[batch[ib]]->delay_count = 0;
+      }
+    }
+
+    for (int iw = 0; iw < engines.size(); iw++)
+      if (!batched[iw])
+        engines[iw]->invert_transpose(*logdetT_list[iw], *Ainv_list[iw], LogValues[iw], PhaseValues[iw]);
+  }
+
   /** initialize internal objects when Ainv is refreshed
    * @param Ainv inverse matrix
    */
@@ -101,6 +313,7 @@ public:
       std::copy_n(Ainv[rowchanged], invRow.size(), invRow.data());
       return;
     }
+    const double start = adaptive_delay ? cpu_clock() : 0.0;
     const T cone(1);
     const T czero(0);
     const int norb     = Ainv.rows();
@@ -111,6 +324,8 @@ public:
     BLAS::gemv('T', norb, delay_count, cone, U.data(), norb, invRow.data(), 1, czero, p.data(), 1);
     BLAS::gemv('N', delay_count, delay_count, cone, Binv.data(), lda_Binv, p.data(), 1, czero, Binv[delay_count], 1);
     BLAS::gemv('N', norb, delay_count, -cone, V.data(), norb, Binv[delay_count], 1, cone, invRow.data(), 1);
+    if (adaptive_delay)
+      tuner.addTime(cpu_clock() - start);
   }
 
   /** accept a move with the update delayed
@@ -118,11 +333,22 @@ public:
    * @param rowchanged the row id corresponding to the proposed electron
    * @param psiV new orbital values
    *
-   * Before delay_count reaches the maximum delay, only Binv is updated with a recursive algorithm
+   * Before delay_count reaches the delay, only Binv is updated with a recursive algorithm
    */
   template<typename VVT>
   inline void acceptRow(Matrix<T>& Ainv, int rowchanged, const VVT& psiV)
   {
+    if (acceptRowDelayed(Ainv, rowchanged, psiV))
+      updateInvMat(Ainv);
+  }
+
+  /** accept a move, leaving Ainv to the caller
+   * @return true if the delay is reached, Ainv must be updated by updateInvMat or mw_updateInvMat
+   */
+  template<typename VVT>
+  inline bool acceptRowDelayed(const Matrix<T>& Ainv, int rowchanged, const VVT& psiV)
+  {
+    const double start = adaptive_delay ? cpu_clock() : 0.0;
     const T cminusone(-1);
     const T czero(0);
     const int norb     = Ainv.rows();
@@ -147,9 +373,13 @@ public:
     for (int i = 0; i < delay_count; i++)
       Binv[delay_count][i] *= -y;
     delay_count++;
-    // update Ainv when maximal delay is reached
-    if (delay_count == lda_Binv)
-      updateInvMat(Ainv);
+    if (adaptive_delay)
+    {
+      tuner.addTime(cpu_clock() - start);
+      tuner.addAccepted();
+    }
+    // update Ainv when the delay is reached
+    return delay_count == delay;
   }
 
   /** update the full Ainv and reset delay_count
@@ -159,6 +389,7 @@ public:
   {
     if (delay_count == 0)
       return;
+    const double start = adaptive_delay ? cpu_clock() : 0.0;
     // update the inverse matrix
     const T cone(1);
     const T czero(0);
@@ -227,7 +458,112 @@ public:
         }
       }
     }
+    endUpdate(adaptive_delay ? cpu_clock() - start : 0.0);
+  }
+
+  /** update the Ainv of a batch of walkers, see updateInvMat
+   * @param engines delayed updates of the walkers, their delay_count may differ
+   * @param Ainv_list inverse matrices of the walkers
+   *
+   * Each of the three GEMMs of the rank-k update is one batched call over the
+   * walkers. Walkers with a single delayed row use the Sherman-Morrison update
+   * and large matrices with nested threads the threaded updateInvMat.
+   */
+  static void mw_updateInvMat(const std::vector<DelayedUpdate*>& engines, const std::vector<Matrix<T>*>& Ainv_list)
+  {
+    std::vector<int> batch;
+    for (int iw = 0; iw < engines.size(); iw++)
+    {
+      DelayedUpdate& engine = *engines[iw];
+      if (engine.delay_count == 0)
+        continue;
+      if (engine.delay_count == 1 || (Ainv_list[iw]->rows() > 256 && getNextLevelNumThreads() > 1))
+        engine.updateInvMat(*Ainv_list[iw]);
+      else
+        batch.push_back(iw);
+    }
+    const int nb = batch.size();
+    if (nb == 0)
+      return;
+
+    const double start = cpu_clock();
+    const T cone(1);
+    const T czero(0);
+    std::vector<int> m(nb), n(nb), k(nb), lda(nb), ldb(nb), ldc(nb);
+    std::vector<const T*> A(nb), B(nb);
+    std::vector<T*> C(nb);
+    BlasThreadingEnv knob(1);
+
+    // tempMat = U^T Ainv
+    for (int ib = 0; ib < nb; ib++)
+    {
+      DelayedUpdate& engine = *engines[batch[ib]];
+      Matrix<T>& Ainv       = *Ainv_list[batch[ib]];
+      const int norb        = Ainv.rows();
+      m[ib]                 = engine.delay_count;
+      n[ib] = k[ib] = lda[ib] = ldb[ib] = norb;
+      ldc[ib]                           = engine.Binv.cols();
+      A[ib]                             = engine.U.data();
+      B[ib]                             = Ainv.data();
+      C[ib]                             = engine.tempMat.data();
+    }
+    BatchedBLAS::gemm('T', 'N', m.data(), n.data(), k.data(), cone, A.data(), lda.data(), B.data(), ldb.data(), czero,
+                      C.data(), ldc.data(), nb);
+    for (int ib = 0; ib < nb; ib++)
+    {
+      DelayedUpdate& engine = *engines[batch[ib]];
+      for (int i = 0; i < engine.delay_count; i++)
+        engine.tempMat(engine.delay_list[i], i) -= cone;
+    }
+
+    // U = V Binv
+    for (int ib = 0; ib < nb; ib++)
+    {
+      DelayedUpdate& engine = *engines[batch[ib]];
+      const int norb        = Ainv_list[batch[ib]]->rows();
+      m[ib] = lda[ib] = ldc[ib] = norb;
+      n[ib] = k[ib] = engine.delay_count;
+      ldb[ib]       = engine.Binv.cols();
+      A[ib]         = engine.V.data();
+      B[ib]         = engine.Binv.data();
+      C[ib]         = engine.U.data();
+    }
+    BatchedBLAS::gemm('N', 'N', m.data(), n.data(), k.data(), cone, A.data(), lda.data(), B.data(), ldb.data(), czero,
+                      C.data(), ldc.data(), nb);
+
+    // Ainv -= U tempMat
+    for (int ib = 0; ib < nb; ib++)
+    {
+      DelayedUpdate& engine = *engines[batch[ib]];
+      Matrix<T>& Ainv       = *Ainv_list[batch[ib]];
+      const int norb        = Ainv.rows();
+      m[ib] = n[ib] = lda[ib] = ldc[ib] = norb;
+      k[ib]                             = engine.delay_count;
+      ldb[ib]                           = engine.Binv.cols();
+      A[ib]                             = engine.U.data();
+      B[ib]                             = engine.tempMat.data();
+      C[ib]                             = Ainv.data();
+    }
+    BatchedBLAS::gemm('N', 'N', m.data(), n.data(), k.data(), -cone, A.data(), lda.data(), B.data(), ldb.data(), cone,
+                      C.data(), ldc.data(), nb);
+
+    // the walkers share the time of the batch
+    const double elapsed = (cpu_clock() - start) / nb;
+    for (int ib = 0; ib < nb; ib++)
+      engines[batch[ib]]->endUpdate(elapsed);
+  }
+
+private:
+  /// Ainv is up-to-date, the delay can change
+  inline void endUpdate(double seconds)
+  {
     delay_count = 0;
+    if (adaptive_delay)
+    {
+      tuner.addTime(seconds);
+      if (tuner.windowDone(delay))
+        delay = tuner.update(delay);
+    }
   }
 };
 } // namespace qmcplusplus
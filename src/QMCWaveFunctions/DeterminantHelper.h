@@ -13,10 +13,69 @@
 #ifndef QMCPLUSPLUS_DETERMINANT_HELPER_H
 #define QMCPLUSPLUS_DETERMINANT_HELPER_H
 
+#include <algorithm>
 #include <cmath>
 
 namespace qmcplusplus
 {
+/// how the determinant matrices are inverted from scratch
+enum class InverseMethod
+{
+  lapack, ///< getrf/getri in the full precision
+  mixed,  ///< getrf/getri in single precision refined in the full precision
+  native  ///< BlockedLU with OpenMP tasks
+};
+
+/** when DiracDeterminant::evaluateGL inverts the orbital matrix from scratch
+ *
+ * The inverse updated move by move drifts away from the inverse of the
+ * orbitals, faster in mixed precision. It is recomputed every period calls or
+ * when the residual of a few rows of A A^{-1} - I exceeds the threshold.
+ * The offsets spread the recomputes of a crowd evenly over the calls, so only
+ * about crowd / period walkers are due together. That is rarely enough to fill
+ * the lanes of the batched inversion of DelayedUpdate::mw_invert_transpose, the
+ * due walkers are then inverted one by one. Equal offsets batch them at the
+ * price of uneven steps.
+ */
+struct RecomputePolicy
+{
+  /// calls of evaluateGL between the recomputes, 0 for never
+  int period = 0;
+  /// shift of the calls, the walkers of a crowd take different ones to stagger the recomputes
+  int offset = 0;
+  /// largest residual before a recompute, 0 for no check
+  double threshold = 0;
+  /// rows of the residual checked per call, rotating over all the rows
+  int num_rows = 4;
+};
+
+/// what the recomputes of the determinants found
+struct RecomputeStats
+{
+  /// recomputes by the period
+  long scheduled = 0;
+  /// recomputes by the residual
+  long triggered = 0;
+  /// residual checks
+  long checks = 0;
+  /// largest residual of the checks
+  double max_residual = 0;
+  /// largest change of log|det| by a recompute, the drift of the updates
+  double max_drift = 0;
+  /// largest residual |I - A A^{-1}| of the inversions, zero unless InverseMethod::mixed
+  double max_inverse_residual = 0;
+
+  void add(const RecomputeStats& other)
+  {
+    scheduled += other.scheduled;
+    triggered += other.triggered;
+    checks += other.checks;
+    max_residual = std::max(max_residual, other.max_residual);
+    max_drift    = std::max(max_drift, other.max_drift);
+    max_inverse_residual = std::max(max_inverse_residual, other.max_inverse_residual);
+  }
+};
+
 template<typename T>
 inline T evaluatePhase(T sign_v)
 {
@@ -27,14 +27,22 @@ namespace qmcplusplus
  *@param first index of the first particle
  */
 template<typename DU_TYPE>
-DiracDeterminant<DU_TYPE>::DiracDeterminant(SPOSet* const spos, int first, int delay)
+DiracDeterminant<DU_TYPE>::DiracDeterminant(SPOSet* const spos,
+                                            int first,
+                                            int delay,
+                                            bool adaptive_delay,
+                                            InverseMethod inverse,
+                                            const RecomputePolicy& recompute)
     : invRow_id(-1),
+      KeepOrbitalValues(false),
       Phi(spos),
       FirstIndex(first),
       LastIndex(first + spos->size()),
       ndelay(delay),
       NumPtcls(spos->size()),
-      NumOrbitals(spos->size())
+      NumOrbitals(spos->size()),
+      Recompute(recompute),
+      NumGL(0)
 {
   UpdateTimer  = TimerManager.createTimer("Determinant::update", timer_level_fine);
   RatioTimer   = TimerManager.createTimer("Determinant::ratio", timer_level_fine);
@@ -43,6 +51,8 @@ DiracDeterminant<DU_TYPE>::DiracDeterminant(SPOSet* const spos, int first, int d
   SPOVTimer    = TimerManager.createTimer("Determinant::spoval", timer_level_fine);
   SPOVGLTimer  = TimerManager.createTimer("Determinant::spovgl", timer_level_fine);
   resize(spos->size(), spos->size());
+  updateEng.setAdaptiveDelay(adaptive_delay);
+  updateEng.setInverseMethod(inverse);
 }
 
 template<typename DU_TYPE>
@@ -50,6 +60,7 @@ void DiracDeterminant<DU_TYPE>::invertPsiM(const ValueMatrix_t& logdetT, ValueMa
 {
   InverseTimer->start();
   updateEng.invert_transpose(logdetT, invMat, LogValue, PhaseValue);
+  RecomputeInfo.max_inverse_residual = std::max(RecomputeInfo.max_inverse_residual, updateEng.getInverseResidual());
   InverseTimer->stop();
 }
 
@@ -94,7 +105,7 @@ typename DiracDeterminant<DU_TYPE>::ValueType DiracDeterminant<DU_TYPE>::ratioGr
                                                                                    GradType& grad_iat)
 {
   SPOVGLTimer->start();
-  Phi->evaluate(P, iat, psiV, dpsiV, d2psiV);
+  Phi->evaluateVGL(P, iat, psiV, dpsiV, d2psiV);
   SPOVGLTimer->stop();
   return ratioGrad_compute(iat, grad_iat);
 }
@@ -118,7 +129,10 @@ typename DiracDeterminant<DU_TYPE>::ValueType DiracDeterminant<DU_TYPE>::ratioGr
     updateEng.getInvRow(psiM, WorkingIndex, invRow);
   }
   curRatio = simd::dot(invRow.data(), psiV.data(), invRow.size());
-  grad_iat += ((RealType)1.0 / curRatio) * simd::dot(invRow.data(), dpsiV.data(), invRow.size());
+  const GradType dot_grad(simd::dot(invRow.data(), dpsiV.data(0), invRow.size()),
+                          simd::dot(invRow.data(), dpsiV.data(1), invRow.size()),
+                          simd::dot(invRow.data(), dpsiV.data(2), invRow.size()));
+  grad_iat += ((RealType)1.0 / curRatio) * dot_grad;
   RatioTimer->stop();
   return curRatio;
 }
@@ -127,21 +141,36 @@ typename DiracDeterminant<DU_TYPE>::ValueType DiracDeterminant<DU_TYPE>::ratioGr
 */
 template<typename DU_TYPE>
 void DiracDeterminant<DU_TYPE>::acceptMove(ParticleSet& P, int iat)
+{
+  UpdateTimer->start();
+  if (acceptMoveDelayed(P, iat))
+    updateEng.updateInvMat(psiM);
+  UpdateTimer->stop();
+}
+
+template<typename DU_TYPE>
+bool DiracDeterminant<DU_TYPE>::acceptMoveDelayed(ParticleSet& P, int iat)
 {
   const int WorkingIndex = iat - FirstIndex;
   PhaseValue += evaluatePhase(curRatio);
   LogValue += std::log(std::abs(curRatio));
-  UpdateTimer->start();
-  updateEng.acceptRow(psiM, WorkingIndex, psiV);
+  // the fused ratio leaves psiV unset
+  if (UpdateMode == ORB_PBYP_RATIO && !KeepOrbitalValues)
+    Phi->evaluate(P, iat, psiV);
+  const bool update_needed = updateEng.acceptRowDelayed(psiM, WorkingIndex, psiV);
+  // keep the orbital matrix current for the residual checks and the recomputes of evaluateGL
+  std::copy_n(psiV.data(), NumOrbitals, psiM_temp[WorkingIndex]);
   // invRow becomes invalid after accepting a move
   invRow_id = -1;
   if (UpdateMode == ORB_PBYP_PARTIAL)
   {
-    simd::copy(dpsiM[WorkingIndex], dpsiV.data(), NumOrbitals);
+    GradType* dpsi_row = dpsiM[WorkingIndex];
+    for (int j = 0; j < NumOrbitals; j++)
+      dpsi_row[j] = dpsiV[j];
     simd::copy(d2psiM[WorkingIndex], d2psiV.data(), NumOrbitals);
   }
-  UpdateTimer->stop();
   curRatio = 1.0;
+  return update_needed;
 }
 
 template<typename DU_TYPE>
@@ -159,6 +188,19 @@ void DiracDeterminant<DU_TYPE>::evaluateGL(ParticleSet& P,
                                            ParticleSet::ParticleGradient_t& G,
                                            ParticleSet::ParticleLaplacian_t& L,
                                            bool fromscratch)
+{
+  if (prepareGL(P, fromscratch))
+  {
+    // the drift of log|det| accumulated by the updates
+    const RealType log_updated = LogValue;
+    invertOrbitals();
+    RecomputeInfo.max_drift = std::max(RecomputeInfo.max_drift, static_cast<double>(std::abs(LogValue - log_updated)));
+  }
+  accumulateGL(G, L);
+}
+
+template<typename DU_TYPE>
+bool DiracDeterminant<DU_TYPE>::prepareGL(ParticleSet& P, bool fromscratch)
 {
   if (UpdateMode == ORB_PBYP_RATIO)
   { //need to compute dpsiM and d2psiM. Do not touch psiM!
@@ -166,7 +208,13 @@ void DiracDeterminant<DU_TYPE>::evaluateGL(ParticleSet& P,
     Phi->evaluate_notranspose(P, FirstIndex, LastIndex, psiM_temp, dpsiM, d2psiM);
     SPOVGLTimer->stop();
   }
+  return checkRecompute() || fromscratch;
+}
 
+template<typename DU_TYPE>
+void DiracDeterminant<DU_TYPE>::accumulateGL(ParticleSet::ParticleGradient_t& G,
+                                             ParticleSet::ParticleLaplacian_t& L) const
+{
   if (NumPtcls == 1)
   {
     ValueType y = psiM(0, 0);
@@ -195,9 +243,6 @@ typename DiracDeterminant<DU_TYPE>::ValueType DiracDeterminant<DU_TYPE>::ratio(P
 {
   UpdateMode             = ORB_PBYP_RATIO;
   const int WorkingIndex = iat - FirstIndex;
-  SPOVTimer->start();
-  Phi->evaluate(P, iat, psiV);
-  SPOVTimer->stop();
   RatioTimer->start();
   // This is an optimization.
   // check invRow_id against WorkingIndex to see if getInvRow() has been called
@@ -207,8 +252,17 @@ typename DiracDeterminant<DU_TYPE>::ValueType DiracDeterminant<DU_TYPE>::ratio(P
     invRow_id = WorkingIndex;
     updateEng.getInvRow(psiM, WorkingIndex, invRow);
   }
-  curRatio = simd::dot(invRow.data(), psiV.data(), invRow.size());
   RatioTimer->stop();
+  SPOVTimer->start();
+  if (KeepOrbitalValues)
+  {
+    Phi->evaluate(P, iat, psiV);
+    curRatio = simd::dot(invRow.data(), psiV.data(), invRow.size());
+  }
+  else
+    // the values are reduced with invRow as they are computed, psiV is not filled
+    curRatio = Phi->evaluateDetRatio(P, iat, psiV, invRow);
+  SPOVTimer->stop();
   return curRatio;
 }
 
@@ -217,8 +271,12 @@ void DiracDeterminant<DU_TYPE>::evaluateRatios(VirtualParticleSet& VP, std::vect
 {
   SPOVTimer->start();
   const int WorkingIndex = VP.refPtcl - FirstIndex;
-  invRow_id              = WorkingIndex;
-  updateEng.getInvRow(psiM, WorkingIndex, invRow);
+  // the knots of an electron may come in several VPs, the corrected row is reused
+  if (invRow_id != WorkingIndex)
+  {
+    invRow_id = WorkingIndex;
+    updateEng.getInvRow(psiM, WorkingIndex, invRow);
+  }
   Phi->evaluateDetRatios(VP, psiV, invRow, ratios);
   SPOVTimer->stop();
 }
@@ -239,24 +297,7 @@ typename DiracDeterminant<DU_TYPE>::RealType DiracDeterminant<DU_TYPE>::evaluate
                                                                                     ParticleSet::ParticleLaplacian_t& L)
 {
   recompute(P);
-
-  if (NumPtcls == 1)
-  {
-    ValueType y = psiM(0, 0);
-    GradType rv = y * dpsiM(0, 0);
-    G[FirstIndex] += rv;
-    L[FirstIndex] += y * d2psiM(0, 0) - dot(rv, rv);
-  }
-  else
-  {
-    for (int i = 0, iat = FirstIndex; i < NumPtcls; i++, iat++)
-    {
-      mGradType rv   = simd::dot(psiM[i], dpsiM[i], NumOrbitals);
-      mValueType lap = simd::dot(psiM[i], d2psiM[i], NumOrbitals);
-      G[iat] += rv;
-      L[iat] += lap - dot(rv, rv);
-    }
-  }
+  accumulateGL(G, L);
   return LogValue;
 }
 
@@ -266,6 +307,14 @@ void DiracDeterminant<DU_TYPE>::recompute(ParticleSet& P)
   SPOVGLTimer->start();
   Phi->evaluate_notranspose(P, FirstIndex, LastIndex, psiM_temp, dpsiM, d2psiM);
   SPOVGLTimer->stop();
+  invertOrbitals();
+}
+
+template<typename DU_TYPE>
+void DiracDeterminant<DU_TYPE>::invertOrbitals()
+{
+  // invRow becomes invalid after recomputing the inverse matrix
+  invRow_id = -1;
   if (NumPtcls == 1)
   {
     //CurrentDet=psiM(0,0);
@@ -279,6 +328,85 @@ void DiracDeterminant<DU_TYPE>::recompute(ParticleSet& P)
   }
 }
 
+template<typename DU_TYPE>
+void DiracDeterminant<DU_TYPE>::mw_invertOrbitals(const std::vector<DiracDeterminant*>& dets)
+{
+  std::vector<DU_TYPE*> engines;
+  std::vector<const ValueMatrix_t*> orbitals;
+  std::vector<ValueMatrix_t*> inverses;
+  for (auto det : dets)
+    if (det->NumPtcls == 1)
+      det->invertOrbitals();
+    else
+    {
+      det->invRow_id = -1;
+      engines.push_back(&det->updateEng);
+      orbitals.push_back(&det->psiM_temp);
+      inverses.push_back(&det->psiM);
+    }
+  if (engines.empty())
+    return;
+
+  InverseTimer->start();
+  std::vector<RealType> logs, phases;
+  DU_TYPE::mw_invert_transpose(engines, orbitals, inverses, logs, phases);
+  for (int iw = 0, k = 0; iw < dets.size(); iw++)
+    if (dets[iw]->NumPtcls > 1)
+    {
+      dets[iw]->LogValue   = logs[k];
+      dets[iw]->PhaseValue = phases[k];
+      dets[iw]->RecomputeInfo.max_inverse_residual =
+          std::max(dets[iw]->RecomputeInfo.max_inverse_residual, dets[iw]->updateEng.getInverseResidual());
+      k++;
+    }
+  InverseTimer->stop();
+}
+
+template<typename DU_TYPE>
+bool DiracDeterminant<DU_TYPE>::checkRecompute()
+{
+  const long step = Recompute.offset + NumGL++;
+  if (Recompute.period > 0 && (step + 1) % Recompute.period == 0)
+  {
+    RecomputeInfo.scheduled++;
+    return true;
+  }
+  if (Recompute.threshold > 0)
+  {
+    const RealType r           = residual(step * Recompute.num_rows, Recompute.num_rows);
+    RecomputeInfo.max_residual = std::max(RecomputeInfo.max_residual, static_cast<double>(r));
+    RecomputeInfo.checks++;
+    if (r > Recompute.threshold)
+    {
+      RecomputeInfo.triggered++;
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename DU_TYPE>
+typename DiracDeterminant<DU_TYPE>::RealType DiracDeterminant<DU_TYPE>::residual(long first, int num_rows)
+{
+  // accumulated in the full precision, the round-off of the sums in single precision is above the useful thresholds
+  typename QMCTraits::QTFull::RealType r(0);
+  for (int k = 0; k < std::min(num_rows, NumPtcls); k++)
+  {
+    const int i = (first + k) % NumPtcls;
+    // the column i of A A^{-1}, psiM holds the transpose of A^{-1}
+    const ValueType* restrict inv_row = psiM[i];
+    for (int j = 0; j < NumPtcls; j++)
+    {
+      const ValueType* restrict orb_row = psiM_temp[j];
+      mValueType sum(j == i ? -1 : 0);
+      for (int o = 0; o < NumOrbitals; o++)
+        sum += static_cast<mValueType>(orb_row[o]) * static_cast<mValueType>(inv_row[o]);
+      r = std::max(r, std::abs(sum));
+    }
+  }
+  return static_cast<RealType>(r);
+}
+
 template<typename DU_TYPE>
 void DiracDeterminant<DU_TYPE>::multi_evaluateLog(const std::vector<WaveFunctionComponent*>& WFC_list,
                                  const std::vector<ParticleSet*>& P_list,
@@ -286,10 +414,51 @@ void DiracDeterminant<DU_TYPE>::multi_evaluateLog(const std::vector<WaveFunction
                                  const std::vector<ParticleSet::ParticleLaplacian_t*>& L_list,
                                  ParticleSet::ParticleValue_t& values)
 {
+  std::vector<DiracDeterminant*> dets(WFC_list.size());
+  SPOVGLTimer->start();
+  for (int iw = 0; iw < P_list.size(); iw++)
+  {
+    dets[iw] = static_cast<DiracDeterminant*>(WFC_list[iw]);
+    dets[iw]->Phi->evaluate_notranspose(*P_list[iw], FirstIndex, LastIndex, dets[iw]->psiM_temp, dets[iw]->dpsiM,
+                                        dets[iw]->d2psiM);
+  }
+  SPOVGLTimer->stop();
+  mw_invertOrbitals(dets);
   for (int iw = 0; iw < P_list.size(); iw++)
-    values[iw] = WFC_list[iw]->evaluateLog(*P_list[iw], *G_list[iw], *L_list[iw]);
+  {
+    dets[iw]->accumulateGL(*G_list[iw], *L_list[iw]);
+    values[iw] = dets[iw]->LogValue;
+  }
 };
 
+template<typename DU_TYPE>
+void DiracDeterminant<DU_TYPE>::multi_evaluateGL(const std::vector<WaveFunctionComponent*>& WFC_list,
+                                                 const std::vector<ParticleSet*>& P_list,
+                                                 const std::vector<ParticleSet::ParticleGradient_t*>& G_list,
+                                                 const std::vector<ParticleSet::ParticleLaplacian_t*>& L_list,
+                                                 bool fromscratch)
+{
+  std::vector<DiracDeterminant*> recomputed;
+  std::vector<RealType> log_updated;
+  for (int iw = 0; iw < P_list.size(); iw++)
+  {
+    auto det = static_cast<DiracDeterminant*>(WFC_list[iw]);
+    if (det->prepareGL(*P_list[iw], fromscratch))
+    {
+      recomputed.push_back(det);
+      log_updated.push_back(det->LogValue);
+    }
+  }
+  mw_invertOrbitals(recomputed);
+  for (int k = 0; k < recomputed.size(); k++)
+  {
+    auto& info     = recomputed[k]->RecomputeInfo;
+    info.max_drift = std::max(info.max_drift, static_cast<double>(std::abs(recomputed[k]->LogValue - log_updated[k])));
+  }
+  for (int iw = 0; iw < P_list.size(); iw++)
+    static_cast<DiracDeterminant*>(WFC_list[iw])->accumulateGL(*G_list[iw], *L_list[iw]);
+}
+
 template<typename DU_TYPE>
 void DiracDeterminant<DU_TYPE>::multi_ratioGrad(const std::vector<WaveFunctionComponent*>& WFC_list,
                        const std::vector<ParticleSet*>& P_list,
@@ -300,7 +469,7 @@ void DiracDeterminant<DU_TYPE>::multi_ratioGrad(const std::vector<WaveFunctionCo
   SPOVGLTimer->start();
   std::vector<SPOSet*> phi_list; phi_list.reserve(WFC_list.size());
   std::vector<ValueVector_t*> psi_v_list; psi_v_list.reserve(WFC_list.size());
-  std::vector<GradVector_t*> dpsi_v_list; dpsi_v_list.reserve(WFC_list.size());
+  std::vector<GradVectorSoA_t*> dpsi_v_list; dpsi_v_list.reserve(WFC_list.size());
   std::vector<ValueVector_t*> d2psi_v_list; d2psi_v_list.reserve(WFC_list.size());
 
   for(auto wfc : WFC_list)
@@ -312,7 +481,7 @@ void DiracDeterminant<DU_TYPE>::multi_ratioGrad(const std::vector<WaveFunctionCo
     d2psi_v_list.push_back(&(det->d2psiV));
   }
 
-  Phi->multi_evaluate(phi_list, P_list, iat, psi_v_list, dpsi_v_list, d2psi_v_list);
+  Phi->multi_evaluateVGL(phi_list, P_list, iat, psi_v_list, dpsi_v_list, d2psi_v_list);
   SPOVGLTimer->stop();
 
   //#pragma omp parallel for
@@ -326,11 +495,42 @@ void DiracDeterminant<DU_TYPE>::multi_acceptrestoreMove(const std::vector<WaveFu
                                        const std::vector<bool>& isAccepted,
                                        int iat)
 {
+  UpdateTimer->start();
+  // the walkers reaching their delay update the inverses together
+  std::vector<DU_TYPE*> engines;
+  std::vector<ValueMatrix_t*> inverses;
   for (int iw = 0; iw < P_list.size(); iw++)
     if (isAccepted[iw])
-      WFC_list[iw]->acceptMove(*P_list[iw], iat);
+    {
+      auto det = static_cast<DiracDeterminant<DU_TYPE>*>(WFC_list[iw]);
+      if (det->acceptMoveDelayed(*P_list[iw], iat))
+      {
+        engines.push_back(&det->updateEng);
+        inverses.push_back(&det->psiM);
+      }
+    }
+  DU_TYPE::mw_updateInvMat(engines, inverses);
+  UpdateTimer->stop();
 };
 
+template<typename DU_TYPE>
+void DiracDeterminant<DU_TYPE>::multi_completeUpdates(const std::vector<WaveFunctionComponent*>& WFC_list)
+{
+  UpdateTimer->start();
+  std::vector<DU_TYPE*> engines;
+  std::vector<ValueMatrix_t*> inverses;
+  for (auto wfc : WFC_list)
+  {
+    auto det = static_cast<DiracDeterminant<DU_TYPE>*>(wfc);
+    // invRow becomes invalid after updating the inverse matrix
+    det->invRow_id = -1;
+    engines.push_back(&det->updateEng);
+    inverses.push_back(&det->psiM);
+  }
+  DU_TYPE::mw_updateInvMat(engines, inverses);
+  UpdateTimer->stop();
+}
+
 
 typedef QMCTraits::ValueType ValueType;
 typedef QMCTraits::QTFull::ValueType mValueType;
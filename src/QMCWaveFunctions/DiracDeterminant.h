@@ -36,10 +36,11 @@ template<typename DU_TYPE = DelayedUpdate<QMCTraits::ValueType, QMCTraits::QTFul
 class DiracDeterminant : public WaveFunctionComponent
 {
 public:
-  using ValueVector_t = Vector<ValueType>;
-  using ValueMatrix_t = Matrix<ValueType>;
-  using GradVector_t  = Vector<GradType>;
-  using GradMatrix_t  = Matrix<GradType>;
+  using ValueVector_t   = SPOSet::ValueVector_t;
+  using ValueMatrix_t   = Matrix<ValueType>;
+  using GradVector_t    = Vector<GradType>;
+  using GradVectorSoA_t = SPOSet::GradVectorSoA_t;
+  using GradMatrix_t    = Matrix<GradType>;
 
   using mValueType       = QMCTraits::QTFull::ValueType;
   using ValueMatrix_hp_t = Matrix<mValueType>;
@@ -48,8 +49,17 @@ public:
   /** constructor
    *@param spos the single-particle orbital set
    *@param first index of the first particle
+   *@param delay maximal delay of the inverse update
+   *@param adaptive_delay tune the delay during the run, see DelayRankTuner
+   *@param inverse how psiM is inverted by recompute
+   *@param recompute when evaluateGL inverts psiM from scratch
    */
-  DiracDeterminant(SPOSet* const spos, int first = 0, int delay = 1);
+  DiracDeterminant(SPOSet* const spos,
+                   int first                        = 0,
+                   int delay                        = 1,
+                   bool adaptive_delay              = false,
+                   InverseMethod inverse            = InverseMethod::lapack,
+                   const RecomputePolicy& recompute = RecomputePolicy());
 
   // copy constructor and assign operator disabled
   DiracDeterminant(const DiracDeterminant& s) = delete;
@@ -58,6 +68,11 @@ public:
   ///invert psiM or its copies
   void invertPsiM(const ValueMatrix_t& logdetT, ValueMatrix_t& invMat);
 
+  /** the gradients and laplacians from psiM
+   * @param fromscratch invert the orbitals again, also done as given by the RecomputePolicy
+   *
+   * The delayed updates must be completed.
+   */
   void evaluateGL(ParticleSet& P,
                   ParticleSet::ParticleGradient_t& G,
                   ParticleSet::ParticleLaplacian_t& L,
@@ -79,6 +94,9 @@ public:
 
   GradType evalGrad(ParticleSet& P, int iat) override;
 
+  /// prefetch the orbitals at newpos
+  void prefetch(int iat, const PosType& newpos) override { Phi->prefetch(newpos); }
+
   /** move was accepted, update the real container
    */
   void acceptMove(ParticleSet& P, int iat) override;
@@ -89,12 +107,23 @@ public:
 
   void recompute(ParticleSet& P);
 
+  /// the recomputes done by evaluateGL and the errors they found
+  const RecomputeStats& getRecomputeStats() const { return RecomputeInfo; }
+
+  /// the matrices of the walkers are inverted together, see DelayedUpdate::mw_invert_transpose
   void multi_evaluateLog(const std::vector<WaveFunctionComponent*>& WFC_list,
                          const std::vector<ParticleSet*>& P_list,
                          const std::vector<ParticleSet::ParticleGradient_t*>& G_list,
                          const std::vector<ParticleSet::ParticleLaplacian_t*>& L_list,
                          ParticleSet::ParticleValue_t& values) override;
 
+  /// the walkers due for a recompute are inverted together
+  void multi_evaluateGL(const std::vector<WaveFunctionComponent*>& WFC_list,
+                        const std::vector<ParticleSet*>& P_list,
+                        const std::vector<ParticleSet::ParticleGradient_t*>& G_list,
+                        const std::vector<ParticleSet::ParticleLaplacian_t*>& L_list,
+                        bool fromscratch = false) override;
+
   void multi_ratioGrad(const std::vector<WaveFunctionComponent*>& WFC_list,
                        const std::vector<ParticleSet*>& P_list,
                        int iat,
@@ -106,7 +135,10 @@ public:
                                const std::vector<bool>& isAccepted,
                                int iat) override;
 
-  /// psiM(j,i) \f$= \psi_j({\bf r}_i)\f$
+  /// the inverses of the walkers are updated by batched GEMMs, see DelayedUpdate::mw_updateInvMat
+  void multi_completeUpdates(const std::vector<WaveFunctionComponent*>& WFC_list) override;
+
+  /// psiM(j,i) \f$= \psi_j({\bf r}_i)\f$, the rows of the accepted moves are updated
   ValueMatrix_t psiM_temp;
 
   /// inverse transpose of psiM(j,i) \f$= \psi_j({\bf r}_i)\f$
@@ -120,7 +152,8 @@ public:
 
   /// value of single-particle orbital for particle-by-particle update
   ValueVector_t psiV;
-  GradVector_t dpsiV;
+  /// gradients in SoA, written in place by the SPO
+  GradVectorSoA_t dpsiV;
   ValueVector_t d2psiV;
 
   /// delayed update engine
@@ -131,13 +164,16 @@ public:
 
   /** row id correspond to the up-to-date invRow. [0 norb), invRow is ready; -1, invRow is not valid.
    *  This id is set after calling getInvRow indicating invRow has been prepared for the invRow_id row
-   *  ratioGrad checks if invRow_id is consistent. If not, invRow needs to be recomputed.
-   *  acceptMove and completeUpdates mark invRow invalid by setting invRow_id to -1
+   *  ratioGrad, ratio and evaluateRatios check if invRow_id is consistent. If not, invRow needs to be recomputed.
+   *  acceptMove, completeUpdates and recompute mark invRow invalid by setting invRow_id to -1
    */
   int invRow_id;
 
   ValueType curRatio;
 
+  /// ratio fills psiV instead of fusing the orbitals with the dot product, set when a multi determinant table reuses them
+  bool KeepOrbitalValues;
+
 private:
 
   /// Timers
@@ -159,9 +195,41 @@ private:
   int NumPtcls;
   /// delayed update rank
   int ndelay;
+  /// when evaluateGL recomputes psiM
+  RecomputePolicy Recompute;
+  RecomputeStats RecomputeInfo;
+  /// calls of evaluateGL
+  long NumGL;
 
   ///reset the size: with the number of particles and number of orbtials
   void resize(int nel, int morb);
+
+  /** acceptMove leaving psiM to the caller
+   * @return true if the delay is reached and psiM must be updated
+   */
+  bool acceptMoveDelayed(ParticleSet& P, int iat);
+
+  /// invert psiM_temp into psiM
+  void invertOrbitals();
+
+  /// invertOrbitals of several walkers
+  void mw_invertOrbitals(const std::vector<DiracDeterminant*>& dets);
+
+  /** the orbitals needed by evaluateGL
+   * @return psiM must be recomputed, left to the caller
+   */
+  bool prepareGL(ParticleSet& P, bool fromscratch);
+
+  /// add the gradients and laplacians of log|det| from psiM, dpsiM and d2psiM
+  void accumulateGL(ParticleSet::ParticleGradient_t& G, ParticleSet::ParticleLaplacian_t& L) const;
+
+  /// psiM must be recomputed by evaluateGL, counts the call
+  bool checkRecompute();
+
+  /** largest element of the rows of A psiM^T - I, A the orbitals in psiM_temp
+   * @param first first row, the rows are taken modulo the number of particles
+   */
+  RealType residual(long first, int num_rows);
 };
 
 
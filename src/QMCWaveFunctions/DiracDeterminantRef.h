@@ -38,7 +38,7 @@ template<typename DU_TYPE = DelayedUpdate<QMCTraits::ValueType, QMCTraits::QTFul
 class DiracDeterminantRef : public WaveFunctionComponent
 {
 public:
-  using ValueVector_t = Vector<ValueType>;
+  using ValueVector_t = SPOSet::ValueVector_t;
   using ValueMatrix_t = Matrix<ValueType>;
   using GradVector_t  = Vector<GradType>;
   using GradMatrix_t  = Matrix<GradType>;
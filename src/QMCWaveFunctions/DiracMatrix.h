@@ -12,10 +12,12 @@
 #ifndef QMCPLUSPLUS_DIRAC_MATRIX_H
 #define QMCPLUSPLUS_DIRAC_MATRIX_H
 
+#include <algorithm>
 #include "Numerics/Blasf.h"
 #include "Numerics/OhmmsBlas.h"
 #include "Numerics/OhmmsPETE/OhmmsMatrix.h"
 #include "Numerics/BlasThreadingEnv.h"
+#include "Numerics/BlockedLU.h"
 #include "Utilities/scalar_traits.h"
 #include "Utilities/SIMD/algorithm.hpp"
 #include "QMCWaveFunctions/DeterminantHelper.h"
@@ -56,11 +58,31 @@ inline T computeLogDet(const std::complex<T>* restrict diag, int n, const int* r
   return 0.5 * logdet;
 }
 
+/// the single precision counterpart of a type, used by InverseMethod::mixed
+template<typename T>
+struct LowerPrecision
+{
+  using type = T;
+};
+
+template<>
+struct LowerPrecision<double>
+{
+  using type = float;
+};
+
+template<>
+struct LowerPrecision<std::complex<double>>
+{
+  using type = std::complex<float>;
+};
+
 template<typename T_FP, typename T = T_FP>
 class DiracMatrix
 {
   typedef typename scalar_traits<T>::real_type real_type;
   typedef typename scalar_traits<T_FP>::real_type real_type_fp;
+  typedef typename LowerPrecision<T_FP>::type T_LP;
   aligned_vector<T_FP> m_work;
   aligned_vector<int> m_pivot;
   int Lwork;
@@ -68,6 +90,22 @@ class DiracMatrix
   Matrix<T_FP> psiM_fp;
   /// LU diagonal elements
   aligned_vector<T_FP> LU_diag;
+  /// inversion method
+  InverseMethod method;
+  /// maximum number of refinement steps of InverseMethod::mixed
+  int max_refine;
+  /// target residual of InverseMethod::mixed
+  real_type_fp refine_tol;
+  /// residual |I - A A^{-1}| of the last InverseMethod::mixed inversion
+  real_type_fp residual;
+  /// refinement scratch space: matrix, residual, previous inverse and single precision LU factors
+  Matrix<T_FP> mat_fp, res_fp, prev_fp, lu_fp;
+  /// single precision matrix and LAPACK work space
+  Matrix<T_LP> mat_lp;
+  aligned_vector<T_LP> m_work_lp;
+  int Lwork_lp;
+  /// engine of InverseMethod::native
+  BlockedLU<T_FP> blocked_lu;
 
   /// reset internal work space
   inline void reset(T_FP* invMat_ptr, const int lda)
@@ -84,8 +122,119 @@ class DiracMatrix
     LU_diag.resize(lda);
   }
 
+  /// reset the single precision work space
+  inline void reset_lp(const int lda)
+  {
+    mat_lp.resize(lda, lda);
+    Lwork_lp = -1;
+    T_LP tmp;
+    real_type_fp lw;
+    int status;
+    LAPACK::getri(lda, mat_lp.data(), lda, m_pivot.data(), &tmp, Lwork_lp, status);
+    convert(tmp, lw);
+    Lwork_lp = static_cast<int>(lw);
+    m_work_lp.resize(Lwork_lp);
+  }
+
+  /// infinity norm of the n x n matrix a
+  static real_type_fp norm_inf(const T_FP* a, int n, int lda)
+  {
+    real_type_fp res(0);
+    for (int i = 0; i < n; i++)
+    {
+      real_type_fp row(0);
+      for (int j = 0; j < n; j++)
+        row += std::abs(a[i * lda + j]);
+      res = std::max(res, row);
+    }
+    return res;
+  }
+
+  /** invert the n x n matrix at invMat_ptr in place, factorizing in T_LP and refining in T_FP
+   *
+   * The single precision inverse X is corrected by X <- X + X R with the residual
+   * R = I - A X, the Newton-Schulz iteration, which squares the residual at each step.
+   * The residual is measured on every iterate, the final one included, and the
+   * iteration stops once it is below refine_tol or after max_refine corrections.
+   * The final residual is kept in residual, a warning is printed if it misses refine_tol.
+   * The log determinant of the single precision factors P L U is corrected to first order,
+   * log det(A) = log det(P L U) + tr(X A) - tr(X P L U).
+   */
+  inline void invert_mixed(T_FP* invMat_ptr, const int n, const int lda, real_type& LogDet, real_type& Phase)
+  {
+    if (mat_lp.rows() < lda)
+      reset_lp(lda);
+    mat_fp.resize(n, lda);
+    res_fp.resize(n, lda);
+    prev_fp.resize(n, lda);
+    lu_fp.resize(n, lda);
+    std::copy_n(invMat_ptr, n * lda, mat_fp.data());
+    std::copy_n(invMat_ptr, n * lda, mat_lp.data());
+
+    int status;
+    LAPACK::getrf(n, n, mat_lp.data(), lda, m_pivot.data(), status);
+    std::copy_n(mat_lp.data(), n * lda, lu_fp.data());
+    for (int i = 0; i < n; i++)
+      LU_diag[i] = lu_fp.data()[i * lda + i];
+    real_type_fp Phase_tmp;
+    real_type_fp LogDet_tmp = computeLogDet(LU_diag.data(), n, m_pivot.data(), Phase_tmp);
+    LAPACK::getri(n, mat_lp.data(), lda, m_pivot.data(), m_work_lp.data(), Lwork_lp, status);
+    std::copy_n(mat_lp.data(), n * lda, invMat_ptr);
+
+    // BLAS is column major, A and X are stored transposed
+    const T_FP one(1), zero(0);
+    for (int it = 0;; it++)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        std::fill_n(res_fp[i], n, zero);
+        res_fp[i][i] = one;
+      }
+      BLAS::gemm('N', 'N', n, n, n, -one, mat_fp.data(), lda, invMat_ptr, lda, one, res_fp.data(), lda);
+      residual = norm_inf(res_fp.data(), n, lda);
+      if (residual < refine_tol || it == max_refine)
+        break;
+      std::copy_n(invMat_ptr, n * lda, prev_fp.data());
+      BLAS::gemm('N', 'N', n, n, n, one, prev_fp.data(), lda, res_fp.data(), lda, one, invMat_ptr, lda);
+    }
+    if (residual >= refine_tol)
+    {
+#pragma omp critical
+      app_warning() << "Mixed precision inversion of a " << n << "x" << n << " matrix stopped at the residual "
+                    << residual << std::endl;
+    }
+
+    // tr(X P L U) = tr(U (X P L)), X P swaps the columns of X as getrf swapped the rows of A
+    std::copy_n(invMat_ptr, n * lda, prev_fp.data());
+    for (int i = 0; i < n; i++)
+      if (m_pivot[i] != i + 1)
+        std::swap_ranges(prev_fp[i], prev_fp[i] + n, prev_fp[m_pivot[i] - 1]);
+    BLAS::trmm('R', 'L', 'N', 'U', n, n, one, lu_fp.data(), lda, prev_fp.data(), lda);
+    T_FP trace(n);
+    for (int i = 0; i < n; i++)
+      for (int j = i; j < n; j++)
+        trace -= lu_fp[j][i] * prev_fp[i][j];
+    LogDet = LogDet_tmp + std::real(trace);
+    Phase  = Phase_tmp + std::imag(trace);
+  }
+
 public:
-  DiracMatrix() : Lwork(0) {}
+  DiracMatrix()
+      : Lwork(0),
+        method(InverseMethod::lapack),
+        max_refine(3),
+        refine_tol(1e-10),
+        residual(0),
+        Lwork_lp(0)
+  {}
+
+  /// select the inversion method, InverseMethod::mixed needs T_FP in double precision
+  void setInverseMethod(InverseMethod m) { method = m; }
+
+  InverseMethod getInverseMethod() const { return method; }
+
+  /// residual of the last inversion, zero unless InverseMethod::mixed
+  real_type_fp getResidual() const { return residual; }
 
   /** compute the inverse of the transpose of matrix A
    * assume precision T_FP >= T, do the inversion always with T_FP
@@ -106,14 +255,25 @@ public:
 #endif
     if (Lwork < lda)
       reset(invMat_ptr, lda);
-    int status;
-    LAPACK::getrf(n, n, invMat_ptr, lda, m_pivot.data(), status);
-    for (int i = 0; i < n; i++)
-      LU_diag[i] = invMat_ptr[i * lda + i];
-    real_type_fp Phase_tmp;
-    LogDet = computeLogDet(LU_diag.data(), n, m_pivot.data(), Phase_tmp);
-    Phase  = Phase_tmp;
-    LAPACK::getri(n, invMat_ptr, lda, m_pivot.data(), m_work.data(), Lwork, status);
+    if (method == InverseMethod::mixed)
+      invert_mixed(invMat_ptr, n, lda, LogDet, Phase);
+    else if (method == InverseMethod::native)
+    {
+      real_type_fp Phase_tmp;
+      LogDet = blocked_lu.invert(invMat_ptr, n, lda, Phase_tmp);
+      Phase  = Phase_tmp;
+    }
+    else
+    {
+      int status;
+      LAPACK::getrf(n, n, invMat_ptr, lda, m_pivot.data(), status);
+      for (int i = 0; i < n; i++)
+        LU_diag[i] = invMat_ptr[i * lda + i];
+      real_type_fp Phase_tmp;
+      LogDet = computeLogDet(LU_diag.data(), n, m_pivot.data(), Phase_tmp);
+      Phase  = Phase_tmp;
+      LAPACK::getri(n, invMat_ptr, lda, m_pivot.data(), m_work.data(), Lwork, status);
+    }
 #if defined(MIXED_PRECISION)
     invMat = psiM_fp;
 #endif
@@ -0,0 +1,465 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+#include "QMCWaveFunctions/MultiSlaterDeterminant.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include "Numerics/OhmmsBlas.h"
+#include "QMCWaveFunctions/DeterminantHelper.h"
+#include "Utilities/RandomGenerator.h"
+
+namespace qmcplusplus
+{
+/// determinant of the k x k row major matrix m, destroyed
+template<typename T>
+inline T small_det(T* m, int k)
+{
+  switch (k)
+  {
+  case 1:
+    return m[0];
+  case 2:
+    return m[0] * m[3] - m[1] * m[2];
+  case 3:
+    return m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) +
+        m[2] * (m[3] * m[7] - m[4] * m[6]);
+  }
+  T det(1);
+  for (int j = 0; j < k; j++)
+  {
+    int p = j;
+    for (int i = j + 1; i < k; i++)
+      if (std::abs(m[i * k + j]) > std::abs(m[p * k + j]))
+        p = i;
+    if (m[p * k + j] == T(0))
+      return T(0);
+    if (p != j)
+    {
+      std::swap_ranges(m + j * k, m + j * k + k, m + p * k);
+      det = -det;
+    }
+    det *= m[j * k + j];
+    for (int i = j + 1; i < k; i++)
+    {
+      const T l = m[i * k + j] / m[j * k + j];
+      for (int c = j + 1; c < k; c++)
+        m[i * k + c] -= l * m[j * k + c];
+    }
+  }
+  return det;
+}
+
+MultiDiracDeterminant::MultiDiracDeterminant(RefDetType* ref, SPOSet* occ, SPOSet* virt, int first, int nel)
+    : Ref(ref),
+      Occ(occ),
+      Virt(virt),
+      FirstIndex(first),
+      NumPtcls(nel),
+      NumVirtuals(virt->size()),
+      ExcOffset(2, 0),
+      Y_id(-1),
+      MoveHasGradients(false)
+{
+  B.resize(nel, NumVirtuals);
+  dB.resize(nel, NumVirtuals);
+  d2B.resize(nel, NumVirtuals);
+  T.resize(nel, NumVirtuals);
+  d2F.resize(nel, NumVirtuals);
+  cInv.resize(nel);
+  psiV.resize(nel);
+  Y.resize(NumVirtuals);
+  // ratio reuses the orbitals of the reference
+  Ref->KeepOrbitalValues = true;
+  virtV.resize(NumVirtuals);
+  dvirtV.resize(NumVirtuals);
+  d2virtV.resize(NumVirtuals);
+  gV.resize(NumVirtuals);
+  dfV.resize(NumVirtuals);
+  // the reference
+  Ratios.push_back(ValueType(1));
+  Weights.push_back(ValueType(0));
+}
+
+int MultiDiracDeterminant::addExcitation(const std::vector<int>& occ, const std::vector<int>& virt)
+{
+  assert(occ.size() == virt.size());
+  ExcOcc.insert(ExcOcc.end(), occ.begin(), occ.end());
+  ExcVirt.insert(ExcVirt.end(), virt.begin(), virt.end());
+  ExcOffset.push_back(ExcOcc.size());
+  const int k = occ.size();
+  if (SmallMat.size() < k * k)
+    SmallMat.resize(k * k);
+  Ratios.push_back(ValueType(0));
+  Weights.push_back(ValueType(0));
+  return getNumExcitations() - 1;
+}
+
+MultiDiracDeterminant::ValueType MultiDiracDeterminant::excitationDet(int e, const ValueType* u, int b)
+{
+  const int k = getLevel(e);
+  if (k == 0)
+    return ValueType(1);
+  const int* restrict occ  = ExcOcc.data() + ExcOffset[e];
+  const int* restrict virt = ExcVirt.data() + ExcOffset[e];
+  ValueType* restrict m    = SmallMat.data();
+  for (int a = 0; a < k; a++)
+  {
+    const ValueType* restrict t_row = T[occ[a]];
+    for (int c = 0; c < k; c++)
+      m[a * k + c] = t_row[virt[c]];
+    if (u != nullptr)
+      m[a * k + b] = u[occ[a]];
+  }
+  return small_det(m, k);
+}
+
+void MultiDiracDeterminant::computeY()
+{
+  std::fill_n(Y.data(), NumVirtuals, ValueType(0));
+  // by linearity, det(M + u g^T) = det(M) + sum_b g_b det(M with the column b replaced by u)
+  for (int e = 1; e < getNumExcitations(); e++)
+  {
+    const ValueType w = Weights[e];
+    if (w == ValueType(0))
+      continue;
+    const int k              = getLevel(e);
+    const int* restrict occ  = ExcOcc.data() + ExcOffset[e];
+    const int* restrict virt = ExcVirt.data() + ExcOffset[e];
+    if (k == 1)
+      Y[virt[0]] += w * cInv[occ[0]];
+    else
+      for (int b = 0; b < k; b++)
+        Y[virt[b]] += w * excitationDet(e, cInv.data(), b);
+  }
+}
+
+void MultiDiracDeterminant::prepareMove(int iat)
+{
+  if (Y_id == iat)
+    return;
+  assert(Ref->invRow_id == iat - FirstIndex);
+  std::copy_n(Ref->invRow.data(), NumPtcls, cInv.data());
+  computeY();
+  Y_id = iat;
+}
+
+void MultiDiracDeterminant::computeG(const ValueType* psi, ValueType rho)
+{
+  std::copy_n(virtV.data(), NumVirtuals, gV.data());
+  BLAS::gemv('N', NumVirtuals, NumPtcls, ValueType(-1), T.data(), NumVirtuals, psi, 1, ValueType(1), gV.data(), 1);
+  const ValueType rho_inv = ValueType(1) / rho;
+  for (int v = 0; v < NumVirtuals; v++)
+    gV[v] *= rho_inv;
+}
+
+void MultiDiracDeterminant::computeGradF(const GradVectorSoA_t& dpsi)
+{
+  for (int d = 0; d < DIM; d++)
+  {
+    std::copy_n(dvirtV.data(d), NumVirtuals, dfV.data(d));
+    BLAS::gemv('N', NumVirtuals, NumPtcls, ValueType(-1), T.data(), NumVirtuals, dpsi.data(d), 1, ValueType(1),
+               dfV.data(d), 1);
+  }
+}
+
+void MultiDiracDeterminant::evaluateTable(ParticleSet& P)
+{
+  Virt->evaluate_notranspose(P, FirstIndex, FirstIndex + NumPtcls, B, dB, d2B);
+  // T(o,v) = sum_i psiM(i,o) B(i,v), psiM holds the transpose of A^{-1}
+  BLAS::gemm('N', 'T', NumVirtuals, NumPtcls, NumPtcls, ValueType(1), B.data(), NumVirtuals, Ref->psiM.data(),
+             NumPtcls, ValueType(0), T.data(), NumVirtuals);
+  for (int e = 1; e < getNumExcitations(); e++)
+    Ratios[e] = excitationDet(e, nullptr, 0);
+  Y_id = -1;
+}
+
+void MultiDiracDeterminant::evaluateGL(ParticleSet::ParticleGradient_t& G,
+                                       ParticleSet::ParticleLaplacian_t& L,
+                                       ValueType psi)
+{
+  // laplacians of the orbitals of the reference times T, for all the particles
+  BLAS::gemm('N', 'N', NumVirtuals, NumPtcls, NumPtcls, ValueType(1), T.data(), NumVirtuals, Ref->d2psiM.data(),
+             NumPtcls, ValueType(0), d2F.data(), NumVirtuals);
+  const ValueType psi_inv = ValueType(1) / psi;
+  for (int i = 0; i < NumPtcls; i++)
+  {
+    std::copy_n(Ref->psiM[i], NumPtcls, cInv.data());
+    computeY();
+    // gradients of b - T^T a, the rows of dpsiM are 3 x N column major
+    BLAS::gemm('N', 'T', NumVirtuals, DIM, NumPtcls, ValueType(-1), T.data(), NumVirtuals, Ref->dpsiM[i][0].data(),
+               DIM, ValueType(0), dfV.data(), dfV.capacity());
+    const GradType grad_rho = simd::dot(cInv.data(), Ref->dpsiM[i], NumPtcls);
+    // at the current position g = 0, grad g = grad f and lap g = lap f - 2 grad f . grad rho
+    GradType grad_psi;
+    ValueType lap_psi(0);
+    for (int v = 0; v < NumVirtuals; v++)
+    {
+      const GradType grad_f(dB(i, v)[0] + dfV.data(0)[v], dB(i, v)[1] + dfV.data(1)[v], dB(i, v)[2] + dfV.data(2)[v]);
+      grad_psi += Y[v] * grad_f;
+      lap_psi += Y[v] * (d2B(i, v) - d2F(i, v) - ValueType(2) * dot(grad_f, grad_rho));
+    }
+    grad_psi *= psi_inv;
+    G[FirstIndex + i] += grad_psi;
+    L[FirstIndex + i] += lap_psi * psi_inv - dot(grad_psi, grad_psi);
+  }
+  Y_id = -1;
+}
+
+MultiDiracDeterminant::GradType MultiDiracDeterminant::evalGrad(int iat)
+{
+  prepareMove(iat);
+  const int i = iat - FirstIndex;
+  BLAS::gemm('N', 'T', NumVirtuals, DIM, NumPtcls, ValueType(-1), T.data(), NumVirtuals, Ref->dpsiM[i][0].data(), DIM,
+             ValueType(0), dfV.data(), dfV.capacity());
+  GradType grad;
+  for (int v = 0; v < NumVirtuals; v++)
+    grad += Y[v] * GradType(dB(i, v)[0] + dfV.data(0)[v], dB(i, v)[1] + dfV.data(1)[v], dB(i, v)[2] + dfV.data(2)[v]);
+  return grad;
+}
+
+MultiDiracDeterminant::ValueType MultiDiracDeterminant::ratio(ParticleSet& P, int iat)
+{
+  prepareMove(iat);
+  Virt->evaluate(P, iat, virtV);
+  computeG(Ref->psiV.data(), Ref->curRatio);
+  MoveHasGradients = false;
+  return simd::dot(gV.data(), Y.data(), NumVirtuals);
+}
+
+MultiDiracDeterminant::ValueType MultiDiracDeterminant::ratioGrad(ParticleSet& P, int iat, GradType& grad)
+{
+  prepareMove(iat);
+  Virt->evaluateVGL(P, iat, virtV, dvirtV, d2virtV);
+  const ValueType rho = Ref->curRatio;
+  computeG(Ref->psiV.data(), rho);
+  computeGradF(Ref->dpsiV);
+  const GradType grad_rho(simd::dot(cInv.data(), Ref->dpsiV.data(0), NumPtcls),
+                          simd::dot(cInv.data(), Ref->dpsiV.data(1), NumPtcls),
+                          simd::dot(cInv.data(), Ref->dpsiV.data(2), NumPtcls));
+  // grad g = (grad f - g grad rho) / rho
+  const ValueType rho_inv = ValueType(1) / rho;
+  grad                    = GradType();
+  for (int v = 0; v < NumVirtuals; v++)
+    grad += (Y[v] * rho_inv) * (GradType(dfV.data(0)[v], dfV.data(1)[v], dfV.data(2)[v]) - gV[v] * grad_rho);
+  MoveHasGradients = true;
+  return simd::dot(gV.data(), Y.data(), NumVirtuals);
+}
+
+void MultiDiracDeterminant::evaluateRatios(VirtualParticleSet& VP, std::vector<ValueType>& dpsi)
+{
+  prepareMove(VP.refPtcl);
+  for (int k = 0; k < VP.getTotalNum(); k++)
+  {
+    Occ->evaluate(VP, k, psiV);
+    Virt->evaluate(VP, k, virtV);
+    computeG(psiV.data(), simd::dot(cInv.data(), psiV.data(), NumPtcls));
+    dpsi[k] = simd::dot(gV.data(), Y.data(), NumVirtuals);
+  }
+}
+
+void MultiDiracDeterminant::acceptMove(int iat)
+{
+  assert(Y_id == iat);
+  const int i = iat - FirstIndex;
+  // T + cInv g^T
+  for (int o = 0; o < NumPtcls; o++)
+    BLAS::axpy(NumVirtuals, cInv[o], gV.data(), 1, T[o], 1);
+  std::copy_n(virtV.data(), NumVirtuals, B[i]);
+  if (MoveHasGradients)
+  {
+    for (int v = 0; v < NumVirtuals; v++)
+      dB(i, v) = dvirtV[v];
+    std::copy_n(d2virtV.data(), NumVirtuals, d2B[i]);
+  }
+  for (int e = 1; e < getNumExcitations(); e++)
+    Ratios[e] = excitationDet(e, nullptr, 0);
+  Y_id = -1;
+}
+
+MultiSlaterDeterminant::MultiSlaterDeterminant(RefDetType* ref_up,
+                                               RefDetType* ref_dn,
+                                               SPOSet* spo,
+                                               SPOSet* virt,
+                                               int nelup,
+                                               int neldn)
+    : Virt(virt), nelup(nelup), Psi(1), curPsi(1)
+{
+  WaveFunctionComponentName = "MultiSlaterDeterminant";
+  Dets[0].reset(new MultiDiracDeterminant(ref_up, spo, virt, 0, nelup));
+  Dets[1].reset(new MultiDiracDeterminant(ref_dn, spo, virt, nelup, neldn));
+  WeightsValid[0] = WeightsValid[1] = false;
+  addDeterminant(ValueType(1), 0, 0);
+  TableTimer  = TimerManager.createTimer("MultiDeterminant::table", timer_level_fine);
+  RatioTimer  = TimerManager.createTimer("MultiDeterminant::ratio", timer_level_fine);
+  UpdateTimer = TimerManager.createTimer("MultiDeterminant::update", timer_level_fine);
+}
+
+void MultiSlaterDeterminant::addDeterminant(ValueType c, int exc_up, int exc_dn)
+{
+  C.push_back(c);
+  C2node[0].push_back(exc_up);
+  C2node[1].push_back(exc_dn);
+  WeightsValid[0] = WeightsValid[1] = false;
+}
+
+void MultiSlaterDeterminant::buildRandomExpansion(int num_dets, uint32_t seed)
+{
+  RandomGenerator<RealType> rng(seed);
+  const int num_exc = std::min(num_dets, static_cast<int>(std::ceil(2 * std::sqrt(num_dets))));
+  for (int spin = 0; spin < 2; spin++)
+  {
+    MultiDiracDeterminant& det = *Dets[spin];
+    const int nel              = det.getNumPtcls();
+    const int nvirt            = det.getNumVirtuals();
+    // excitations from the highest occupied orbitals, at most triples
+    const int num_active = std::min(nel, 16);
+    const int max_level  = std::min(std::min(3, num_active), nvirt);
+    if (max_level == 0)
+      continue;
+    std::set<std::pair<std::vector<int>, std::vector<int>>> known;
+    for (int attempt = 0; attempt < 100 * num_exc && det.getNumExcitations() <= num_exc; attempt++)
+    {
+      const RealType u = rng();
+      const int level  = std::min(u < 0.3 ? 1 : (u < 0.8 ? 2 : 3), max_level);
+      std::vector<int> occ, virt;
+      while (occ.size() < level)
+      {
+        const int o = nel - 1 - static_cast<int>(rng() * num_active);
+        if (std::find(occ.begin(), occ.end(), o) == occ.end())
+          occ.push_back(o);
+      }
+      while (virt.size() < level)
+      {
+        const int v = static_cast<int>(rng() * nvirt);
+        if (std::find(virt.begin(), virt.end(), v) == virt.end())
+          virt.push_back(v);
+      }
+      std::sort(occ.begin(), occ.end());
+      std::sort(virt.begin(), virt.end());
+      if (known.insert(std::make_pair(occ, virt)).second)
+        det.addExcitation(occ, virt);
+    }
+  }
+
+  const int num_up = Dets[0]->getNumExcitations();
+  const int num_dn = Dets[1]->getNumExcitations();
+  std::set<std::pair<int, int>> known;
+  known.insert(std::make_pair(0, 0));
+  const RealType scale = RealType(0.1) / std::sqrt(RealType(num_dets));
+  for (int attempt = 0; attempt < 100 * num_dets && getNumDeterminants() < num_dets; attempt++)
+  {
+    const int exc_up = std::min(static_cast<int>(rng() * num_up), num_up - 1);
+    const int exc_dn = std::min(static_cast<int>(rng() * num_dn), num_dn - 1);
+    if (known.insert(std::make_pair(exc_up, exc_dn)).second)
+      addDeterminant(scale * (2 * rng() - 1), exc_up, exc_dn);
+  }
+}
+
+void MultiSlaterDeterminant::updateWeights(int spin)
+{
+  if (WeightsValid[spin])
+    return;
+  std::vector<ValueType>& w           = Dets[spin]->Weights;
+  const std::vector<ValueType>& other = Dets[1 - spin]->Ratios;
+  std::fill(w.begin(), w.end(), ValueType(0));
+  for (int J = 0; J < C.size(); J++)
+    w[C2node[spin][J]] += C[J] * other[C2node[1 - spin][J]];
+  Dets[spin]->resetWeights();
+  WeightsValid[spin] = true;
+}
+
+MultiSlaterDeterminant::RealType MultiSlaterDeterminant::evaluateLog(ParticleSet& P,
+                                                                     ParticleSet::ParticleGradient_t& G,
+                                                                     ParticleSet::ParticleLaplacian_t& L)
+{
+  evaluateGL(P, G, L, true);
+  return LogValue;
+}
+
+void MultiSlaterDeterminant::evaluateGL(ParticleSet& P,
+                                        ParticleSet::ParticleGradient_t& G,
+                                        ParticleSet::ParticleLaplacian_t& L,
+                                        bool fromscratch)
+{
+  TableTimer->start();
+  for (int spin = 0; spin < 2; spin++)
+  {
+    Dets[spin]->evaluateTable(P);
+    WeightsValid[spin] = false;
+  }
+  updateWeights(0);
+  updateWeights(1);
+  const MultiDiracDeterminant& up = *Dets[0];
+  Psi = simd::dot(up.Weights.data(), up.Ratios.data(), up.Ratios.size());
+  LogValue = evaluateLogAndPhase(Psi, PhaseValue);
+  Dets[0]->evaluateGL(G, L, Psi);
+  Dets[1]->evaluateGL(G, L, Psi);
+  TableTimer->stop();
+}
+
+MultiSlaterDeterminant::GradType MultiSlaterDeterminant::evalGrad(ParticleSet& P, int iat)
+{
+  const int spin = getSpin(iat);
+  RatioTimer->start();
+  updateWeights(spin);
+  const GradType grad = Dets[spin]->evalGrad(iat) / Psi;
+  RatioTimer->stop();
+  return grad;
+}
+
+MultiSlaterDeterminant::ValueType MultiSlaterDeterminant::ratioGrad(ParticleSet& P, int iat, GradType& grad_iat)
+{
+  const int spin = getSpin(iat);
+  RatioTimer->start();
+  updateWeights(spin);
+  GradType grad;
+  curPsi = Psi + Dets[spin]->ratioGrad(P, iat, grad);
+  grad_iat += grad / curPsi;
+  RatioTimer->stop();
+  return curPsi / Psi;
+}
+
+MultiSlaterDeterminant::ValueType MultiSlaterDeterminant::ratio(ParticleSet& P, int iat)
+{
+  const int spin = getSpin(iat);
+  RatioTimer->start();
+  updateWeights(spin);
+  curPsi = Psi + Dets[spin]->ratio(P, iat);
+  RatioTimer->stop();
+  return curPsi / Psi;
+}
+
+void MultiSlaterDeterminant::evaluateRatios(VirtualParticleSet& VP, std::vector<ValueType>& ratios)
+{
+  const int spin = getSpin(VP.refPtcl);
+  RatioTimer->start();
+  updateWeights(spin);
+  Dets[spin]->evaluateRatios(VP, ratios);
+  for (int k = 0; k < ratios.size(); k++)
+    ratios[k] = (Psi + ratios[k]) / Psi;
+  RatioTimer->stop();
+}
+
+void MultiSlaterDeterminant::acceptMove(ParticleSet& P, int iat)
+{
+  const int spin = getSpin(iat);
+  UpdateTimer->start();
+  MultiDiracDeterminant& det = *Dets[spin];
+  det.acceptMove(iat);
+  WeightsValid[1 - spin] = false;
+  Psi      = simd::dot(det.Weights.data(), det.Ratios.data(), det.Ratios.size());
+  LogValue = evaluateLogAndPhase(Psi, PhaseValue);
+  UpdateTimer->stop();
+}
+
+} // namespace qmcplusplus
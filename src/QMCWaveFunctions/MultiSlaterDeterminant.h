@@ -0,0 +1,274 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/**@file MultiSlaterDeterminant.h
+ * @brief Declaration of MultiSlaterDeterminant, a CI expansion over excitations of the reference determinants
+ */
+#ifndef QMCPLUSPLUS_MULTISLATERDETERMINANT_H
+#define QMCPLUSPLUS_MULTISLATERDETERMINANT_H
+
+#include <memory>
+#include "QMCWaveFunctions/WaveFunctionComponent.h"
+#include "QMCWaveFunctions/DiracDeterminant.h"
+#include "QMCWaveFunctions/SPOSet.h"
+#include "Utilities/NewTimer.h"
+
+namespace qmcplusplus
+{
+/** the excited determinants of one spin relative to a reference DiracDeterminant
+ *
+ * Excitation e replaces the occupied orbitals Occupied(e) of the reference by the
+ * virtual orbitals Virtual(e). With A the matrix of the reference and B the virtual
+ * orbitals at the particles, the table T = A^{-1} B holds the ratios of all the single
+ * excitations and the ratio of e to the reference is the determinant of the rows
+ * Occupied(e) and the columns Virtual(e) of T.
+ *
+ * A move of particle i changes T by the rank one update c g^T, c the column i of A^{-1}
+ * and g given by the orbitals at the new position, see ratio. The ratios of the
+ * excitations are then linear in g and the coefficients Y of g, summed over the
+ * excitations with their Weights, are computed once per particle by prepareMove.
+ * A move costs O(N nvirt) and a few determinants of size up to the excitation level
+ * per unique excitation, independent of the number of determinants of the expansion.
+ */
+class MultiDiracDeterminant : public QMCTraits
+{
+public:
+  using RefDetType      = DiracDeterminant<>;
+  using ValueVector_t   = SPOSet::ValueVector_t;
+  using GradVectorSoA_t = SPOSet::GradVectorSoA_t;
+  using ValueMatrix_t   = Matrix<ValueType>;
+  using GradMatrix_t    = Matrix<GradType>;
+
+  /** constructor
+   * @param ref reference determinant, must be evaluated before this object
+   * @param occ orbitals of the reference determinant
+   * @param virt virtual orbitals
+   * @param first index of the first particle
+   * @param nel number of particles
+   *
+   * The excitation 0 is the reference itself.
+   */
+  MultiDiracDeterminant(RefDetType* ref, SPOSet* occ, SPOSet* virt, int first, int nel);
+
+  /** add an excitation
+   * @param occ distinct occupied orbitals, [0, nel)
+   * @param virt distinct virtual orbitals, [0, virt->size()), as many as occ
+   * @return index of the excitation
+   */
+  int addExcitation(const std::vector<int>& occ, const std::vector<int>& virt);
+
+  inline int getNumPtcls() const { return NumPtcls; }
+  inline int getNumVirtuals() const { return NumVirtuals; }
+  inline int getNumExcitations() const { return ExcOffset.size() - 1; }
+  inline int getLevel(int e) const { return ExcOffset[e + 1] - ExcOffset[e]; }
+
+  /// compute B, T and the Ratios from the up-to-date inverse of the reference
+  void evaluateTable(ParticleSet& P);
+
+  /** add the gradients and laplacians of log(psi) to G and L
+   * @param psi current value of the expansion, sum of Weights times Ratios
+   *
+   * The tables must be evaluated and the Weights set.
+   */
+  void evaluateGL(ParticleSet::ParticleGradient_t& G, ParticleSet::ParticleLaplacian_t& L, ValueType psi);
+
+  /// the gradient of the expansion with respect to particle iat at its current position
+  GradType evalGrad(int iat);
+
+  /** change of the expansion for the move of particle iat with the orbital values only
+   * @return the new minus the current value of the expansion
+   */
+  ValueType ratio(ParticleSet& P, int iat);
+
+  /** change of the expansion for the move of particle iat, reusing the orbitals of the reference
+   * @param grad gradient of the new value of the expansion with respect to particle iat
+   * @return the new minus the current value of the expansion
+   */
+  ValueType ratioGrad(ParticleSet& P, int iat, GradType& grad);
+
+  /** changes of the expansion for the virtual moves of VP
+   * @param dpsi new minus current values of the expansion
+   */
+  void evaluateRatios(VirtualParticleSet& VP, std::vector<ValueType>& dpsi);
+
+  /// update T and the Ratios after the move given to ratio or ratioGrad
+  void acceptMove(int iat);
+
+  /// the weights changed, Y must be computed again
+  void resetWeights() { Y_id = -1; }
+
+  /// ratio of each excitation to the reference
+  std::vector<ValueType> Ratios;
+  /// weight of each excitation, the sum of the coefficients of its determinants times the ratios of the other spin
+  std::vector<ValueType> Weights;
+
+private:
+  /// the reference determinant, its inverse and orbital derivatives are reused
+  RefDetType* const Ref;
+  /// orbitals of the reference
+  SPOSet* const Occ;
+  /// virtual orbitals
+  SPOSet* const Virt;
+  /// index of the first particle
+  const int FirstIndex;
+  /// number of particles
+  const int NumPtcls;
+  /// number of virtual orbitals
+  const int NumVirtuals;
+
+  /// the orbitals of excitation e are ExcOcc and ExcVirt in [ExcOffset[e], ExcOffset[e+1])
+  std::vector<int> ExcOffset;
+  std::vector<int> ExcOcc;
+  std::vector<int> ExcVirt;
+
+  /// B(i,v), virtual orbitals at the particles
+  ValueMatrix_t B;
+  GradMatrix_t dB;
+  ValueMatrix_t d2B;
+  /// T(o,v) = A^{-1} B, the table of the single excitations
+  ValueMatrix_t T;
+
+  /// particle of the move for which cInv and Y are valid, -1 if none
+  int Y_id;
+  /// column of A^{-1} of the moved particle
+  ValueVector_t cInv;
+  /// coefficients of g in the change of the expansion
+  ValueVector_t Y;
+  /// occupied orbitals at a knot of evaluateRatios, ratio reuses those of the reference
+  ValueVector_t psiV;
+  ValueVector_t virtV;
+  GradVectorSoA_t dvirtV;
+  ValueVector_t d2virtV;
+  /// g = (b' - T^T a') / rho of the proposed move, T + cInv g^T is the new table
+  ValueVector_t gV;
+  /// gradients of b' - T^T a'
+  GradVectorSoA_t dfV;
+  /// the orbitals at the new position include the gradients
+  bool MoveHasGradients;
+  /// laplacians of b - T^T a for all the particles
+  ValueMatrix_t d2F;
+  /// scratch of the small determinants
+  std::vector<ValueType> SmallMat;
+
+  /** determinant of the excitation e
+   * @param u if not null, replaces the column b by u[occupied orbital]
+   */
+  ValueType excitationDet(int e, const ValueType* u, int b);
+
+  /// Y from cInv and the Weights
+  void computeY();
+
+  /// cInv and Y for the move of particle iat, Ref must hold its inverse row
+  void prepareMove(int iat);
+
+  /// gV = (virtV - T^T psi) / rho
+  void computeG(const ValueType* psi, ValueType rho);
+
+  /// dfV[d] = dvirtV[d] - T^T dpsi[d] for the gradients of the orbitals of the reference in SoA
+  void computeGradF(const GradVectorSoA_t& dpsi);
+};
+
+/** multi Slater determinant wavefunction component
+ *
+ * \f$\Psi = D^{\uparrow}_0 D^{\downarrow}_0 \sum_J C_J R^{\uparrow}_{J} R^{\downarrow}_{J}\f$
+ * with \f$D_0\f$ the reference determinants, kept as the Det_up and Det_dn components
+ * of WaveFunction, and \f$R_J\f$ the ratios of the excitations of determinant J to the
+ * references. This component is the sum, it must be called after the references.
+ * The ratios of the unique excitations of each spin come from a MultiDiracDeterminant.
+ */
+class MultiSlaterDeterminant : public WaveFunctionComponent
+{
+public:
+  using RefDetType = MultiDiracDeterminant::RefDetType;
+
+  /** constructor
+   * @param ref_up reference determinant of the up spins
+   * @param ref_dn reference determinant of the down spins
+   * @param spo orbitals of the references
+   * @param virt virtual orbitals, owned by this object
+   * @param nelup number of up spins
+   * @param neldn number of down spins
+   *
+   * The expansion holds only the reference until determinants are added.
+   */
+  MultiSlaterDeterminant(RefDetType* ref_up, RefDetType* ref_dn, SPOSet* spo, SPOSet* virt, int nelup, int neldn);
+
+  // copy constructor and assign operator disabled
+  MultiSlaterDeterminant(const MultiSlaterDeterminant& s) = delete;
+  MultiSlaterDeterminant& operator=(const MultiSlaterDeterminant& s) = delete;
+
+  /** add the determinant C R_up[exc_up] R_dn[exc_dn]
+   * @param exc_up index of an excitation of the up spins
+   * @param exc_dn index of an excitation of the down spins
+   */
+  void addDeterminant(ValueType c, int exc_up, int exc_dn);
+
+  /** build a random expansion of num_dets determinants
+   *
+   * The coefficient of the reference is 1, the others are small. Each spin has about
+   * 2 sqrt(num_dets) unique single, double and triple excitations from the highest
+   * occupied orbitals, paired at random. The expansion only depends on seed and the sizes.
+   */
+  void buildRandomExpansion(int num_dets, uint32_t seed = 11);
+
+  inline int getNumDeterminants() const { return C.size(); }
+  inline MultiDiracDeterminant& getDet(int spin) { return *Dets[spin]; }
+
+  RealType evaluateLog(ParticleSet& P, ParticleSet::ParticleGradient_t& G, ParticleSet::ParticleLaplacian_t& L) override;
+
+  /// the tables are computed from the inverses of the references, also removing the drift of the updates
+  void evaluateGL(ParticleSet& P,
+                  ParticleSet::ParticleGradient_t& G,
+                  ParticleSet::ParticleLaplacian_t& L,
+                  bool fromscratch = false) override;
+
+  GradType evalGrad(ParticleSet& P, int iat) override;
+
+  ValueType ratioGrad(ParticleSet& P, int iat, GradType& grad_iat) override;
+
+  ValueType ratio(ParticleSet& P, int iat) override;
+
+  void evaluateRatios(VirtualParticleSet& VP, std::vector<ValueType>& ratios) override;
+
+  void acceptMove(ParticleSet& P, int iat) override;
+
+private:
+  /// excitations of the up and down spins
+  std::unique_ptr<MultiDiracDeterminant> Dets[2];
+  /// the virtual orbitals, shared by both spins
+  std::unique_ptr<SPOSet> Virt;
+  /// coefficients of the determinants
+  std::vector<ValueType> C;
+  /// excitation of each spin in each determinant
+  std::vector<int> C2node[2];
+  /// number of up spins
+  const int nelup;
+  /// the Weights of a spin are up to date
+  bool WeightsValid[2];
+  /// current value of the expansion
+  ValueType Psi;
+  /// value of the expansion after the proposed move
+  ValueType curPsi;
+
+  /// Timers
+  NewTimer* TableTimer;
+  NewTimer* RatioTimer;
+  NewTimer* UpdateTimer;
+
+  inline int getSpin(int iat) const { return iat < nelup ? 0 : 1; }
+
+  /// compute the Weights of a spin if the other spin moved
+  void updateWeights(int spin);
+};
+
+} // namespace qmcplusplus
+#endif
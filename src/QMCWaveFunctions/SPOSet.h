@@ -14,7 +14,9 @@
 
 #include <string>
 #include "Utilities/Configuration.h"
+#include "Utilities/SIMD/allocator.hpp"
 #include "Numerics/OhmmsPETE/OhmmsMatrix.h"
+#include "Numerics/OhmmsPETE/VectorSoAContainer.h"
 #include "Particle/ParticleSet.h"
 #include "Particle/VirtualParticleSet.h"
 
@@ -35,10 +37,12 @@ protected:
   std::string className;
 
 public:
-  using ValueVector_t = Vector<ValueType>;
-  using GradVector_t  = Vector<GradType>;
-  using ValueMatrix_t = Matrix<ValueType>;
-  using GradMatrix_t  = Matrix<GradType>;
+  /// aligned for the SPO to write in place, see evaluateVGL
+  using ValueVector_t   = Vector<ValueType, aligned_allocator<ValueType>>;
+  using GradVector_t    = Vector<GradType>;
+  using GradVectorSoA_t = VectorSoAContainer<ValueType, DIM>;
+  using ValueMatrix_t   = Matrix<ValueType>;
+  using GradMatrix_t    = Matrix<GradType>;
 
   /// return the size of the orbital set
   inline int size() const { return OrbitalSetSize; }
@@ -63,6 +67,42 @@ public:
    */
   virtual void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v, GradVector_t& dpsi_v, ValueVector_t& d2psi_v) = 0;
 
+  /** same as evaluate but the gradients are stored in SoA
+   * @param dpsi gradients of the SPO, component d in dpsi_v.data(d)
+   *
+   * The SPO may write directly in the caller buffers. By default, the gradients are
+   * evaluated in AoS and transposed.
+   */
+  virtual void evaluateVGL(const ParticleSet& P,
+                           int iat,
+                           ValueVector_t& psi_v,
+                           GradVectorSoA_t& dpsi_v,
+                           ValueVector_t& d2psi_v)
+  {
+    GradVector_t dpsi_aos(OrbitalSetSize);
+    evaluate(P, iat, psi_v, dpsi_aos, d2psi_v);
+    for (int j = 0; j < OrbitalSetSize; j++)
+      dpsi_v(j) = dpsi_aos[j];
+  }
+
+  /** hint that the orbitals will be evaluated at r, see MultiBsplineEval::prefetch_stencil
+   *
+   * Starts loading the data of the evaluation without waiting for it. Does nothing by default.
+   */
+  virtual void prefetch(const PosType& r) const {}
+
+  /** evaluate the determinant ratio of a move, the dot product of the values with psiinv
+   * @param psi values of the SPO, used as a scratch space if needed
+   * @param psiinv the row of inverse slater matrix corresponding to the particle moved
+   *
+   * psi is not necessarily filled, see einspline_spo::evaluateDetRatio.
+   */
+  virtual ValueType evaluateDetRatio(const ParticleSet& P, int iat, ValueVector_t& psi, const ValueVector_t& psiinv)
+  {
+    evaluate(P, iat, psi);
+    return simd::dot(psi.data(), psiinv.data(), psi.size());
+  }
+
   /** evaluate determinant ratios for virtual moves, e.g., sphere move for nonlocalPP
    * @param VP virtual particle set
    * @param psi values of the SPO, used as a scratch space if needed
@@ -126,6 +166,18 @@ public:
       spo_list[iw]->evaluate(*P_list[iw], iat, *psi_v_list[iw], *dpsi_v_list[iw], *d2psi_v_list[iw]);
   }
 
+  /// evaluateVGL of multiple walkers
+  virtual void multi_evaluateVGL(const std::vector<SPOSet*>& spo_list, const std::vector<ParticleSet*>& P_list,
+                                 int iat,
+                                 std::vector<ValueVector_t*>& psi_v_list,
+                                 std::vector<GradVectorSoA_t*>& dpsi_v_list,
+                                 std::vector<ValueVector_t*>& d2psi_v_list)
+  {
+#pragma omp parallel for
+    for (int iw = 0; iw < spo_list.size(); iw++)
+      spo_list[iw]->evaluateVGL(*P_list[iw], iat, *psi_v_list[iw], *dpsi_v_list[iw], *d2psi_v_list[iw]);
+  }
+
 };
 
 } // namespace qmcplusplus
@@ -0,0 +1,129 @@
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License. See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef QMCPLUSPLUS_SINGLEPARTICLEORBITALSET_TEAM_H
+#define QMCPLUSPLUS_SINGLEPARTICLEORBITALSET_TEAM_H
+
+#include <memory>
+#include "QMCWaveFunctions/SPOSet.h"
+
+namespace qmcplusplus
+{
+/** SPOSet evaluated by a team of threads
+ *
+ * Each member is a view holding a slice of the spline blocks, see the
+ * team_size/member_id constructor of einspline_spo. A member writes only its
+ * orbitals into the output vectors, and its evaluateDetRatios returns the
+ * contribution of its orbitals, so the members run concurrently on the shared
+ * outputs. Every call opens a nested parallel region of one thread per member.
+ * If nesting is disabled, the calling thread evaluates all the members.
+ */
+class SPOSetTeam : public SPOSet
+{
+  /// views of the same table, one per member
+  std::vector<std::unique_ptr<SPOSet>> Members;
+  /// partial ratios of evaluateDetRatios, per member
+  std::vector<std::vector<ValueType>> MemberRatios;
+
+public:
+  /// take the ownership of the member views
+  SPOSetTeam(std::vector<std::unique_ptr<SPOSet>>&& members) : Members(std::move(members))
+  {
+    OrbitalSetSize = Members[0]->size();
+    className      = "SPOSetTeam";
+    MemberRatios.resize(Members.size());
+  }
+
+  /// number of members
+  int team_size() const { return Members.size(); }
+
+  void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v) override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+      Members[m]->evaluate(P, iat, psi_v);
+  }
+
+  void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v, GradVector_t& dpsi_v, ValueVector_t& d2psi_v)
+      override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+      Members[m]->evaluate(P, iat, psi_v, dpsi_v, d2psi_v);
+  }
+
+  void evaluateVGL(const ParticleSet& P,
+                   int iat,
+                   ValueVector_t& psi_v,
+                   GradVectorSoA_t& dpsi_v,
+                   ValueVector_t& d2psi_v) override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+      Members[m]->evaluateVGL(P, iat, psi_v, dpsi_v, d2psi_v);
+  }
+
+  /// prefetched by the calling thread, the data is shared through the last level cache
+  void prefetch(const PosType& r) const override
+  {
+    for (auto& member : Members)
+      member->prefetch(r);
+  }
+
+  void evaluateDetRatios(const VirtualParticleSet& VP,
+                         ValueVector_t& psi,
+                         const ValueVector_t& psiinv,
+                         std::vector<ValueType>& ratios) override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+    {
+      MemberRatios[m].resize(ratios.size());
+      Members[m]->evaluateDetRatios(VP, psi, psiinv, MemberRatios[m]);
+    }
+    for (int iat = 0; iat < ratios.size(); ++iat)
+    {
+      ratios[iat] = ValueType();
+      for (int m = 0; m < team_size(); ++m)
+        ratios[iat] += MemberRatios[m][iat];
+    }
+  }
+
+  ValueType evaluateDetRatio(const ParticleSet& P, int iat, ValueVector_t& psi, const ValueVector_t& psiinv) override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+    {
+      MemberRatios[m].resize(1);
+      MemberRatios[m][0] = Members[m]->evaluateDetRatio(P, iat, psi, psiinv);
+    }
+    ValueType ratio = ValueType();
+    for (int m = 0; m < team_size(); ++m)
+      ratio += MemberRatios[m][0];
+    return ratio;
+  }
+
+  /// a single parallel region for all the particles
+  void evaluate_notranspose(const ParticleSet& P,
+                            int first,
+                            int last,
+                            ValueMatrix_t& logdet,
+                            GradMatrix_t& dlogdet,
+                            ValueMatrix_t& d2logdet) override
+  {
+#pragma omp parallel num_threads(team_size())
+    for (int m = omp_get_thread_num(); m < team_size(); m += omp_get_num_threads())
+      Members[m]->evaluate_notranspose(P, first, last, logdet, dlogdet, d2logdet);
+  }
+};
+
+} // namespace qmcplusplus
+#endif
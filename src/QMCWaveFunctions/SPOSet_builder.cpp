@@ -10,12 +10,133 @@
 
 
 #include "QMCWaveFunctions/SPOSet_builder.h"
+#include "QMCWaveFunctions/SPOSetTeam.h"
 #include <Utilities/RandomGenerator.h>
 #include "QMCWaveFunctions/einspline_spo.hpp"
 #include "QMCWaveFunctions/einspline_spo_ref.hpp"
+#include <sstream>
+#include <unistd.h>
 
 namespace qmcplusplus
 {
+bool getSplineStorage(const std::string& name, SplineStorage& storage)
+{
+  if (name == "native")
+    storage = SplineStorage::native;
+  else if (name == "fp16")
+    storage = SplineStorage::fp16;
+  else if (name == "bf16")
+    storage = SplineStorage::bf16;
+  else
+    return false;
+  return true;
+}
+
+size_t getSplineStorageSize(SplineStorage storage)
+{
+  switch (storage)
+  {
+  case SplineStorage::fp16:
+    return sizeof(float16);
+  case SplineStorage::bf16:
+    return sizeof(bfloat16);
+  default:
+    return sizeof(OHMMS_PRECISION);
+  }
+}
+
+bool getFirstTouch(const std::string& name, FirstTouch& policy)
+{
+  if (name == "block")
+    policy = FirstTouch::block;
+  else if (name == "interleave")
+    policy = FirstTouch::interleave;
+  else
+    return false;
+  return true;
+}
+
+bool getSplineISA(const std::string& name, SplineISA& isa)
+{
+  if (name == "auto")
+    isa = detectSplineISA();
+  else if (name == "portable")
+    isa = SplineISA::portable;
+  else if (name == "avx2")
+    isa = SplineISA::avx2;
+  else if (name == "avx512")
+    isa = SplineISA::avx512;
+  else
+    return false;
+  return true;
+}
+
+template<typename CT>
+SPOSet* build_einspline_spo(int nx,
+                            int ny,
+                            int nz,
+                            int num_splines,
+                            int nblocks,
+                            const Tensor<OHMMS_PRECISION, 3>& lattice_b,
+                            const SPOSetOptions& options)
+{
+  auto* spo_main = new einspline_spo<OHMMS_PRECISION, CT>;
+  if (!options.spline_file.empty() &&
+      spo_main->load(options.spline_file, nx, ny, nz, num_splines, nblocks, options.first_orbital))
+    app_log() << "SPO coefficients mapped from " << options.spline_file << std::endl;
+  else if (options.node_comm)
+  {
+    // the name identifies the table, processes of different users never share it
+    std::ostringstream name;
+    name << "/miniqmc_spo_" << getuid() << "_" << nx << "_" << ny << "_" << nz << "_" << num_splines << "_"
+         << nblocks << "_" << sizeof(CT) << "_" << options.first_orbital;
+    spo_main->set_shared(*options.node_comm, name.str(), nx, ny, nz, num_splines, nblocks, true,
+                         options.first_touch, options.first_orbital);
+  }
+  else
+    spo_main->set(nx, ny, nz, num_splines, nblocks, true, options.first_touch, options.first_orbital);
+  if (!options.spline_file.empty() && !spo_main->isMapped())
+  {
+    if (access(options.spline_file.c_str(), F_OK) == 0)
+      app_warning() << options.spline_file << " holds another table or was generated differently, replacing it"
+                    << std::endl;
+    if (spo_main->write(options.spline_file))
+      app_log() << "SPO coefficients written to " << options.spline_file << std::endl;
+    else
+      app_warning() << "Failed to write SPO coefficients to " << options.spline_file << std::endl;
+  }
+  if (options.bricks && !spo_main->to_bricks())
+    app_warning() << "SPO coefficients shared or mapped from a file are kept in the plain layout" << std::endl;
+  if (options.numa_replicas)
+  {
+    const int num_replicas = spo_main->replicate_per_numa_node();
+    if (num_replicas > 0)
+      app_log() << "SPO coefficients replicated on " << num_replicas << " NUMA nodes" << std::endl;
+    else if (options.node_comm != nullptr)
+      app_warning() << "SPO coefficients not replicated, they are shared by the processes of the node" << std::endl;
+    else
+      app_log() << "SPO coefficients not replicated, the threads run on a single NUMA node" << std::endl;
+  }
+  if (isSplineISASupported(options.isa))
+    spo_main->ISA = options.isa;
+  else
+    app_warning() << "SPO kernels " << getSplineISAName(options.isa) << " not supported by this cpu, using "
+                  << getSplineISAName(spo_main->ISA) << std::endl;
+  spo_main->Lattice.set(lattice_b);
+  return dynamic_cast<SPOSet*>(spo_main);
+}
+
+/// create a view if SPOSet_main is an einspline_spo storing CT, return nullptr otherwise
+template<typename CT>
+SPOSet* build_einspline_spo_view(const SPOSet* SPOSet_main, int team_size, int member_id)
+{
+  auto* temp_ptr = dynamic_cast<const einspline_spo<OHMMS_PRECISION, CT>*>(SPOSet_main);
+  if (temp_ptr == nullptr)
+    return nullptr;
+  auto* spo_view = new einspline_spo<OHMMS_PRECISION, CT>(*temp_ptr, team_size, member_id);
+  return dynamic_cast<SPOSet*>(spo_view);
+}
+
 SPOSet* build_SPOSet(bool useRef,
                      int nx,
                      int ny,
@@ -23,7 +144,8 @@ SPOSet* build_SPOSet(bool useRef,
                      int num_splines,
                      int nblocks,
                      const Tensor<OHMMS_PRECISION, 3>& lattice_b,
-                     bool init_random)
+                     bool init_random,
+                     const SPOSetOptions& options)
 {
   if (useRef)
   {
@@ -34,10 +156,15 @@ SPOSet* build_SPOSet(bool useRef,
   }
   else
   {
-    auto* spo_main = new einspline_spo<OHMMS_PRECISION>;
-    spo_main->set(nx, ny, nz, num_splines, nblocks);
-    spo_main->Lattice.set(lattice_b);
-    return dynamic_cast<SPOSet*>(spo_main);
+    switch (options.storage)
+    {
+    case SplineStorage::fp16:
+      return build_einspline_spo<float16>(nx, ny, nz, num_splines, nblocks, lattice_b, options);
+    case SplineStorage::bf16:
+      return build_einspline_spo<bfloat16>(nx, ny, nz, num_splines, nblocks, lattice_b, options);
+    default:
+      return build_einspline_spo<OHMMS_PRECISION>(nx, ny, nz, num_splines, nblocks, lattice_b, options);
+    }
   }
 }
 
@@ -53,10 +180,25 @@ SPOSet* build_SPOSet_view(bool useRef, const SPOSet* SPOSet_main, int team_size,
   }
   else
   {
-    auto* temp_ptr = dynamic_cast<const einspline_spo<OHMMS_PRECISION>*>(SPOSet_main);
-    auto* spo_view = new einspline_spo<OHMMS_PRECISION>(*temp_ptr, team_size, member_id);
-    return dynamic_cast<SPOSet*>(spo_view);
+    SPOSet* spo_view = build_einspline_spo_view<OHMMS_PRECISION>(SPOSet_main, team_size, member_id);
+    if (spo_view == nullptr)
+      spo_view = build_einspline_spo_view<float16>(SPOSet_main, team_size, member_id);
+    if (spo_view == nullptr)
+      spo_view = build_einspline_spo_view<bfloat16>(SPOSet_main, team_size, member_id);
+    return spo_view;
   }
 }
 
+SPOSet* build_SPOSet_team(bool useRef, const SPOSet* SPOSet_main, int team_size)
+{
+  if (useRef || team_size == 1)
+    return build_SPOSet_view(useRef, SPOSet_main, 1, 0);
+
+  std::vector<std::unique_ptr<SPOSet>> members(team_size);
+#pragma omp parallel num_threads(team_size)
+  for (int m = omp_get_thread_num(); m < team_size; m += omp_get_num_threads())
+    members[m].reset(build_SPOSet_view(useRef, SPOSet_main, team_size, m));
+  return new SPOSetTeam(std::move(members));
+}
+
 } // namespace qmcplusplus
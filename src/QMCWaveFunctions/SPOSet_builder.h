@@ -13,9 +13,75 @@
 #define QMCPLUSPLUS_SINGLEPARTICLEORBITALSET_BUILDER_H
 
 #include "QMCWaveFunctions/SPOSet.h"
+#include "Utilities/Communicate.h"
+#include "Numerics/Spline2/BsplineAllocator.hpp"
+#include "Numerics/Spline2/MultiBsplineSIMD.hpp"
 
 namespace qmcplusplus
 {
+/// storage type of the einspline coefficients
+enum class SplineStorage
+{
+  native, ///< same as the evaluation precision
+  fp16,   ///< IEEE 754 half precision, widened on evaluation
+  bf16    ///< bfloat16, widened on evaluation
+};
+
+/** parse the name of a SplineStorage: native, fp16 or bf16
+ * @return false if the name is not recognized
+ */
+bool getSplineStorage(const std::string& name, SplineStorage& storage);
+
+/// bytes per spline coefficient of a SplineStorage
+size_t getSplineStorageSize(SplineStorage storage);
+
+/// parse a first-touch policy name, block or interleave, return false if unknown
+bool getFirstTouch(const std::string& name, FirstTouch& policy);
+
+/** parse the name of a SplineISA: auto, portable, avx2 or avx512
+ *
+ * auto selects the widest instruction set supported by the cpu.
+ * @return false if the name is not recognized
+ */
+bool getSplineISA(const std::string& name, SplineISA& isa);
+
+/// options controlling how build_SPOSet creates the spline tables
+struct SPOSetOptions
+{
+  /// coefficient storage, ignored by the reference implementation
+  SplineStorage storage = SplineStorage::native;
+  /** if set, the coefficients are shared by the processes of a node
+   *
+   * Processes building the same table, also independent runs without MPI,
+   * attach to a single copy. Ignored by the reference implementation.
+   */
+  Communicate* node_comm = nullptr;
+  /** if not empty, map the coefficients from this file
+   *
+   * The file is written after building the table if it is missing or holds
+   * another table. Ignored by the reference implementation.
+   */
+  std::string spline_file;
+  /// placement of the coefficient pages when the table is built
+  FirstTouch first_touch = FirstTouch::block;
+  /// copy the table to every NUMA node running threads, views use the local copy
+  bool numa_replicas = false;
+  /// store the coefficients in Morton-ordered 4x4x4 bricks
+  bool bricks = false;
+  /** index of the first orbital of the random coefficients
+   *
+   * A table of virtual orbitals starting at the number of occupied ones
+   * continues the occupied table instead of repeating its orbitals.
+   */
+  int first_orbital = 0;
+  /** instruction set of the spline kernels
+   *
+   * Falls back to the widest supported one if the cpu lacks it.
+   * Ignored by the reference implementation.
+   */
+  SplineISA isa = detectSplineISA();
+};
+
 /// build the einspline SPOSet.
 SPOSet* build_SPOSet(bool useRef,
                      int nx,
@@ -24,10 +90,19 @@ SPOSet* build_SPOSet(bool useRef,
                      int num_splines,
                      int nblocks,
                      const Tensor<OHMMS_PRECISION, 3>& lattice_b,
-                     bool init_random = true);
+                     bool init_random = true,
+                     const SPOSetOptions& options = SPOSetOptions());
 
 /// build the einspline SPOSet as a view of the main one.
 SPOSet* build_SPOSet_view(bool useRef, const SPOSet* SPOSet_main, int team_size, int member_id);
 
+/** build the SPOSet of a walker evaluated by team_size threads, see SPOSetTeam
+ *
+ * Each member view is created by the thread running it. A single view is
+ * returned if team_size is 1. Teams are not supported by the reference
+ * implementation.
+ */
+SPOSet* build_SPOSet_team(bool useRef, const SPOSet* SPOSet_main, int team_size);
+
 } // namespace qmcplusplus
 #endif
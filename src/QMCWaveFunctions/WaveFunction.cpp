@@ -18,6 +18,7 @@
 #include <QMCWaveFunctions/WaveFunction.h>
 #include <QMCWaveFunctions/DiracDeterminantRef.h>
 #include <QMCWaveFunctions/DiracDeterminant.h>
+#include <QMCWaveFunctions/MultiSlaterDeterminant.h>
 #include <QMCWaveFunctions/Jastrow/BsplineFunctor.h>
 #include <QMCWaveFunctions/Jastrow/PolynomialFunctor3D.h>
 #include <QMCWaveFunctions/Jastrow/OneBodyJastrowRef.h>
@@ -41,6 +42,19 @@ TimerNameLevelList_t<WaveFunctionTimers> WaveFunctionTimerNames =
      {Timer_CompleteUpdates, "Complete Updates", timer_level_coarse}};
 
 
+bool getInverseMethod(const std::string& name, InverseMethod& method)
+{
+  if (name == "lapack")
+    method = InverseMethod::lapack;
+  else if (name == "mixed")
+    method = InverseMethod::mixed;
+  else if (name == "native")
+    method = InverseMethod::native;
+  else
+    return false;
+  return true;
+}
+
 void build_WaveFunction(bool useRef,
                         const SPOSet* spo_main,
                         WaveFunction& WF,
@@ -48,7 +62,13 @@ void build_WaveFunction(bool useRef,
                         ParticleSet& els,
                         const RandomGenerator<QMCTraits::RealType>& RNG,
                         int delay_rank,
-                        bool enableJ3)
+                        bool enableJ3,
+                        int team_size,
+                        bool adaptive_delay,
+                        InverseMethod inverse,
+                        const SPOSet* spo_virtual,
+                        int num_dets,
+                        const RecomputePolicy& recompute)
 {
   using valT = WaveFunction::valT;
   using posT = WaveFunction::posT;
@@ -59,8 +79,8 @@ void build_WaveFunction(bool useRef,
     return;
   }
 
-  // create a spo view
-  auto spo = build_SPOSet_view(useRef, spo_main, 1, 0);
+  // create a spo view, or a team of views sharing the orbitals
+  auto spo = build_SPOSet_team(useRef, spo_main, team_size);
 
   const int nelup = els.getTotalNum() / 2;
 
@@ -117,8 +137,18 @@ void build_WaveFunction(bool useRef,
 
     // determinant component
     WF.nelup  = nelup;
-    WF.Det_up = new DetType(spo, 0, delay_rank);
-    WF.Det_dn = new DetType(spo, nelup, delay_rank);
+    WF.Det_up = new DetType(spo, 0, delay_rank, adaptive_delay, inverse, recompute);
+    WF.Det_dn = new DetType(spo, nelup, delay_rank, adaptive_delay, inverse, recompute);
+
+    // multi determinant expansion over the excitations of the references
+    if (spo_virtual != nullptr && num_dets > 1)
+    {
+      auto* MultiDet = new MultiSlaterDeterminant(static_cast<DetType*>(WF.Det_up), static_cast<DetType*>(WF.Det_dn),
+                                                  spo, build_SPOSet_view(false, spo_virtual, 1, 0), nelup,
+                                                  els.getTotalNum() - nelup);
+      MultiDet->buildRandomExpansion(num_dets);
+      WF.MultiDet = MultiDet;
+    }
 
     // J1 component
     J1OrbType* J1 = new J1OrbType(ions, els);
@@ -151,6 +181,7 @@ WaveFunction::WaveFunction()
         ei_TableID(1),
         Det_up(nullptr),
         Det_dn(nullptr),
+        MultiDet(nullptr),
         LogValue(0.0)
   {}
 
@@ -160,6 +191,7 @@ WaveFunction::~WaveFunction()
   {
     delete Det_up;
     delete Det_dn;
+    delete MultiDet;
     for (size_t i = 0; i < Jastrows.size(); i++)
       delete Jastrows[i];
   }
@@ -177,26 +209,50 @@ void WaveFunction::setupTimers()
 
 void WaveFunction::evaluateLog(ParticleSet& P)
 {
-  constexpr valT czero(0);
   if (FirstTime)
   {
-    P.G      = czero;
-    P.L      = czero;
-    LogValue = Det_up->evaluateLog(P, P.G, P.L);
-    LogValue += Det_dn->evaluateLog(P, P.G, P.L);
-    for (size_t i = 0; i < Jastrows.size(); i++)
-    {
-      jastrow_timers[i]->start();
-      LogValue += Jastrows[i]->evaluateLog(P, P.G, P.L);
-      jastrow_timers[i]->stop();
-    }
+    recompute(P);
     FirstTime = false;
   }
 }
 
+void WaveFunction::recompute(ParticleSet& P)
+{
+  constexpr valT czero(0);
+  P.G      = czero;
+  P.L      = czero;
+  LogValue = Det_up->evaluateLog(P, P.G, P.L);
+  LogValue += Det_dn->evaluateLog(P, P.G, P.L);
+  if (MultiDet)
+    LogValue += MultiDet->evaluateLog(P, P.G, P.L);
+  for (size_t i = 0; i < Jastrows.size(); i++)
+  {
+    jastrow_timers[i]->start();
+    LogValue += Jastrows[i]->evaluateLog(P, P.G, P.L);
+    jastrow_timers[i]->stop();
+  }
+}
+
+void WaveFunction::swap(WaveFunction& other)
+{
+  std::swap(Det_up, other.Det_up);
+  std::swap(Det_dn, other.Det_dn);
+  std::swap(MultiDet, other.MultiDet);
+  Jastrows.swap(other.Jastrows);
+  std::swap(LogValue, other.LogValue);
+  std::swap(FirstTime, other.FirstTime);
+  std::swap(Is_built, other.Is_built);
+  std::swap(nelup, other.nelup);
+  std::swap(ei_TableID, other.ei_TableID);
+  timers.swap(other.timers);
+  jastrow_timers.swap(other.jastrow_timers);
+}
+
 WaveFunction::posT WaveFunction::evalGrad(ParticleSet& P, int iat)
 {
   posT grad_iat = (iat < nelup ? Det_up->evalGrad(P, iat) : Det_dn->evalGrad(P, iat));
+  if (MultiDet)
+    grad_iat += MultiDet->evalGrad(P, iat);
 
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
@@ -211,6 +267,8 @@ WaveFunction::valT WaveFunction::ratioGrad(ParticleSet& P, int iat, posT& grad)
 {
   grad       = valT(0);
   valT ratio = (iat < nelup ? Det_up->ratioGrad(P, iat, grad) : Det_dn->ratioGrad(P, iat, grad));
+  if (MultiDet)
+    ratio *= MultiDet->ratioGrad(P, iat, grad);
 
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
@@ -224,6 +282,8 @@ WaveFunction::valT WaveFunction::ratioGrad(ParticleSet& P, int iat, posT& grad)
 WaveFunction::valT WaveFunction::ratio(ParticleSet& P, int iat)
 {
   valT ratio = (iat < nelup ? Det_up->ratio(P, iat) : Det_dn->ratio(P, iat));
+  if (MultiDet)
+    ratio *= MultiDet->ratio(P, iat);
 
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
@@ -234,12 +294,22 @@ WaveFunction::valT WaveFunction::ratio(ParticleSet& P, int iat)
   return ratio;
 }
 
+void WaveFunction::prefetch(int iat, const posT& newpos)
+{
+  if (iat < nelup)
+    Det_up->prefetch(iat, newpos);
+  else
+    Det_dn->prefetch(iat, newpos);
+}
+
 void WaveFunction::acceptMove(ParticleSet& P, int iat)
 {
   if (iat < nelup)
     Det_up->acceptMove(P, iat);
   else
     Det_dn->acceptMove(P, iat);
+  if (MultiDet)
+    MultiDet->acceptMove(P, iat);
 
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
@@ -268,6 +338,11 @@ void WaveFunction::evaluateGL(ParticleSet& P)
   Det_up->evaluateGL(P, P.G, P.L);
   Det_dn->evaluateGL(P, P.G, P.L);
   LogValue = Det_up->LogValue + Det_dn->LogValue;
+  if (MultiDet)
+  {
+    MultiDet->evaluateGL(P, P.G, P.L);
+    LogValue += MultiDet->LogValue;
+  }
 
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
@@ -287,6 +362,12 @@ void WaveFunction::evaluateRatios(VirtualParticleSet& VP, std::vector<valT>& rat
     Det_dn->evaluateRatios(VP, ratios);
 
   std::vector<valT> t(ratios.size());
+  if (MultiDet)
+  {
+    MultiDet->evaluateRatios(VP, t);
+    for (int j = 0; j < ratios.size(); ++j)
+      ratios[j] *= t[j];
+  }
   for (size_t i = 0; i < Jastrows.size(); i++)
   {
     jastrow_timers[i]->start();
@@ -302,7 +383,15 @@ void WaveFunction::flex_evaluateLog(const std::vector<WaveFunction*>& WF_list,
 {
   if (!WF_list[0]->FirstTime)
     return;
-  else if (P_list.size() > 1)
+  flex_recompute(WF_list, P_list);
+  for (int iw = 0; iw < P_list.size(); iw++)
+    WF_list[iw]->FirstTime = false;
+}
+
+void WaveFunction::flex_recompute(const std::vector<WaveFunction*>& WF_list,
+                                  const std::vector<ParticleSet*>& P_list) const
+{
+  if (P_list.size() > 1)
   {
     constexpr valT czero(0);
     const std::vector<ParticleSet::ParticleGradient_t*> G_list(extract_G_list(P_list));
@@ -323,6 +412,13 @@ void WaveFunction::flex_evaluateLog(const std::vector<WaveFunction*>& WF_list,
     Det_dn->multi_evaluateLog(dn_list, P_list, G_list, L_list, LogValues);
     for (int iw = 0; iw < P_list.size(); iw++)
       WF_list[iw]->LogValue += LogValues[iw];
+    if (MultiDet)
+    {
+      std::vector<WaveFunctionComponent*> multidet_list(extract_multidet_list(WF_list));
+      MultiDet->multi_evaluateLog(multidet_list, P_list, G_list, L_list, LogValues);
+      for (int iw = 0; iw < P_list.size(); iw++)
+        WF_list[iw]->LogValue += LogValues[iw];
+    }
     // Jastrow factors
     for (size_t i = 0; i < Jastrows.size(); i++)
     {
@@ -333,11 +429,9 @@ void WaveFunction::flex_evaluateLog(const std::vector<WaveFunction*>& WF_list,
         WF_list[iw]->LogValue += LogValues[iw];
       jastrow_timers[i]->stop();
     }
-    for (int iw = 0; iw < P_list.size(); iw++)
-      WF_list[iw]->FirstTime = false;
   }
   else if(P_list.size()==1)
-    WF_list[0]->evaluateLog(*P_list[0]);
+    WF_list[0]->recompute(*P_list[0]);
 }
 
 void WaveFunction::flex_evalGrad(const std::vector<WaveFunction*>& WF_list,
@@ -360,6 +454,13 @@ void WaveFunction::flex_evalGrad(const std::vector<WaveFunction*>& WF_list,
     }
     for (int iw = 0; iw < P_list.size(); iw++)
       grad_now[iw] = grad_now_det[iw];
+    if (MultiDet)
+    {
+      std::vector<WaveFunctionComponent*> multidet_list(extract_multidet_list(WF_list));
+      MultiDet->multi_evalGrad(multidet_list, P_list, iat, grad_now_det);
+      for (int iw = 0; iw < P_list.size(); iw++)
+        grad_now[iw] += grad_now_det[iw];
+    }
 
     for (size_t i = 0; i < Jastrows.size(); i++)
     {
@@ -399,6 +500,13 @@ void WaveFunction::flex_ratioGrad(const std::vector<WaveFunction*>& WF_list,
     }
     for (int iw = 0; iw < P_list.size(); iw++)
       ratios[iw] = ratios_det[iw];
+    if (MultiDet)
+    {
+      std::vector<WaveFunctionComponent*> multidet_list(extract_multidet_list(WF_list));
+      MultiDet->multi_ratioGrad(multidet_list, P_list, iat, ratios_det, grad_new);
+      for (int iw = 0; iw < P_list.size(); iw++)
+        ratios[iw] *= ratios_det[iw];
+    }
 
     for (size_t i = 0; i < Jastrows.size(); i++)
     {
@@ -432,6 +540,11 @@ void WaveFunction::flex_acceptrestoreMove(const std::vector<WaveFunction*>& WF_l
       std::vector<WaveFunctionComponent*> dn_list(extract_dn_list(WF_list));
       Det_dn->multi_acceptrestoreMove(dn_list, P_list, isAccepted, iat);
     }
+    if (MultiDet)
+    {
+      std::vector<WaveFunctionComponent*> multidet_list(extract_multidet_list(WF_list));
+      MultiDet->multi_acceptrestoreMove(multidet_list, P_list, isAccepted, iat);
+    }
 
     for (size_t i = 0; i < Jastrows.size(); i++)
     {
@@ -470,6 +583,13 @@ void WaveFunction::flex_evaluateGL(const std::vector<WaveFunction*>& WF_list,
     Det_dn->multi_evaluateGL(dn_list, P_list, G_list, L_list);
     for (int iw = 0; iw < P_list.size(); iw++)
       WF_list[iw]->LogValue += dn_list[iw]->LogValue;
+    if (MultiDet)
+    {
+      std::vector<WaveFunctionComponent*> multidet_list(extract_multidet_list(WF_list));
+      MultiDet->multi_evaluateGL(multidet_list, P_list, G_list, L_list);
+      for (int iw = 0; iw < P_list.size(); iw++)
+        WF_list[iw]->LogValue += multidet_list[iw]->LogValue;
+    }
     // Jastrow factors
     for (size_t i = 0; i < Jastrows.size(); i++)
     {
@@ -514,6 +634,25 @@ const std::vector<WaveFunctionComponent*> WaveFunction::extract_dn_list(const st
   return dn_list;
 }
 
+void WaveFunction::getRecomputeStats(RecomputeStats& stats) const
+{
+  for (auto det : {Det_up, Det_dn})
+  {
+    auto* dirac_det = dynamic_cast<const DiracDeterminant<>*>(det);
+    if (dirac_det)
+      stats.add(dirac_det->getRecomputeStats());
+  }
+}
+
+const std::vector<WaveFunctionComponent*>
+    WaveFunction::extract_multidet_list(const std::vector<WaveFunction*>& WF_list) const
+{
+  std::vector<WaveFunctionComponent*> multidet_list;
+  for (auto it = WF_list.begin(); it != WF_list.end(); it++)
+    multidet_list.push_back((*it)->MultiDet);
+  return multidet_list;
+}
+
 const std::vector<WaveFunctionComponent*>
     WaveFunction::extract_jas_list(const std::vector<WaveFunction*>& WF_list, int jas_id) const
 {
@@ -29,6 +29,7 @@
 #include <Particle/VirtualParticleSet.h>
 #include <QMCWaveFunctions/SPOSet_builder.h>
 #include <QMCWaveFunctions/WaveFunctionComponent.h>
+#include <QMCWaveFunctions/DeterminantHelper.h>
 
 namespace qmcplusplus
 {
@@ -45,6 +46,8 @@ private:
   /// Slater determinants
   WaveFunctionComponent* Det_up;
   WaveFunctionComponent* Det_dn;
+  /// multi determinant expansion over excitations of Det_up and Det_dn, nullptr if none
+  WaveFunctionComponent* MultiDet;
   /// Jastrow factors
   std::vector<WaveFunctionComponent*> Jastrows;
   valT LogValue;
@@ -61,9 +64,15 @@ public:
 
   /// operates on a single walker
   void evaluateLog(ParticleSet& P);
+  /// compute everything from scratch, evaluateLog only does it the first time
+  void recompute(ParticleSet& P);
+  /// exchange the components and the values with other, built for the same particles
+  void swap(WaveFunction& other);
   posT evalGrad(ParticleSet& P, int iat);
   valT ratioGrad(ParticleSet& P, int iat, posT& grad);
   valT ratio(ParticleSet& P, int iat);
+  /// hint that iat will be moved to newpos next, see WaveFunctionComponent::prefetch
+  void prefetch(int iat, const posT& newpos);
   void acceptMove(ParticleSet& P, int iat);
   void restore(int iat);
   void completeUpdates();
@@ -76,6 +85,8 @@ public:
   /// operates on multiple walkers
   void flex_evaluateLog(const std::vector<WaveFunction*>& WF_list,
                          const std::vector<ParticleSet*>& P_list) const;
+  void flex_recompute(const std::vector<WaveFunction*>& WF_list,
+                      const std::vector<ParticleSet*>& P_list) const;
   void flex_evalGrad(const std::vector<WaveFunction*>& WF_list,
                       const std::vector<ParticleSet*>& P_list,
                       int iat,
@@ -98,6 +109,8 @@ public:
   // others
   int get_ei_TableID() const { return ei_TableID; }
   valT getLogValue() const { return LogValue; }
+  /// add the recompute statistics of the determinants, none for the reference implementation
+  void getRecomputeStats(RecomputeStats& stats) const;
   void setupTimers();
 
   // friends
@@ -108,11 +121,19 @@ public:
                                  ParticleSet& els,
                                  const RandomGenerator<QMCTraits::RealType>& RNG,
                                  int delay_rank,
-                                 bool enableJ3);
+                                 bool enableJ3,
+                                 int team_size,
+                                 bool adaptive_delay,
+                                 InverseMethod inverse,
+                                 const SPOSet* spo_virtual,
+                                 int num_dets,
+                                 const RecomputePolicy& recompute);
   const std::vector<WaveFunctionComponent*>
       extract_up_list(const std::vector<WaveFunction*>& WF_list) const;
   const std::vector<WaveFunctionComponent*>
       extract_dn_list(const std::vector<WaveFunction*>& WF_list) const;
+  const std::vector<WaveFunctionComponent*>
+      extract_multidet_list(const std::vector<WaveFunction*>& WF_list) const;
   const std::vector<WaveFunctionComponent*>
       extract_jas_list(const std::vector<WaveFunction*>& WF_list, int jas_id) const;
 };
@@ -124,7 +145,16 @@ void build_WaveFunction(bool useRef,
                         ParticleSet& els,
                         const RandomGenerator<QMCTraits::RealType>& RNG,
                         int delay_rank,
-                        bool enableJ3);
+                        bool enableJ3,
+                        int team_size                    = 1,
+                        bool adaptive_delay              = false,
+                        InverseMethod inverse            = InverseMethod::lapack,
+                        const SPOSet* spo_virtual        = nullptr,
+                        int num_dets                     = 1,
+                        const RecomputePolicy& recompute = RecomputePolicy());
+
+/// parse the name of an InverseMethod, lapack, mixed or native, return false if unknown
+bool getInverseMethod(const std::string& name, InverseMethod& method);
 } // namespace qmcplusplus
 
 #endif
@@ -174,6 +174,14 @@ struct WaveFunctionComponent : public QMCTraits
    */
   virtual void completeUpdates(){};
 
+  /** hint that the iat-th particle will be moved to newpos
+   * @param iat index of the particle
+   * @param newpos proposed position
+   *
+   * Only starts loading the data needed by the ratio at newpos. Does nothing by default.
+   */
+  virtual void prefetch(int iat, const PosType& newpos) {}
+
   /** evaluate ratios to evaluate the non-local PP
    * @param VP VirtualParticleSet
    * @param ratios ratios with new positions VP.R[k] the VP.refPtcl
@@ -21,21 +21,31 @@
 #define QMCPLUSPLUS_EINSPLINE_SPO_HPP
 #include <Utilities/Configuration.h>
 #include <Utilities/NewTimer.h>
+#include <Utilities/SharedMemorySegment.h>
+#include <Utilities/NumaNode.h>
 #include <Particle/ParticleSet.h>
 #include <Numerics/Spline2/BsplineAllocator.hpp>
+#include <Numerics/Spline2/BsplineIO.hpp>
 #include <Numerics/Spline2/MultiBspline.hpp>
+#include <Numerics/Spline2/MultiBsplineBrick.hpp>
+#include <Numerics/Spline2/MultiBsplineSIMD.hpp>
 #include <Utilities/SIMD/allocator.hpp>
 #include "Numerics/OhmmsPETE/OhmmsArray.h"
 #include "QMCWaveFunctions/SPOSet.h"
 #include <iostream>
+#include <memory>
 
 namespace qmcplusplus
 {
-template<typename T>
+/** einspline SPO set
+ * @tparam T evaluation precision
+ * @tparam CT storage type of the spline coefficients, T or a 16-bit type
+ */
+template<typename T, typename CT = T>
 struct einspline_spo : public SPOSet
 {
   /// define the einsplie data object type
-  using spline_type     = typename bspline_traits<T, 3>::SplineType;
+  using spline_type     = typename bspline_traits<CT, 3>::SplineType;
   using vContainer_type = aligned_vector<T>;
   using gContainer_type = VectorSoAContainer<T, 3>;
   using hContainer_type = VectorSoAContainer<T, 6>;
@@ -51,23 +61,38 @@ struct einspline_spo : public SPOSet
   int nSplines;
   /// number of splines per block
   int nSplinesPerBlock;
+  /// global index of the first orbital of the table, an input of the coefficient generator
+  int FirstOrbital;
   /// if true, responsible for cleaning up einsplines
   bool Owner;
   lattice_type Lattice;
   /// use allocator
-  BsplineAllocator<T> myAllocator;
+  BsplineAllocator<CT> myAllocator;
 
   aligned_vector<spline_type*> einsplines;
+  /// node-shared segment holding the coefficients, if any
+  std::unique_ptr<SharedMemorySegment> SharedCoefs;
+  /// mapped spline file holding the coefficients, if any
+  std::unique_ptr<spline2::MappedBsplineFile> MappedCoefs;
+  /// copies of einsplines indexed by NUMA node, empty for nodes without a copy
+  std::vector<aligned_vector<spline_type*>> NodeReplicas;
+  /// layout of the coefficients if they are stored in bricks, shared with the views
+  std::shared_ptr<const BrickLayout> Bricks;
+  /// instruction set of the spline kernels, must be supported by the cpu
+  SplineISA ISA;
   aligned_vector<vContainer_type> psi;
   aligned_vector<gContainer_type> grad;
   aligned_vector<hContainer_type> hess;
+  /// scratch of evaluateDetRatios, per virtual particle
+  std::vector<T> vp_x, vp_y, vp_z;
 
 
   /// Timer
   NewTimer* timer;
 
   /// default constructor
-  einspline_spo() : nBlocks(0), nSplines(0), firstBlock(0), lastBlock(0), Owner(false)
+  einspline_spo()
+      : nBlocks(0), nSplines(0), firstBlock(0), lastBlock(0), FirstOrbital(0), Owner(false), ISA(detectSplineISA())
   {
     timer = TimerManager.createTimer("Single-Particle Orbitals", timer_level_fine);
   }
@@ -82,19 +107,22 @@ struct einspline_spo : public SPOSet
    * @param member_id id of this member in a team
    *
    * Create a view of the big object. A simple blocking & padding  method.
+   * The blocks are split evenly, every member has one if there are at least team_size.
    */
-  einspline_spo(const einspline_spo& in, int team_size, int member_id) : Owner(false), Lattice(in.Lattice)
+  einspline_spo(const einspline_spo& in, int team_size, int member_id)
+      : FirstOrbital(in.FirstOrbital), Owner(false), Lattice(in.Lattice), Bricks(in.Bricks), ISA(in.ISA)
   {
     OrbitalSetSize   = in.OrbitalSetSize;
     nSplines         = in.nSplines;
     nSplinesPerBlock = in.nSplinesPerBlock;
-    nBlocks          = (in.nBlocks + team_size - 1) / team_size;
-    firstBlock       = nBlocks * member_id;
-    lastBlock        = std::min(in.nBlocks, nBlocks * (member_id + 1));
+    firstBlock       = in.nBlocks * member_id / team_size;
+    lastBlock        = in.nBlocks * (member_id + 1) / team_size;
     nBlocks          = lastBlock - firstBlock;
     einsplines.resize(nBlocks);
+    // the view is created by the thread using it
+    const aligned_vector<spline_type*>& source = in.local_replica();
     for (int i = 0, t = firstBlock; i < nBlocks; ++i, ++t)
-      einsplines[i] = in.einsplines[t];
+      einsplines[i] = source[t];
     resize();
     timer = TimerManager.createTimer("Single-Particle Orbitals", timer_level_fine);
   }
@@ -103,8 +131,22 @@ struct einspline_spo : public SPOSet
   ~einspline_spo()
   {
     if (Owner)
-      for (int i = 0; i < nBlocks; ++i)
-        myAllocator.destroy(einsplines[i]);
+    {
+      // einsplines is one of the replicas
+      for (auto& replica : NodeReplicas)
+        for (auto* spline : replica)
+          myAllocator.destroy(spline);
+      if (NodeReplicas.empty())
+      {
+        for (int i = 0; i < nBlocks; ++i)
+        {
+          if (SharedCoefs || MappedCoefs)
+            delete einsplines[i];
+          else
+            myAllocator.destroy(einsplines[i]);
+        }
+      }
+    }
   }
 
   /// resize the containers
@@ -122,42 +164,222 @@ struct einspline_spo : public SPOSet
   }
 
   // fix for general num_splines
-  void set(int nx, int ny, int nz, int num_splines, int nblocks, bool init_random = true)
+  void set(int nx,
+           int ny,
+           int nz,
+           int num_splines,
+           int nblocks,
+           bool init_random   = true,
+           FirstTouch policy = FirstTouch::block,
+           int first_orbital = 0)
   {
-    // setting OrbitalSetSize to num_splines made artificial only in miniQMC
-    OrbitalSetSize   = num_splines;
-
-    nSplines         = num_splines;
-    nBlocks          = nblocks;
-    nSplinesPerBlock = num_splines / nblocks;
-    firstBlock       = 0;
-    lastBlock        = nBlocks;
+    set_sizes(num_splines, nblocks);
     if (einsplines.empty())
     {
-      Owner = true;
-      TinyVector<int, 3> ng(nx, ny, nz);
-      PosType start(0);
-      PosType end(1);
+      Owner        = true;
+      FirstOrbital = first_orbital;
       einsplines.resize(nBlocks);
-      RandomGenerator<T> myrandom(11);
-      Array<T, 3> coef_data(nx + 3, ny + 3, nz + 3);
       for (int i = 0; i < nBlocks; ++i)
+        einsplines[i] = create_spline(nx, ny, nz, true);
+      if (init_random)
+        set_random_coefficients(policy, first_orbital);
+    }
+    resize();
+  }
+
+  /** same as set but the coefficients live in a segment shared by the processes of a node
+   * @param comm communicator of the processes sharing the segment
+   * @param name name of the segment
+   *
+   * Only the process creating the segment generates the coefficients.
+   */
+  void set_shared(Communicate& comm,
+                  const std::string& name,
+                  int nx,
+                  int ny,
+                  int nz,
+                  int num_splines,
+                  int nblocks,
+                  bool init_random   = true,
+                  FirstTouch policy = FirstTouch::block,
+                  int first_orbital = 0)
+  {
+    set_sizes(num_splines, nblocks);
+    Owner        = true;
+    FirstOrbital = first_orbital;
+    einsplines.resize(nBlocks);
+    // headers are private, the coefficients of all the blocks are packed in the segment
+    std::vector<size_t> offsets(nBlocks);
+    size_t segment_bytes = 0;
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      einsplines[i] = create_spline(nx, ny, nz, false);
+      offsets[i]    = segment_bytes;
+      segment_bytes += (einsplines[i]->coefs_size * sizeof(CT) + QMC_CLINE - 1) / QMC_CLINE * QMC_CLINE;
+    }
+    SharedCoefs.reset(new SharedMemorySegment(comm, name, segment_bytes));
+    for (int i = 0; i < nBlocks; ++i)
+      einsplines[i]->coefs = reinterpret_cast<CT*>(static_cast<char*>(SharedCoefs->data()) + offsets[i]);
+    if (SharedCoefs->isCreator() && init_random)
+      set_random_coefficients(policy, first_orbital);
+    SharedCoefs->publish();
+    resize();
+  }
+
+  /** same as set but the coefficients are mapped from a file written by write
+   * @return false and leave the object unset if the file is missing or holds another table
+   */
+  bool load(const std::string& fname, int nx, int ny, int nz, int num_splines, int nblocks, int first_orbital = 0)
+  {
+    std::unique_ptr<spline2::MappedBsplineFile> mapped(new spline2::MappedBsplineFile);
+    if (!mapped->open(fname))
+      return false;
+    set_sizes(num_splines, nblocks);
+    std::vector<spline_type*> splines(nBlocks);
+    for (int i = 0; i < nBlocks; ++i)
+      splines[i] = create_spline(nx, ny, nz, false);
+    if (!mapped->matches(*splines[0], nBlocks, generator(first_orbital)))
+    {
+      for (int i = 0; i < nBlocks; ++i)
+        delete splines[i];
+      return false;
+    }
+    Owner        = true;
+    FirstOrbital = first_orbital;
+    einsplines.assign(splines.begin(), splines.end());
+    for (int i = 0; i < nBlocks; ++i)
+      einsplines[i]->coefs = mapped->template block<CT>(i);
+    MappedCoefs = std::move(mapped);
+    resize();
+    return true;
+  }
+
+  /// write all the blocks to a file for load
+  bool write(const std::string& fname) const
+  {
+    return spline2::writeMultiBsplines(fname, einsplines.data(), nBlocks, generator(FirstOrbital));
+  }
+
+  /** make a copy of the table on every NUMA node running OpenMP threads
+   * @return the number of copies, 0 if the threads run on a single node
+   *         or the table is shared between processes
+   *
+   * Each copy is first touched by the threads of its node. The original
+   * table is released and the owner keeps the copy of the master thread.
+   * Views pick the copy of the node running the thread creating them.
+   * Requires bound threads.
+   */
+  int replicate_per_numa_node()
+  {
+    const int nthreads = omp_get_max_threads();
+    std::vector<int> thread_node(nthreads);
+#pragma omp parallel
+    thread_node[omp_get_thread_num()] = getCurrentNumaNode();
+
+    std::vector<int> node_threads(*std::max_element(thread_node.begin(), thread_node.end()) + 1, 0);
+    for (int node : thread_node)
+      node_threads[node]++;
+    const int num_replicas = std::count_if(node_threads.begin(), node_threads.end(), [](int n) { return n > 0; });
+    // private copies would undo the sharing of the segment
+    if (num_replicas < 2 || !NodeReplicas.empty() || SharedCoefs)
+      return 0;
+
+    NodeReplicas.resize(node_threads.size());
+    for (int node = 0; node < node_threads.size(); ++node)
+      if (node_threads[node] > 0)
       {
-        einsplines[i] = myAllocator.createMultiBspline(T(0), start, end, ng, PERIODIC, nSplinesPerBlock);
-        if (init_random)
+        NodeReplicas[node].resize(nBlocks);
+        for (int i = 0; i < nBlocks; ++i)
         {
-          for (int j = 0; j < nSplinesPerBlock; ++j)
-          {
-            // Generate different coefficients for each orbital
-            myrandom.generate_uniform(coef_data.data(), coef_data.size());
-            myAllocator.setCoefficientsForOneOrbital(j, coef_data, einsplines[i]);
-          }
+          NodeReplicas[node][i] = create_spline(einsplines[i]->x_grid.num, einsplines[i]->y_grid.num,
+                                                einsplines[i]->z_grid.num, false);
+          myAllocator.reallocateCoefs(NodeReplicas[node][i], einsplines[i]->coefs_size);
         }
       }
+
+#pragma omp parallel
+    {
+      const int tid  = omp_get_thread_num();
+      const int node = thread_node[tid];
+      // rank among the threads of the node
+      const int rank = std::count(thread_node.begin(), thread_node.begin() + tid, node);
+      for (int i = 0; i < nBlocks; ++i)
+      {
+        const size_t n     = einsplines[i]->coefs_size;
+        const size_t chunk = (n + node_threads[node] - 1) / node_threads[node];
+        const size_t first = std::min(n, rank * chunk);
+        const size_t last  = std::min(n, first + chunk);
+        std::copy(einsplines[i]->coefs + first, einsplines[i]->coefs + last, NodeReplicas[node][i]->coefs + first);
+      }
     }
-    resize();
+
+    for (int i = 0; i < nBlocks; ++i)
+      if (SharedCoefs || MappedCoefs)
+        delete einsplines[i];
+      else
+        myAllocator.destroy(einsplines[i]);
+    SharedCoefs.reset();
+    MappedCoefs.reset();
+    einsplines = NodeReplicas[thread_node[0]];
+    return num_replicas;
+  }
+
+  /// the copy of the table closest to the calling thread
+  const aligned_vector<spline_type*>& local_replica() const
+  {
+    const int node = getCurrentNumaNode();
+    if (node < NodeReplicas.size() && !NodeReplicas[node].empty())
+      return NodeReplicas[node];
+    return einsplines;
+  }
+
+  /** reorder the coefficients in Morton-ordered bricks, see BrickLayout
+   * @return false if the coefficients are shared or mapped from a file and cannot be reordered
+   */
+  bool to_bricks()
+  {
+    if (Bricks || SharedCoefs || MappedCoefs || !NodeReplicas.empty())
+      return false;
+    const spline_type& plain = *einsplines[0];
+    const int Nx             = plain.x_grid.num + 3;
+    const int Ny             = plain.y_grid.num + 3;
+    const int Nz             = plain.z_grid.num + 3;
+    const intptr_t xs = plain.x_stride, ys = plain.y_stride, zs = plain.z_stride;
+    std::shared_ptr<BrickLayout> layout(new BrickLayout(Nx, Ny, Nz, zs));
+    const int bs      = BrickLayout::brick_size;
+    const int nbricks = layout->nbx * layout->nby * layout->nbz;
+    // the brick at each position along the curve
+    std::vector<int> curve(nbricks);
+    for (int b = 0; b < nbricks; b++)
+      curve[layout->brick_rank[b]] = b;
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      spline_type* bricked = create_spline(plain.x_grid.num, plain.y_grid.num, plain.z_grid.num, false);
+      myAllocator.reallocateCoefs(bricked, layout->coefs_size);
+      // the bricks are copied along the curve, each thread first touches a contiguous range of the table
+#pragma omp parallel for schedule(static)
+      for (int r = 0; r < nbricks; r++)
+      {
+        const int b  = curve[r];
+        const int bx = b / (layout->nby * layout->nbz);
+        const int by = (b / layout->nbz) % layout->nby;
+        const int bz = b % layout->nbz;
+        for (int ix = bx * bs; ix < std::min(Nx, (bx + 1) * bs); ix++)
+          for (int iy = by * bs; iy < std::min(Ny, (by + 1) * bs); iy++)
+            for (int iz = bz * bs; iz < std::min(Nz, (bz + 1) * bs); iz++)
+              std::copy_n(einsplines[i]->coefs + ix * xs + iy * ys + iz * zs, zs,
+                          bricked->coefs + layout->offset(ix, iy, iz));
+      }
+      myAllocator.destroy(einsplines[i]);
+      einsplines[i] = bricked;
+    }
+    Bricks = layout;
+    return true;
   }
 
+  /// true if the coefficients are mapped from a file
+  bool isMapped() const { return static_cast<bool>(MappedCoefs); }
+
   /** evaluate psi */
   inline void evaluate_v(const ParticleSet& P, int iat)
   {
@@ -165,7 +387,10 @@ struct einspline_spo : public SPOSet
 
     auto u = Lattice.toUnit_floor(P.activeR(iat));
     for (int i = 0; i < nBlocks; ++i)
-      MultiBsplineEval::evaluate_v(einsplines[i], u[0], u[1], u[2], psi[i].data(), nSplinesPerBlock);
+      if (Bricks)
+        MultiBsplineEval::evaluate_v(einsplines[i], *Bricks, u[0], u[1], u[2], psi[i].data(), nSplinesPerBlock);
+      else
+        MultiBsplineEval::evaluate_v(ISA, einsplines[i], u[0], u[1], u[2], psi[i].data(), nSplinesPerBlock);
   }
 
   inline void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v)
@@ -175,20 +400,165 @@ struct einspline_spo : public SPOSet
     for (int i = 0; i < nBlocks; ++i)
     {
       // in real simulation, phase needs to be applied. Here just fake computation
-      const int first = i*nBlocks;
-      std::copy_n(psi[i].data(), std::min((i+1)*nSplinesPerBlock, OrbitalSetSize) - first, psi_v.data()+first);
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      std::copy_n(psi[i].data(), std::min(first + nSplinesPerBlock, OrbitalSetSize) - first, psi_v.data() + first);
+    }
+  }
+
+  /// prefetch the stencils of all the blocks at r, the brick layout is not prefetched
+  void prefetch(const PosType& r) const override
+  {
+    if (Bricks)
+      return;
+    auto u = Lattice.toUnit_floor(r);
+    for (int i = 0; i < nBlocks; ++i)
+      MultiBsplineEval::prefetch_stencil(einsplines[i], u[0], u[1], u[2]);
+  }
+
+  /** evaluate the determinant ratio without storing the values, psi is not filled
+   *
+   * A view only accumulates the ratio over its own blocks.
+   */
+  ValueType evaluateDetRatio(const ParticleSet& P, int iat, ValueVector_t& psi_v, const ValueVector_t& psiinv) override
+  {
+    // the fused kernel only handles the plain layout
+    if (Bricks)
+    {
+      evaluate_v(P, iat);
+      return dot_blocks(psiinv);
+    }
+
+    ScopedTimer local_timer(timer);
+
+    auto u          = Lattice.toUnit_floor(P.activeR(iat));
+    ValueType ratio = ValueType();
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      const int n     = std::min(first + nSplinesPerBlock, OrbitalSetSize) - first;
+      ratio += MultiBsplineEval::evaluate_v_dot(ISA, einsplines[i], u[0], u[1], u[2], psiinv.data() + first, n);
+    }
+    return ratio;
+  }
+
+  /// dot product of the values of the blocks with the matching parts of psiinv
+  ValueType dot_blocks(const ValueVector_t& psiinv) const
+  {
+    ValueType ratio = ValueType();
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      const int n     = std::min(first + nSplinesPerBlock, OrbitalSetSize) - first;
+      ratio += simd::dot(psi[i].data(), psiinv.data() + first, n);
     }
+    return ratio;
   }
 
-  /** evaluate psi, grad and lap */
+  /** evaluate determinant ratios at all the positions of a virtual particle set
+   *
+   * Each spline block is evaluated at all the positions in a single
+   * MultiBsplineEval::mw_evaluate_v_dot call instead of one position at a time,
+   * the values are not stored. A view only accumulates the ratios over its own blocks.
+   */
+  void evaluateDetRatios(const VirtualParticleSet& VP,
+                         ValueVector_t& psi_v,
+                         const ValueVector_t& psiinv,
+                         std::vector<ValueType>& ratios) override
+  {
+    // the batched kernel only handles the plain layout
+    if (Bricks)
+    {
+      for (int iat = 0; iat < VP.getTotalNum(); ++iat)
+      {
+        evaluate_v(VP, iat);
+        ratios[iat] = dot_blocks(psiinv);
+      }
+      return;
+    }
+
+    ScopedTimer local_timer(timer);
+
+    const int nVP = VP.getTotalNum();
+    vp_x.resize(nVP);
+    vp_y.resize(nVP);
+    vp_z.resize(nVP);
+    for (int iat = 0; iat < nVP; ++iat)
+    {
+      auto u      = Lattice.toUnit_floor(VP.activeR(iat));
+      vp_x[iat]   = u[0];
+      vp_y[iat]   = u[1];
+      vp_z[iat]   = u[2];
+      ratios[iat] = ValueType();
+    }
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      const int n     = std::min(first + nSplinesPerBlock, OrbitalSetSize) - first;
+      MultiBsplineEval::mw_evaluate_v_dot(einsplines[i], vp_x.data(), vp_y.data(), vp_z.data(),
+                                          psiinv.data() + first, ratios.data(), n, nVP);
+    }
+  }
+
+  /** evaluate psi, grad and lap, the laplacians are left in hess[i].data(0) */
   inline void evaluate_vgl(const ParticleSet& P, int iat)
   {
     auto u = Lattice.toUnit_floor(P.activeR(iat));
     for (int i = 0; i < nBlocks; ++i)
-      MultiBsplineEval::evaluate_vgl(einsplines[i], u[0], u[1], u[2], psi[i].data(), grad[i].data(), hess[i].data(),
-                                     nSplinesPerBlock);
+      evaluate_vgl_block(i, u, psi[i].data(), grad[i].data(), hess[i].data(), grad[i].capacity());
   }
 
+  /// evaluate psi, grad and lap of block i at the unit position u
+  inline void evaluate_vgl_block(int i, const PosType& u, T* vals, T* grads, T* lapl, size_t out_offset)
+  {
+    if (Bricks)
+      MultiBsplineEval::evaluate_vgl(einsplines[i], *Bricks, u[0], u[1], u[2], vals, grads, lapl, nSplinesPerBlock,
+                                     out_offset);
+    else
+      MultiBsplineEval::evaluate_vgl(ISA, einsplines[i], u[0], u[1], u[2], vals, grads, lapl, nSplinesPerBlock,
+                                     out_offset);
+  }
+
+  /** evaluate psi, grad and lap directly in the caller buffers
+   *
+   * A block is written in place if its rows are aligned as required by
+   * MultiBsplineEval::evaluate_vgl, otherwise it goes through the block
+   * containers and is copied.
+   */
+  void evaluateVGL(const ParticleSet& P,
+                   int iat,
+                   ValueVector_t& psi_v,
+                   GradVectorSoA_t& dpsi_v,
+                   ValueVector_t& d2psi_v) override
+  {
+    ScopedTimer local_timer(timer);
+
+    auto u                  = Lattice.toUnit_floor(P.activeR(iat));
+    const size_t out_offset = dpsi_v.capacity();
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      const int n     = std::min(first + nSplinesPerBlock, OrbitalSetSize) - first;
+      T* vals         = psi_v.data() + first;
+      T* grads        = dpsi_v.data() + first;
+      T* lapl         = d2psi_v.data() + first;
+      if (n == nSplinesPerBlock && isAligned(vals) && isAligned(grads) && isAligned(lapl) &&
+          isAligned(grads + out_offset))
+        evaluate_vgl_block(i, u, vals, grads, lapl, out_offset);
+      else
+      {
+        evaluate_vgl_block(i, u, psi[i].data(), grad[i].data(), hess[i].data(), grad[i].capacity());
+        std::copy_n(psi[i].data(), n, vals);
+        for (int d = 0; d < 3; d++)
+          std::copy_n(grad[i].data(d), n, grads + d * out_offset);
+        std::copy_n(hess[i].data(), n, lapl);
+      }
+    }
+  }
+
+  /// true if p is aligned for the spline kernels
+  static bool isAligned(const T* p) { return reinterpret_cast<uintptr_t>(p) % QMC_CLINE == 0; }
+
   /** evaluate psi, grad and hess */
   inline void evaluate_vgh(const ParticleSet& P, int iat)
   {
@@ -196,27 +566,176 @@ struct einspline_spo : public SPOSet
 
     auto u = Lattice.toUnit_floor(P.activeR(iat));
     for (int i = 0; i < nBlocks; ++i)
-      MultiBsplineEval::evaluate_vgh(einsplines[i], u[0], u[1], u[2], psi[i].data(), grad[i].data(), hess[i].data(),
-                                     nSplinesPerBlock);
+      if (Bricks)
+        MultiBsplineEval::evaluate_vgh(einsplines[i], *Bricks, u[0], u[1], u[2], psi[i].data(), grad[i].data(),
+                                       hess[i].data(), nSplinesPerBlock);
+      else
+        MultiBsplineEval::evaluate_vgh(ISA, einsplines[i], u[0], u[1], u[2], psi[i].data(), grad[i].data(),
+                                       hess[i].data(), nSplinesPerBlock);
   }
 
-  inline void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v, GradVector_t& dpsi_v, ValueVector_t& d2psi_v)
+  /** evaluate psi, grad and hess of multiple walkers at once
+   * @param spo_list views of the same spline tables, one per walker
+   * @param P_list particle sets, one per walker
+   * @param iat active particle
+   *
+   * Results are left in the psi/grad/hess containers of each view.
+   * Each spline block is evaluated for all the walkers of a chunk in a single
+   * MultiBsplineEval::mw_evaluate_vgh call.
+   */
+  inline void multi_evaluate_vgh(const std::vector<SPOSet*>& spo_list, const std::vector<ParticleSet*>& P_list, int iat)
   {
-    evaluate_vgh(P, iat);
+    const int nw = spo_list.size();
+    std::vector<einspline_spo*> spos(nw);
+    bool shared_tables = true;
+    for (int iw = 0; iw < nw; iw++)
+    {
+      spos[iw] = static_cast<einspline_spo*>(spo_list[iw]);
+      shared_tables &= (spos[iw]->firstBlock == firstBlock && spos[iw]->nBlocks == nBlocks &&
+                        std::equal(einsplines.begin(), einsplines.end(), spos[iw]->einsplines.begin()));
+    }
+
+    // the batched kernel only handles the plain layout
+    if (!shared_tables || Bricks)
+    {
+#pragma omp parallel for
+      for (int iw = 0; iw < nw; iw++)
+        spos[iw]->evaluate_vgh(*P_list[iw], iat);
+      return;
+    }
+
+    ScopedTimer local_timer(timer);
+
+    std::vector<T> x(nw), y(nw), z(nw);
+    for (int iw = 0; iw < nw; iw++)
+    {
+      auto u = Lattice.toUnit_floor(P_list[iw]->activeR(iat));
+      x[iw]  = u[0];
+      y[iw]  = u[1];
+      z[iw]  = u[2];
+    }
+
+    // split walkers into chunks only when there are fewer blocks than threads
+    const int nchunks = std::max(1, std::min(nw, omp_get_max_threads() / std::max(nBlocks, 1)));
+
+#pragma omp parallel for collapse(2)
+    for (int i = 0; i < nBlocks; ++i)
+      for (int ic = 0; ic < nchunks; ++ic)
+      {
+        const int first = nw * ic / nchunks;
+        const int last  = nw * (ic + 1) / nchunks;
+        std::vector<T*> vals(last - first), grads(last - first), hesss(last - first);
+        for (int iw = first; iw < last; iw++)
+        {
+          vals[iw - first]  = spos[iw]->psi[i].data();
+          grads[iw - first] = spos[iw]->grad[i].data();
+          hesss[iw - first] = spos[iw]->hess[i].data();
+        }
+        MultiBsplineEval::mw_evaluate_vgh(einsplines[i], x.data() + first, y.data() + first, z.data() + first,
+                                          vals.data(), grads.data(), hesss.data(), nSplinesPerBlock, last - first);
+      }
+  }
 
+  /// copy psi, grad and the trace of hess of the blocks into the full orbital vectors
+  inline void copy_out(ValueVector_t& psi_v, GradVector_t& dpsi_v, ValueVector_t& d2psi_v) const
+  {
     for (int i = 0; i < nBlocks; ++i)
     {
       // in real simulation, phase needs to be applied. Here just fake computation
-      const int first = i*nBlocks;
-      for (int j = first; j < std::min((i+1)*nSplinesPerBlock, OrbitalSetSize); j++)
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      for (int j = first; j < std::min(first + nSplinesPerBlock, OrbitalSetSize); j++)
       {
-        psi_v[j] = psi[i][j-first];
-        dpsi_v[j] = grad[i][j-first];
-        d2psi_v[j] = hess[i].data(0)[j-first];
+        psi_v[j]   = psi[i][j - first];
+        dpsi_v[j]  = grad[i][j - first];
+        d2psi_v[j] = hess[i].data(0)[j - first] + hess[i].data(3)[j - first] + hess[i].data(5)[j - first];
       }
     }
   }
 
+  /// same as copy_out with the gradients in SoA
+  inline void copy_out(ValueVector_t& psi_v, GradVectorSoA_t& dpsi_v, ValueVector_t& d2psi_v) const
+  {
+    for (int i = 0; i < nBlocks; ++i)
+    {
+      const int first = (firstBlock + i) * nSplinesPerBlock;
+      const int n     = std::min(first + nSplinesPerBlock, OrbitalSetSize) - first;
+      std::copy_n(psi[i].data(), n, psi_v.data() + first);
+      for (int d = 0; d < 3; d++)
+        std::copy_n(grad[i].data(d), n, dpsi_v.data(d) + first);
+      const T* restrict hxx = hess[i].data(0);
+      const T* restrict hyy = hess[i].data(3);
+      const T* restrict hzz = hess[i].data(5);
+      for (int j = 0; j < n; j++)
+        d2psi_v[first + j] = hxx[j] + hyy[j] + hzz[j];
+    }
+  }
+
+  inline void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi_v, GradVector_t& dpsi_v, ValueVector_t& d2psi_v)
+  {
+    evaluate_vgh(P, iat);
+    copy_out(psi_v, dpsi_v, d2psi_v);
+  }
+
+  using SPOSet::multi_evaluate;
+
+  void multi_evaluate(const std::vector<SPOSet*>& spo_list, const std::vector<ParticleSet*>& P_list, int iat,
+                      std::vector<ValueVector_t*>& psi_v_list,
+                      std::vector<GradVector_t*>& dpsi_v_list,
+                      std::vector<ValueVector_t*>& d2psi_v_list)
+  {
+    multi_evaluate_vgh(spo_list, P_list, iat);
+#pragma omp parallel for
+    for (int iw = 0; iw < spo_list.size(); iw++)
+      static_cast<einspline_spo*>(spo_list[iw])->copy_out(*psi_v_list[iw], *dpsi_v_list[iw], *d2psi_v_list[iw]);
+  }
+
+  /// the batched kernel only computes hessians, the results are copied
+  void multi_evaluateVGL(const std::vector<SPOSet*>& spo_list, const std::vector<ParticleSet*>& P_list, int iat,
+                         std::vector<ValueVector_t*>& psi_v_list,
+                         std::vector<GradVectorSoA_t*>& dpsi_v_list,
+                         std::vector<ValueVector_t*>& d2psi_v_list) override
+  {
+    multi_evaluate_vgh(spo_list, P_list, iat);
+#pragma omp parallel for
+    for (int iw = 0; iw < spo_list.size(); iw++)
+      static_cast<einspline_spo*>(spo_list[iw])->copy_out(*psi_v_list[iw], *dpsi_v_list[iw], *d2psi_v_list[iw]);
+  }
+
+  /// set the number of splines and blocks
+  void set_sizes(int num_splines, int nblocks)
+  {
+    // setting OrbitalSetSize to num_splines made artificial only in miniQMC
+    OrbitalSetSize = num_splines;
+
+    nSplines         = num_splines;
+    nBlocks          = nblocks;
+    nSplinesPerBlock = num_splines / nblocks;
+    firstBlock       = 0;
+    lastBlock        = nBlocks;
+  }
+
+  /// create the spline of a block on the unit cube, allocating its coefficients if requested
+  spline_type* create_spline(int nx, int ny, int nz, bool allocate_coefs)
+  {
+    TinyVector<int, 3> ng(nx, ny, nz);
+    PosType start(0);
+    PosType end(1);
+    return myAllocator.createMultiBspline(CT(0), start, end, ng, PERIODIC, nSplinesPerBlock, allocate_coefs);
+  }
+
+  /// inputs of set_random_coefficients, stored in the spline files
+  static spline2::SplineFileGenerator generator(int first_orbital)
+  {
+    return spline2::SplineFileGenerator{11, first_orbital, spline2::spline_file_type_id<T>::value};
+  }
+
+  /// fill all the blocks with random coefficients, independent of the number of threads
+  void set_random_coefficients(FirstTouch policy, int first_orbital)
+  {
+    myAllocator.template setRandomCoefficients<T>(einsplines.data(), nBlocks, generator(first_orbital).seed, policy,
+                                                  first_orbital);
+  }
+
   void print(std::ostream& os)
   {
     os << "SPO nBlocks=" << nBlocks << " firstBlock=" << firstBlock << " lastBlock=" << lastBlock
@@ -140,21 +140,11 @@ struct einspline_spo_ref : public SPOSet
       PosType start(0);
       PosType end(1);
       einsplines.resize(nBlocks);
-      RandomGenerator<T> myrandom(11);
-      Array<T, 3> coef_data(nx + 3, ny + 3, nz + 3);
       for (int i = 0; i < nBlocks; ++i)
-      {
         einsplines[i] = myAllocator.createMultiBspline(T(0), start, end, ng, PERIODIC, nSplinesPerBlock);
-        if (init_random)
-        {
-          for (int j = 0; j < nSplinesPerBlock; ++j)
-          {
-            // Generate different coefficients for each orbital
-            myrandom.generate_uniform(coef_data.data(), coef_data.size());
-            myAllocator.setCoefficientsForOneOrbital(j, coef_data, einsplines[i]);
-          }
-        }
-      }
+      // Generate different coefficients for each orbital
+      if (init_random)
+        myAllocator.template setRandomCoefficients<T>(einsplines.data(), nBlocks, 11);
     }
     resize();
   }
@@ -213,7 +203,7 @@ struct einspline_spo_ref : public SPOSet
       {
         psi_v[j] = psi[i][j-first];
         dpsi_v[j] = grad[i][j-first];
-        d2psi_v[j] = hess[i].data(0)[j-first];
+        d2psi_v[j] = hess[i].data(0)[j-first] + hess[i].data(3)[j-first] + hess[i].data(5)[j-first];
       }
     }
   }
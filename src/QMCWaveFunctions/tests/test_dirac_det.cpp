@@ -13,6 +13,8 @@
 #include "catch.hpp"
 
 #include <stdio.h>
+#include <algorithm>
+#include <limits>
 #include <string>
 #include "QMCWaveFunctions/DiracDeterminant.h"
 
@@ -514,4 +516,118 @@ TEST_CASE("DiracDeterminant_delayed_update", "[wavefunction][fermion]")
   check_matrix(orig_a, ddc.psiM);
 }
 
+TEST_CASE("DiracDeterminant_recompute", "[wavefunction][fermion]")
+{
+  FakeSPO* spo = new FakeSPO();
+  const int norb = 4;
+  spo->setOrbitalSetSize(norb);
+  // recompute every second call, check the residual of all the rows in between
+  RecomputePolicy recompute;
+  recompute.period    = 2;
+  // above the round-off of the single precision inverse in the mixed builds
+  recompute.threshold = std::max(1e-8, 1000.0 * std::numeric_limits<RealType>::epsilon());
+  DetType ddc(spo, 0, 1, false, InverseMethod::lapack, recompute);
+  ddc.dpsiV.resize(norb);
+  ddc.d2psiV.resize(norb);
+
+  ParticleSet elec;
+  elec.create(4);
+  ddc.recompute(elec);
+
+  ParticleSet::GradType grad;
+  ddc.ratioGrad(elec, 0, grad);
+  ddc.acceptMove(elec, 0);
+  ddc.completeUpdates();
+
+  Matrix<ValueType> a_update1, scratchT;
+  a_update1 = spo->a2;
+  for (int j = 0; j < norb; j++)
+    a_update1(j, 0) = spo->v2(0, j);
+  DiracMatrix<ValueType> dm;
+  RealType logdet, phase;
+  scratchT.resize(norb, norb);
+  simd::transpose(a_update1.data(), a_update1.rows(), a_update1.cols(), scratchT.data(), scratchT.rows(),
+                  scratchT.cols());
+  dm.invert_transpose(scratchT, a_update1, logdet, phase);
+
+  ParticleSet::ParticleGradient_t G(norb);
+  ParticleSet::ParticleLaplacian_t L(norb);
+
+  // the updated inverse passes the check
+  ddc.evaluateGL(elec, G, L);
+  REQUIRE(ddc.getRecomputeStats().checks == 1);
+  REQUIRE(ddc.getRecomputeStats().triggered == 0);
+  REQUIRE(ddc.getRecomputeStats().max_residual < recompute.threshold);
+
+  // the scheduled recompute inverts the updated orbitals
+  ddc.evaluateGL(elec, G, L);
+  REQUIRE(ddc.getRecomputeStats().scheduled == 1);
+  check_matrix(a_update1, ddc.psiM);
+
+  // a corrupted inverse fails the check and is recomputed
+  ddc.psiM(1, 2) += 0.1;
+  ddc.evaluateGL(elec, G, L);
+  REQUIRE(ddc.getRecomputeStats().checks == 2);
+  REQUIRE(ddc.getRecomputeStats().triggered == 1);
+  check_matrix(a_update1, ddc.psiM);
+}
+
+TEST_CASE("DiracDeterminant_mw_delayed_update", "[wavefunction][fermion]")
+{
+  FakeSPO* spo = new FakeSPO();
+  const int norb = 4;
+  spo->setOrbitalSetSize(norb);
+  // maximum delay 2, three walkers with different numbers of delayed rows
+  DetType det0(spo, 0, 2), det1(spo, 0, 2), det2(spo, 0, 2);
+  std::vector<WaveFunctionComponent*> det_list{&det0, &det1, &det2};
+
+  ParticleSet elec0, elec1, elec2;
+  elec0.create(4);
+  elec1.create(4);
+  elec2.create(4);
+  std::vector<ParticleSet*> P_list{&elec0, &elec1, &elec2};
+  for (int iw = 0; iw < det_list.size(); iw++)
+  {
+    auto det = static_cast<DetType*>(det_list[iw]);
+    det->dpsiV.resize(norb);
+    det->d2psiV.resize(norb);
+    det->recompute(*P_list[iw]);
+  }
+
+  // expected matrices, columns 0 and 1 replaced for det0, column 1 for det1
+  Matrix<ValueType> a_det0, a_det1, a_det2, scratchT;
+  a_det0 = spo->a2;
+  a_det1 = spo->a2;
+  a_det2 = spo->a2;
+  for (int j = 0; j < norb; j++)
+  {
+    a_det0(j, 0) = spo->v2(0, j);
+    a_det0(j, 1) = spo->v2(1, j);
+    a_det1(j, 1) = spo->v2(1, j);
+  }
+
+  ParticleSet::GradType grad;
+  det0.ratioGrad(elec0, 0, grad);
+  det0.acceptMove(elec0, 0);
+
+  // det0 reaches the delay and is updated by the batch, det1 keeps one delayed row
+  for (int iw = 0; iw < det_list.size(); iw++)
+    det_list[iw]->ratioGrad(*P_list[iw], 1, grad);
+  det0.multi_acceptrestoreMove(det_list, P_list, {true, true, false}, 1);
+  det0.multi_completeUpdates(det_list);
+
+  DiracMatrix<ValueType> dm;
+  RealType logdet, phase;
+  scratchT.resize(norb, norb);
+  for (auto a : {&a_det0, &a_det1, &a_det2})
+  {
+    simd::transpose(a->data(), a->rows(), a->cols(), scratchT.data(), scratchT.rows(), scratchT.cols());
+    dm.invert_transpose(scratchT, *a, logdet, phase);
+  }
+
+  check_matrix(a_det0, det0.psiM);
+  check_matrix(a_det1, det1.psiM);
+  check_matrix(a_det2, det2.psiM);
+}
+
 } // namespace qmcplusplus
@@ -14,11 +14,13 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 
 #include "Numerics/OhmmsPETE/OhmmsMatrix.h"
 #include "QMCWaveFunctions/WaveFunctionComponent.h"
 #include "QMCWaveFunctions/DiracMatrix.h"
 #include "QMCWaveFunctions/DelayedUpdate.h"
+#include "Numerics/BatchedLU.h"
 
 using std::string;
 
@@ -106,6 +108,200 @@ TEST_CASE("DiracMatrix_inverse", "[wavefunction][fermion]")
   check_matrix(a_inv, b);
 }
 
+TEST_CASE("DiracMatrix_inverse_mixed", "[wavefunction][fermion]")
+{
+  using ValueType_FP = QMCTraits::QTFull::ValueType;
+  DiracMatrix<ValueType_FP, ValueType> dm, dm_mixed;
+  dm_mixed.setInverseMethod(InverseMethod::mixed);
+
+  const int n = 64;
+  Matrix<ValueType> a, a_inv, a_inv_mixed;
+  RealType LogValue, PhaseValue, LogValue_mixed, PhaseValue_mixed;
+  a.resize(n, n);
+  a_inv.resize(n, n);
+  a_inv_mixed.resize(n, n);
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      a(i, j) = std::sin(0.7 * i + 1.3 * j * j) + ((i == j) ? 2.0 : 0.0);
+
+  dm.invert_transpose(a, a_inv, LogValue, PhaseValue);
+  dm_mixed.invert_transpose(a, a_inv_mixed, LogValue_mixed, PhaseValue_mixed);
+
+  // the refinement brings the measured residual to refine_tol, about 1e-5 after the single precision LU,
+  // and log|det| to the full precision
+  const double tol = std::max(1e-10, 10.0 * std::numeric_limits<RealType>::epsilon());
+  REQUIRE(dm_mixed.getResidual() < 1e-10);
+  REQUIRE(LogValue_mixed == Approx(LogValue).epsilon(tol));
+  REQUIRE(PhaseValue_mixed == Approx(PhaseValue).epsilon(tol));
+  check_matrix(a_inv_mixed, a_inv);
+}
+
+TEST_CASE("DiracMatrix_inverse_native", "[wavefunction][fermion]")
+{
+  using ValueType_FP = QMCTraits::QTFull::ValueType;
+  DiracMatrix<ValueType_FP, ValueType> dm, dm_native;
+  dm_native.setInverseMethod(InverseMethod::native);
+
+  // not a multiple of the block size
+  const int n = 150;
+  Matrix<ValueType> a, a_inv, a_inv_native;
+  RealType LogValue, PhaseValue, LogValue_native, PhaseValue_native;
+  a.resize(n, n);
+  a_inv.resize(n, n);
+  a_inv_native.resize(n, n);
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      a(i, j) = std::cos(0.3 * i * j + 1.1 * j) + ((i == j + 1) ? 1.5 : 0.0);
+
+  dm.invert_transpose(a, a_inv, LogValue, PhaseValue);
+  dm_native.invert_transpose(a, a_inv_native, LogValue_native, PhaseValue_native);
+
+  REQUIRE(LogValue_native == Approx(LogValue));
+  REQUIRE(PhaseValue_native == Approx(PhaseValue));
+  check_matrix(a_inv_native, a_inv);
+}
+
+TEST_CASE("DelayedUpdate_mw_invert_transpose", "[wavefunction][fermion]")
+{
+  using ValueType_FP = QMCTraits::QTFull::ValueType;
+  DiracMatrix<ValueType_FP, ValueType> dm;
+
+  // fewer walkers than the lanes of BatchedLU, the pivots differ between the walkers
+  const int n = 12, nw = 5;
+  std::vector<DelayedUpdate<ValueType, ValueType_FP>> engines(nw);
+  std::vector<Matrix<ValueType>> a(nw), a_inv(nw), b(nw);
+  std::vector<DelayedUpdate<ValueType, ValueType_FP>*> engine_list;
+  std::vector<const Matrix<ValueType>*> a_list;
+  std::vector<Matrix<ValueType>*> inv_list;
+  for (int iw = 0; iw < nw; iw++)
+  {
+    engines[iw].resize(n, 1);
+    a[iw].resize(n, n);
+    a_inv[iw].resize(n, n);
+    b[iw].resize(n, n);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        a[iw](i, j) = std::sin(0.7 * i + 1.3 * j * j + iw) + ((i == (j + iw) % n) ? 2.0 : 0.0);
+    engine_list.push_back(&engines[iw]);
+    a_list.push_back(&a[iw]);
+    inv_list.push_back(&b[iw]);
+  }
+
+  std::vector<RealType> LogValues, PhaseValues;
+  DelayedUpdate<ValueType, ValueType_FP>::mw_invert_transpose(engine_list, a_list, inv_list, LogValues, PhaseValues);
+
+  for (int iw = 0; iw < nw; iw++)
+  {
+    RealType LogValue, PhaseValue;
+    dm.invert_transpose(a[iw], a_inv[iw], LogValue, PhaseValue);
+    REQUIRE(LogValues[iw] == Approx(LogValue));
+    REQUIRE(PhaseValues[iw] == Approx(PhaseValue));
+    check_matrix(b[iw], a_inv[iw]);
+  }
+}
+
+/// unit phase factor, 1 for the real types
+template<typename T>
+T make_phase(double theta)
+{
+  return T(1);
+}
+
+template<>
+std::complex<double> make_phase<std::complex<double>>(double theta)
+{
+  return std::polar(1.0, theta);
+}
+
+/** invert with BatchedLU a batch filling one group and part of another
+ *
+ * Each matrix is P L U with known diagonal of U, its determinant is the product
+ * of the diagonal times the sign of the permutation. The diagonal has negative
+ * or complex entries and the permutation differs between the matrices, so that
+ * the lanes pivot differently. Matrix 1 has a zero row.
+ */
+template<typename T>
+void test_batched_lu(double tol)
+{
+  using R     = typename scalar_traits<T>::real_type;
+  const int n = 7;
+  const int nb = BatchedLU::lanes<T>() + 3;
+  const int singular = 1;
+
+  std::vector<Matrix<T>> a(nb), ainv(nb);
+  std::vector<const T*> a_ptr(nb);
+  std::vector<T*> ainv_ptr(nb);
+  std::vector<R> logdet(nb), phase(nb), logdet_ref(nb), phase_ref(nb);
+  for (int b = 0; b < nb; b++)
+  {
+    Matrix<T> lu(n, n);
+    T det(1);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        if (i == j)
+        {
+          // |u| in [0.5, 2], the sign or phase changes with the matrix
+          const double mag = 0.5 + 1.5 * std::abs(std::sin(1.0 + i + 3.0 * b));
+          lu(i, i)         = T(mag) * (((i + b) % 3 == 0) ? -T(1) : T(1)) * make_phase<T>(0.3 * (i + b));
+          det *= lu(i, i);
+        }
+        else if (j > i)
+          lu(i, j) = T(std::cos(0.4 * i + 0.9 * j + b));
+        else
+          lu(i, j) = T(0);
+    // (L U)(i, j) with the unit lower part L(i, k) = sin(i + 2k + b) / 2, rows rotated by b
+    a[b].resize(n, n);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+      {
+        T sum = lu(i, j);
+        for (int k = 0; k < i; k++)
+          sum += T(0.5 * std::sin(i + 2.0 * k + b)) * lu(k, j);
+        a[b]((i + b) % n, j) = sum;
+      }
+    // the rotation by b is b (n - 1) transpositions
+    if ((b * (n - 1)) % 2 == 1)
+      det = -det;
+    logdet_ref[b] = std::log(std::abs(det));
+    phase_ref[b]  = std::arg(std::complex<double>(det)) < 0 ? std::arg(std::complex<double>(det)) + TWOPI
+                                                           : std::arg(std::complex<double>(det));
+    ainv[b].resize(n, n);
+    a_ptr[b]    = a[b].data();
+    ainv_ptr[b] = ainv[b].data();
+  }
+  for (int j = 0; j < n; j++)
+    a[singular](2, j) = T(0);
+
+  BatchedLU::invert_transpose<T>(n, a_ptr.data(), n, ainv_ptr.data(), n, logdet.data(), phase.data(), nb);
+
+  REQUIRE(logdet[singular] < std::log(std::numeric_limits<R>::min()));
+  for (int b = 0; b < nb; b++)
+  {
+    if (b == singular)
+      continue;
+    REQUIRE(logdet[b] == Approx(logdet_ref[b]).epsilon(tol));
+    // the phases near 0 and 2 pi are the same
+    REQUIRE(std::cos(phase[b] - phase_ref[b]) == Approx(1.0).epsilon(tol));
+    REQUIRE(phase[b] >= 0);
+    REQUIRE(phase[b] < TWOPI);
+    // A A^{-1} = I, ainv(j, k) = A^{-1}(k, j)
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+      {
+        T sum(0);
+        for (int k = 0; k < n; k++)
+          sum += a[b](i, k) * ainv[b](j, k);
+        REQUIRE(std::abs(sum - T(i == j)) < tol);
+      }
+  }
+}
+
+TEST_CASE("BatchedLU_invert_transpose", "[wavefunction][fermion]")
+{
+  test_batched_lu<double>(1e-10);
+  test_batched_lu<float>(1e-4);
+  test_batched_lu<std::complex<double>>(1e-10);
+}
 
 TEST_CASE("DiracMatrix_update_row", "[wavefunction][fermion]")
 {
@@ -161,5 +357,67 @@ TEST_CASE("DiracMatrix_update_row", "[wavefunction][fermion]")
   check_matrix(a_inv, b);
 }
 
+/** run windows of the tuner on synthetic timings
+ * @param cost seconds per accepted move at a delay
+ * @return the delays of the windows
+ */
+template<typename COST>
+std::vector<int> run_delay_windows(DelayRankTuner& tuner, int& delay, int windows, COST cost)
+{
+  std::vector<int> delays;
+  for (int w = 0; w < windows; w++)
+  {
+    delays.push_back(delay);
+    while (!tuner.windowDone(delay))
+    {
+      tuner.addTime(cost(delay));
+      tuner.addAccepted();
+    }
+    delay = tuner.update(delay);
+  }
+  return delays;
+}
+
+TEST_CASE("DelayRankTuner_synthetic", "[wavefunction][fermion]")
+{
+  DelayRankTuner tuner;
+  const int max_delay = 64;
+  tuner.reset(max_delay);
+  int delay = max_delay;
+
+  // the fastest delay is 16, 8 and 32 cost 25% more
+  auto cost16 = [](int k) { return 64.0 / k + k / 4.0; };
+  // a new delay is measured in its own window before its neighbors are probed
+  // from the maximum: step down to 32, probe 64 and 16, move to 16, probe 32 and 8, then hold
+  const std::vector<int> approach = {64, 32, 32, 64, 16, 16, 32, 8};
+  REQUIRE(run_delay_windows(tuner, delay, approach.size(), cost16) == approach);
+  REQUIRE(run_delay_windows(tuner, delay, 16, cost16) == std::vector<int>(16, 16));
+  // after the hold the neighbors are probed again and the optimum is kept
+  REQUIRE(run_delay_windows(tuner, delay, 3, cost16) == std::vector<int>({16, 32, 8}));
+  REQUIRE(delay == 16);
+
+  // gains within the tolerance of the noisy windows do not move the delay
+  auto flat = [](int k) { return k == 8 ? 0.99 : 1.0; };
+  run_delay_windows(tuner, delay, 16, flat);
+  REQUIRE(run_delay_windows(tuner, delay, 3, flat) == std::vector<int>({16, 32, 8}));
+  REQUIRE(delay == 16);
+
+  // the optimum moves down to 4, e.g. the acceptance dropped, and is followed one halving per probe
+  auto cost4 = [](int k) { return 16.0 / k + k; };
+  run_delay_windows(tuner, delay, 16, cost4);
+  const std::vector<int> follow = {16, 32, 8, 8, 16, 4, 4, 8, 2};
+  REQUIRE(run_delay_windows(tuner, delay, follow.size(), cost4) == follow);
+  REQUIRE(delay == 4);
+
+  // the probes are clamped to 1 and the maximum
+  tuner.reset(max_delay);
+  delay = 1;
+  auto cost1 = [](int k) { return double(k); };
+  REQUIRE(run_delay_windows(tuner, delay, 3, cost1) == std::vector<int>({1, 2, 1}));
+  tuner.reset(max_delay);
+  delay = max_delay;
+  auto cost64 = [](int k) { return 1.0 / k; };
+  REQUIRE(run_delay_windows(tuner, delay, 3, cost64) == std::vector<int>({64, 32, 64}));
+}
 
 } // namespace qmcplusplus
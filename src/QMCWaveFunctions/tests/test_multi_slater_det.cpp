@@ -0,0 +1,358 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+#include "Particle/VirtualParticleSet.h"
+#include "QMCWaveFunctions/MultiSlaterDeterminant.h"
+#include "Utilities/RandomGenerator.h"
+
+namespace qmcplusplus
+{
+typedef QMCTraits::RealType RealType;
+typedef QMCTraits::ValueType ValueType;
+typedef QMCTraits::PosType PosType;
+typedef QMCTraits::GradType GradType;
+// the brute force references are in the full precision also in the mixed builds
+typedef QMCTraits::QTFull::RealType FullRealType;
+typedef QMCTraits::QTFull::ValueType FullValueType;
+typedef QMCTraits::QTFull::PosType FullPosType;
+typedef DiracDeterminant<> DetType;
+
+/// gaussian orbitals exp(-a |r - c|^2) with analytic gradients and laplacians
+class GaussianSPO : public SPOSet
+{
+public:
+  std::vector<PosType> centers;
+  std::vector<RealType> exponents;
+
+  GaussianSPO(const std::vector<PosType>& c, const std::vector<RealType>& a) : centers(c), exponents(a)
+  {
+    className      = "GaussianSPO";
+    OrbitalSetSize = c.size();
+  }
+
+  ValueType value(const PosType& r, int k) const
+  {
+    const PosType dr = r - centers[k];
+    return std::exp(-exponents[k] * dot(dr, dr));
+  }
+
+  FullValueType valueFull(const FullPosType& r, int k) const
+  {
+    const FullPosType dr = r - FullPosType(centers[k]);
+    return std::exp(-static_cast<FullRealType>(exponents[k]) * dot(dr, dr));
+  }
+
+  void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi)
+  {
+    for (int k = 0; k < OrbitalSetSize; k++)
+      psi[k] = value(P.activeR(iat), k);
+  }
+
+  void evaluate(const ParticleSet& P, int iat, ValueVector_t& psi, GradVector_t& dpsi, ValueVector_t& d2psi)
+  {
+    for (int k = 0; k < OrbitalSetSize; k++)
+    {
+      const PosType dr = P.activeR(iat) - centers[k];
+      const RealType a = exponents[k];
+      psi[k]           = value(P.activeR(iat), k);
+      dpsi[k]          = -2 * a * psi[k] * dr;
+      d2psi[k]         = (4 * a * a * dot(dr, dr) - 6 * a) * psi[k];
+    }
+  }
+};
+
+/// determinant of the n x n matrix m by gaussian elimination
+FullValueType brute_force_det(std::vector<FullValueType> m, int n)
+{
+  FullValueType det(1);
+  for (int j = 0; j < n; j++)
+  {
+    int p = j;
+    for (int i = j + 1; i < n; i++)
+      if (std::abs(m[i * n + j]) > std::abs(m[p * n + j]))
+        p = i;
+    if (p != j)
+    {
+      for (int c = 0; c < n; c++)
+        std::swap(m[j * n + c], m[p * n + c]);
+      det = -det;
+    }
+    det *= m[j * n + j];
+    for (int i = j + 1; i < n; i++)
+    {
+      const FullValueType l = m[i * n + j] / m[j * n + j];
+      for (int c = j; c < n; c++)
+        m[i * n + c] -= l * m[j * n + c];
+    }
+  }
+  return det;
+}
+
+struct TestExcitation
+{
+  std::vector<int> occ;
+  std::vector<int> virt;
+};
+
+struct TestDeterminant
+{
+  ValueType c;
+  int exc_up;
+  int exc_dn;
+};
+
+/// the expansion summed over the full determinants of all the particles
+struct BruteForceExpansion
+{
+  const GaussianSPO& occ;
+  const GaussianSPO& virt;
+  const int nel;
+  std::vector<TestExcitation> excitations[2];
+  std::vector<TestDeterminant> dets;
+
+  BruteForceExpansion(const GaussianSPO& o, const GaussianSPO& v, int n) : occ(o), virt(v), nel(n) {}
+
+  FullValueType spinDet(const std::vector<FullPosType>& R, int spin, const TestExcitation& exc) const
+  {
+    std::vector<FullValueType> m(nel * nel);
+    for (int i = 0; i < nel; i++)
+      for (int j = 0; j < nel; j++)
+        m[i * nel + j] = occ.valueFull(R[spin * nel + i], j);
+    for (int a = 0; a < exc.occ.size(); a++)
+      for (int i = 0; i < nel; i++)
+        m[i * nel + exc.occ[a]] = virt.valueFull(R[spin * nel + i], exc.virt[a]);
+    return brute_force_det(m, nel);
+  }
+
+  FullValueType psi(const std::vector<FullPosType>& R) const
+  {
+    FullValueType psi(0);
+    for (const auto& det : dets)
+      psi += static_cast<FullValueType>(det.c) * spinDet(R, 0, excitations[0][det.exc_up]) *
+          spinDet(R, 1, excitations[1][det.exc_dn]);
+    return psi;
+  }
+
+  FullValueType operator()(const ParticleSet::ParticlePos_t& R) const
+  {
+    return psi(std::vector<FullPosType>(R.begin(), R.end()));
+  }
+
+  /// gradient and laplacian of log|psi| with respect to particle iat by finite differences
+  void gradLap(const ParticleSet::ParticlePos_t& R_in, int iat, GradType& grad, ValueType& lap) const
+  {
+    std::vector<FullPosType> R(R_in.begin(), R_in.end());
+    const FullRealType h    = 1.0e-4;
+    const FullRealType log0 = std::log(std::abs(psi(R)));
+    const FullPosType r0    = R[iat];
+    FullValueType lap_full(0);
+    for (int d = 0; d < OHMMS_DIM; d++)
+    {
+      R[iat]               = r0;
+      R[iat][d]           += h;
+      const FullRealType p = std::log(std::abs(psi(R)));
+      R[iat]               = r0;
+      R[iat][d]           -= h;
+      const FullRealType m = std::log(std::abs(psi(R)));
+      grad[d]              = (p - m) / (2 * h);
+      lap_full            += (p + m - 2 * log0) / (h * h);
+    }
+    lap = lap_full;
+  }
+};
+
+void check_gradients(const BruteForceExpansion& brute,
+                     const ParticleSet::ParticlePos_t& R,
+                     const ParticleSet::ParticleGradient_t& G,
+                     const ParticleSet::ParticleLaplacian_t& L)
+{
+  for (int iat = 0; iat < R.size(); iat++)
+  {
+    GradType grad;
+    ValueType lap;
+    brute.gradLap(R, iat, grad, lap);
+    for (int d = 0; d < OHMMS_DIM; d++)
+      REQUIRE(G[iat][d] == ValueApprox(grad[d]).epsilon(1e-5));
+    REQUIRE(L[iat] == ValueApprox(lap).epsilon(1e-4));
+  }
+}
+
+TEST_CASE("MultiSlaterDeterminant_table", "[wavefunction][fermion]")
+{
+  const int nel   = 3;
+  const int nvirt = 4;
+  RandomGenerator<RealType> rng(11);
+  std::vector<PosType> centers(nel + nvirt);
+  std::vector<RealType> exponents(nel + nvirt);
+  for (int k = 0; k < nel + nvirt; k++)
+  {
+    centers[k]   = PosType(2 * rng(), 2 * rng(), 2 * rng());
+    exponents[k] = 0.3 + 0.5 * rng();
+  }
+  GaussianSPO* spo  = new GaussianSPO(std::vector<PosType>(centers.begin(), centers.begin() + nel),
+                                     std::vector<RealType>(exponents.begin(), exponents.begin() + nel));
+  GaussianSPO* virt = new GaussianSPO(std::vector<PosType>(centers.begin() + nel, centers.end()),
+                                      std::vector<RealType>(exponents.begin() + nel, exponents.end()));
+
+  ParticleSet elec;
+  elec.create(2 * nel);
+  for (int iat = 0; iat < 2 * nel; iat++)
+    elec.R[iat] = PosType(2 * rng(), 2 * rng(), 2 * rng());
+  elec.RSoA.copyIn(elec.R);
+
+  // delayed updates of the references, the tables use their corrected inverse rows
+  DetType det_up(spo, 0, 2);
+  DetType det_dn(spo, nel, 2);
+  MultiSlaterDeterminant msd(&det_up, &det_dn, spo, virt, nel, nel);
+
+  BruteForceExpansion brute(*spo, *virt, nel);
+  brute.excitations[0] = {{{}, {}}, {{2}, {0}}, {{1, 2}, {1, 3}}, {{0, 1, 2}, {0, 2, 3}}};
+  brute.excitations[1] = {{{}, {}}, {{0}, {3}}, {{1, 2}, {2, 0}}};
+  brute.dets = {{1.0, 0, 0}, {0.3, 1, 0}, {-0.25, 0, 1}, {0.2, 2, 1}, {0.15, 3, 2}, {-0.1, 1, 2}};
+  for (int spin = 0; spin < 2; spin++)
+    for (int e = 1; e < brute.excitations[spin].size(); e++)
+      REQUIRE(msd.getDet(spin).addExcitation(brute.excitations[spin][e].occ, brute.excitations[spin][e].virt) == e);
+  for (int J = 1; J < brute.dets.size(); J++)
+    msd.addDeterminant(brute.dets[J].c, brute.dets[J].exc_up, brute.dets[J].exc_dn);
+  REQUIRE(msd.getNumDeterminants() == brute.dets.size());
+
+  ParticleSet::ParticleGradient_t G(2 * nel);
+  ParticleSet::ParticleLaplacian_t L(2 * nel);
+  for (int iat = 0; iat < 2 * nel; iat++)
+  {
+    G[iat] = GradType();
+    L[iat] = 0;
+  }
+  RealType log_psi = det_up.evaluateLog(elec, G, L) + det_dn.evaluateLog(elec, G, L) + msd.evaluateLog(elec, G, L);
+  REQUIRE(log_psi == Approx(std::log(std::abs(brute(elec.R)))));
+  check_gradients(brute, elec.R, G, L);
+
+  // moves of both spins, the weights of the other spin change
+  const int moved[] = {1, 4, 2, 3, 0};
+  for (int iat : moved)
+  {
+    DetType& det = (iat < nel) ? det_up : det_dn;
+
+    GradType grad_ref, grad_now;
+    ValueType lap_ref;
+    brute.gradLap(elec.R, iat, grad_ref, lap_ref);
+    // the reference first, it provides the inverse row
+    grad_now = det.evalGrad(elec, iat);
+    grad_now += msd.evalGrad(elec, iat);
+    for (int d = 0; d < OHMMS_DIM; d++)
+      REQUIRE(grad_now[d] == ValueApprox(grad_ref[d]).epsilon(1e-5));
+
+    const PosType displ(0.3 * rng() - 0.15, 0.3 * rng() - 0.15, 0.3 * rng() - 0.15);
+    ParticleSet::ParticlePos_t R_new(elec.R);
+    R_new[iat] += displ;
+    const ValueType ratio_ref = static_cast<ValueType>(brute(R_new) / brute(elec.R));
+    elec.makeMove(iat, displ);
+
+    // the values only, then rejected
+    ValueType ratio = det.ratio(elec, iat);
+    ratio *= msd.ratio(elec, iat);
+    REQUIRE(ratio == ValueApprox(ratio_ref));
+    elec.rejectMove(iat);
+
+    elec.makeMove(iat, displ);
+    GradType grad_new;
+    ratio = det.ratioGrad(elec, iat, grad_new);
+    ratio *= msd.ratioGrad(elec, iat, grad_new);
+    REQUIRE(ratio == ValueApprox(ratio_ref));
+    brute.gradLap(R_new, iat, grad_ref, lap_ref);
+    for (int d = 0; d < OHMMS_DIM; d++)
+      REQUIRE(grad_new[d] == ValueApprox(grad_ref[d]).epsilon(1e-5));
+
+    det.acceptMove(elec, iat);
+    msd.acceptMove(elec, iat);
+    elec.acceptMove(iat);
+    log_psi = det_up.LogValue + det_dn.LogValue + msd.LogValue;
+    REQUIRE(log_psi == Approx(std::log(std::abs(brute(elec.R)))));
+  }
+
+  // virtual moves of a particle of each spin, after the updates as in the drivers
+  det_up.completeUpdates();
+  det_dn.completeUpdates();
+  for (int iat : {0, nel + 1})
+  {
+    DetType& det = (iat < nel) ? det_up : det_dn;
+    const int nknots = 5;
+    VirtualParticleSet VP(elec, nknots);
+    ParticleSet::ParticlePos_t knots(nknots);
+    for (int k = 0; k < nknots; k++)
+      knots[k] = elec.R[iat] + PosType(0.5 * rng() - 0.25, 0.5 * rng() - 0.25, 0.5 * rng() - 0.25);
+    VP.makeMoves(iat, knots);
+    std::vector<ValueType> ratios(nknots), msd_ratios(nknots);
+    det.evaluateRatios(VP, ratios);
+    msd.evaluateRatios(VP, msd_ratios);
+    for (int k = 0; k < nknots; k++)
+    {
+      ParticleSet::ParticlePos_t R_new(elec.R);
+      R_new[iat] = knots[k];
+      REQUIRE(ratios[k] * msd_ratios[k] == ValueApprox(brute(R_new) / brute(elec.R)));
+    }
+  }
+
+  // the tables after the updates match the ones computed from the new inverses
+  for (int iat = 0; iat < 2 * nel; iat++)
+  {
+    G[iat] = GradType();
+    L[iat] = 0;
+  }
+  det_up.evaluateGL(elec, G, L);
+  det_dn.evaluateGL(elec, G, L);
+  msd.evaluateGL(elec, G, L);
+  log_psi = det_up.LogValue + det_dn.LogValue + msd.LogValue;
+  REQUIRE(log_psi == Approx(std::log(std::abs(brute(elec.R)))));
+  check_gradients(brute, elec.R, G, L);
+  delete spo;
+}
+
+TEST_CASE("MultiSlaterDeterminant_random_expansion", "[wavefunction][fermion]")
+{
+  const int nel   = 20;
+  const int nvirt = 8;
+  RandomGenerator<RealType> rng(11);
+  std::vector<PosType> centers(nel + nvirt);
+  std::vector<RealType> exponents(nel + nvirt, 0.5);
+  for (int k = 0; k < nel + nvirt; k++)
+    centers[k] = PosType(4 * rng(), 4 * rng(), 4 * rng());
+  GaussianSPO* spo  = new GaussianSPO(std::vector<PosType>(centers.begin(), centers.begin() + nel),
+                                     std::vector<RealType>(exponents.begin(), exponents.begin() + nel));
+  GaussianSPO* virt = new GaussianSPO(std::vector<PosType>(centers.begin() + nel, centers.end()),
+                                      std::vector<RealType>(exponents.begin() + nel, exponents.end()));
+  DetType det_up(spo, 0);
+  DetType det_dn(spo, nel);
+  MultiSlaterDeterminant msd(&det_up, &det_dn, spo, virt, nel, nel);
+
+  const int num_dets = 200;
+  msd.buildRandomExpansion(num_dets);
+  REQUIRE(msd.getNumDeterminants() == num_dets);
+  for (int spin = 0; spin < 2; spin++)
+  {
+    const MultiDiracDeterminant& det = msd.getDet(spin);
+    REQUIRE(det.getNumExcitations() > 1);
+    REQUIRE(det.getNumExcitations() * det.getNumExcitations() >= num_dets);
+    for (int e = 1; e < det.getNumExcitations(); e++)
+    {
+      REQUIRE(det.getLevel(e) >= 1);
+      REQUIRE(det.getLevel(e) <= 3);
+    }
+  }
+  delete spo;
+}
+
+} // namespace qmcplusplus
@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+#include "catch.hpp"
+
+#include "Particle/ParticleSet_builder.hpp"
+#include "QMCWaveFunctions/SPOSet_builder.h"
+#include "QMCWaveFunctions/WaveFunction.h"
+#include "Utilities/RandomGenerator.h"
+
+namespace qmcplusplus
+{
+typedef QMCTraits::RealType RealType;
+typedef QMCTraits::PosType PosType;
+
+void check_same_GL(const ParticleSet::ParticleGradient_t& G_a,
+                   const ParticleSet::ParticleLaplacian_t& L_a,
+                   const ParticleSet::ParticleGradient_t& G_b,
+                   const ParticleSet::ParticleLaplacian_t& L_b)
+{
+  REQUIRE(G_a.size() == G_b.size());
+  for (int iat = 0; iat < G_a.size(); iat++)
+  {
+    for (int d = 0; d < OHMMS_DIM; d++)
+      REQUIRE(G_a[iat][d] == G_b[iat][d]);
+    REQUIRE(L_a[iat] == L_b[iat]);
+  }
+}
+
+// the all-electron moves of the drivers: recompute the trial, swap it in if accepted
+TEST_CASE("WaveFunction_swap_trial", "[wavefunction]")
+{
+  Tensor<int, 3> tmat(1, 0, 0, 0, 1, 0, 0, 0, 1);
+  ParticleSet ions;
+  Tensor<OHMMS_PRECISION, 3> lattice_b;
+  build_ions(ions, tmat, lattice_b);
+
+  RandomGenerator<RealType> rng(11);
+  ParticleSet els;
+  build_els(els, ions, rng);
+  els.update();
+  const int nels = els.getTotalNum();
+
+  SPOSet* spo_main = build_SPOSet(false, 12, 12, 12, nels / 2, 1, lattice_b);
+  WaveFunction wavefunction, trial, fresh;
+  build_WaveFunction(false, spo_main, wavefunction, ions, els, rng, 8, false);
+  build_WaveFunction(false, spo_main, trial, ions, els, rng, 8, false);
+  build_WaveFunction(false, spo_main, fresh, ions, els, rng, 8, false);
+
+  wavefunction.evaluateLog(els);
+  const ParticleSet::ParticlePos_t R_old(els.R);
+  const ParticleSet::ParticleGradient_t G_old(els.G);
+  const ParticleSet::ParticleLaplacian_t L_old(els.L);
+  const RealType log_old = wavefunction.getLogValue();
+
+  ParticleSet::ParticlePos_t delta(nels);
+  for (int iel = 0; iel < nels; iel++)
+    delta[iel] = PosType(0.2 * rng() - 0.1, 0.2 * rng() - 0.1, 0.2 * rng() - 0.1);
+
+  // a rejected all-electron move leaves the wavefunction untouched
+  for (int iel = 0; iel < nels; iel++)
+    els.R[iel] += delta[iel];
+  els.update();
+  trial.recompute(els);
+  REQUIRE(trial.getLogValue() != log_old);
+  els.R = R_old;
+  els.G = G_old;
+  els.L = L_old;
+  els.update();
+  REQUIRE(wavefunction.getLogValue() == log_old);
+
+  // so does a rejected single electron move
+  els.setActive(0);
+  PosType grad_new;
+  els.makeMove(0, delta[0]);
+  wavefunction.ratioGrad(els, 0, grad_new);
+  els.rejectMove(0);
+  wavefunction.restore(0);
+  wavefunction.completeUpdates();
+  els.donePbyP();
+  REQUIRE(wavefunction.getLogValue() == log_old);
+  wavefunction.evaluateGL(els);
+  REQUIRE(wavefunction.getLogValue() == Approx(log_old));
+
+  // an accepted one swaps in the trial, identical to a wavefunction computed from scratch
+  for (int iel = 0; iel < nels; iel++)
+    els.R[iel] += delta[iel];
+  els.update();
+  trial.recompute(els);
+  wavefunction.swap(trial);
+  const ParticleSet::ParticleGradient_t G_new(els.G);
+  const ParticleSet::ParticleLaplacian_t L_new(els.L);
+  fresh.evaluateLog(els);
+  REQUIRE(wavefunction.getLogValue() == fresh.getLogValue());
+  check_same_GL(G_new, L_new, els.G, els.L);
+
+  // the swapped in components carry on with particle-by-particle updates
+  els.setActive(1);
+  wavefunction.evalGrad(els, 1);
+  fresh.evalGrad(els, 1);
+  els.makeMove(1, delta[1]);
+  PosType grad_fresh;
+  REQUIRE(wavefunction.ratioGrad(els, 1, grad_new) == fresh.ratioGrad(els, 1, grad_fresh));
+  for (int d = 0; d < OHMMS_DIM; d++)
+    REQUIRE(grad_new[d] == grad_fresh[d]);
+  wavefunction.acceptMove(els, 1);
+  fresh.acceptMove(els, 1);
+  els.acceptMove(1);
+  wavefunction.completeUpdates();
+  fresh.completeUpdates();
+  els.donePbyP();
+  REQUIRE(wavefunction.getLogValue() == fresh.getLogValue());
+
+  delete spo_main;
+}
+
+} // namespace qmcplusplus
@@ -23,15 +23,21 @@ Communicate::Communicate(int argc, char** argv)
   m_world = MPI_COMM_WORLD;
   MPI_Comm_rank(m_world, &m_rank);
   MPI_Comm_size(m_world, &m_size);
+  MPI_Comm_split_type(m_world, MPI_COMM_TYPE_SHARED, m_rank, MPI_INFO_NULL, &m_node);
+  MPI_Comm_rank(m_node, &m_node_rank);
+  MPI_Comm_size(m_node, &m_node_size);
 #else
-  m_rank = 0;
-  m_size = 1;
+  m_rank      = 0;
+  m_size      = 1;
+  m_node_rank = 0;
+  m_node_size = 1;
 #endif
 }
 
 Communicate::~Communicate()
 {
 #ifdef HAVE_MPI
+  MPI_Comm_free(&m_node);
   MPI_Finalize();
 #endif
 }
@@ -59,3 +65,17 @@ void Communicate::reduce(double& value)
   MPI_Reduce(&local_value, &value, 1, MPI_DOUBLE, MPI_SUM, 0, m_world);
 #endif
 }
+
+void Communicate::bcast(int* values, int count)
+{
+#ifdef HAVE_MPI
+  MPI_Bcast(values, count, MPI_INT, 0, m_world);
+#endif
+}
+
+void Communicate::bcast(double& value)
+{
+#ifdef HAVE_MPI
+  MPI_Bcast(&value, 1, MPI_DOUBLE, 0, m_world);
+#endif
+}
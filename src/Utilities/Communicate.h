@@ -32,18 +32,29 @@ public:
   int rank() { return m_rank; }
   int size() { return m_size; }
   bool root() { return m_rank == 0; }
+  /// rank among the processes sharing the memory of this node
+  int node_rank() { return m_node_rank; }
+  /// number of processes sharing the memory of this node
+  int node_size() { return m_node_size; }
 #ifdef HAVE_MPI
   MPI_Comm world() { return m_world; }
+  MPI_Comm node() { return m_node; }
 #endif
   void reduce(int& value);
   void reduce(float& value);
   void reduce(double& value);
+  /// broadcast count values of the root
+  void bcast(int* values, int count);
+  void bcast(double& value);
 
 protected:
   int m_rank;
   int m_size;
+  int m_node_rank;
+  int m_node_size;
 #ifdef HAVE_MPI
   MPI_Comm m_world;
+  MPI_Comm m_node;
 #endif
 };
 
@@ -48,6 +48,8 @@ inline omp_int_t omp_get_num_threads() { return 1; }
 inline omp_int_t omp_get_level() { return 0; }
 inline omp_int_t omp_get_ancestor_thread_num(int level) { return 0; }
 inline bool omp_get_nested() { return false; }
+inline void omp_set_num_threads(int num_threads) {}
+inline void omp_set_max_active_levels(int max_levels) {}
 #endif
 
 /// get the number of threads at the next parallel level
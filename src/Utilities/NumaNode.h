@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef QMCPLUSPLUS_NUMA_NODE_H
+#define QMCPLUSPLUS_NUMA_NODE_H
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace qmcplusplus
+{
+/** NUMA node of the cpu running the calling thread
+ *
+ * Only stable if the threads are bound, e.g. with OMP_PROC_BIND.
+ * Returns 0 where the node cannot be queried.
+ */
+inline int getCurrentNumaNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    return static_cast<int>(node);
+#endif
+  return 0;
+}
+
+} // namespace qmcplusplus
+#endif
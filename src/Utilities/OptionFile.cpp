@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+#include "Utilities/OptionFile.h"
+#include "Utilities/Configuration.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace qmcplusplus
+{
+std::vector<std::string> readOptionWords(std::istream& is)
+{
+  std::vector<std::string> words;
+  std::string word;
+  bool in_word = false;
+  bool quoted  = false;
+  bool comment = false;
+  char c;
+  while (is.get(c))
+  {
+    if (comment)
+    {
+      comment = (c != '\n');
+      continue;
+    }
+    if (quoted)
+    {
+      if (c == '"')
+        quoted = false;
+      else
+        word += c;
+    }
+    else if (c == '"')
+      in_word = quoted = true;
+    else if (c == '#' && !in_word)
+      comment = true;
+    else if (std::isspace(static_cast<unsigned char>(c)))
+    {
+      if (in_word)
+        words.push_back(word);
+      word.clear();
+      in_word = false;
+    }
+    else
+    {
+      word += c;
+      in_word = true;
+    }
+  }
+  if (in_word)
+    words.push_back(word);
+  return words;
+}
+
+OptionArgs::OptionArgs(int argc, char** argv)
+{
+  const std::string threads_key = "OMP_NUM_THREADS=";
+  words.push_back(argv[0]);
+  std::vector<std::string> command_line;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string fname;
+    if (std::strcmp(argv[i], "-L") == 0 && i + 1 < argc)
+      fname = argv[++i];
+    else if (std::strncmp(argv[i], "-L", 2) == 0 && argv[i][2] != '\0')
+      fname = argv[i] + 2;
+    else
+    {
+      command_line.push_back(argv[i]);
+      continue;
+    }
+
+    std::ifstream fin(fname);
+    if (!fin)
+    {
+      app_error() << "Failed to read the option file " << fname << std::endl;
+      is_valid = false;
+      continue;
+    }
+    for (const auto& word : readOptionWords(fin))
+      if (word.compare(0, threads_key.size(), threads_key) == 0)
+        threads = std::atoi(word.c_str() + threads_key.size());
+      else
+        words.push_back(word);
+  }
+  words.insert(words.end(), command_line.begin(), command_line.end());
+
+  for (auto& word : words)
+    pointers.push_back(&word[0]);
+  pointers.push_back(nullptr);
+
+  if (threads > 0)
+    omp_set_num_threads(threads);
+}
+
+} // namespace qmcplusplus
@@ -0,0 +1,69 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file OptionFile.h
+ * @brief Declaration of OptionArgs, command line options completed by a file.
+ */
+#ifndef QMCPLUSPLUS_OPTION_FILE_H
+#define QMCPLUSPLUS_OPTION_FILE_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace qmcplusplus
+{
+/** split an option file into words
+ *
+ * Words are separated by white space, double quotes group words into one and
+ * '#' starts a comment running to the end of the line.
+ */
+std::vector<std::string> readOptionWords(std::istream& is);
+
+/** arguments of main with the options of a file inserted
+ *
+ * "-L file" on the command line is replaced by the words of the file, see
+ * readOptionWords. They are inserted ahead of the command line options so the
+ * latter override them. The word OMP_NUM_THREADS=n sets the number of threads
+ * instead, it is applied before the first parallel region of the driver.
+ *
+ * Usage: construct after Communicate and parse argc() and argv() with getopt.
+ */
+class OptionArgs
+{
+public:
+  OptionArgs(int argc, char** argv);
+
+  OptionArgs(const OptionArgs&) = delete;
+  OptionArgs& operator=(const OptionArgs&) = delete;
+
+  /// false if the option file could not be read
+  bool valid() const { return is_valid; }
+
+  int argc() const { return static_cast<int>(words.size()); }
+
+  /// null terminated like the argv of main, valid for the lifetime of this object
+  char** argv() { return pointers.data(); }
+
+  /// the number of threads set by the file, 0 if none
+  int num_threads() const { return threads; }
+
+private:
+  std::vector<std::string> words;
+  std::vector<char*> pointers;
+  bool is_valid = true;
+  int threads   = 0;
+};
+
+} // namespace qmcplusplus
+
+#endif
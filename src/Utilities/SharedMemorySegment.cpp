@@ -0,0 +1,162 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file SharedMemorySegment.cpp
+ * @brief Definition of SharedMemorySegment.
+ */
+#include <Utilities/SharedMemorySegment.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace qmcplusplus
+{
+#ifdef HAVE_MPI
+
+SharedMemorySegment::SharedMemorySegment(Communicate& comm, const std::string& name_in, size_t bytes)
+    : name(name_in), payload_bytes(bytes), creator(comm.node_rank() == 0), payload(nullptr)
+{
+  // MPI does not promise any alignment of the window, pad it to round the payload up to a cache line
+  void* base;
+  MPI_Win_allocate_shared(creator ? bytes + QMC_CLINE : 0, 1, MPI_INFO_NULL, comm.node(), &base, &window);
+  MPI_Aint shared_bytes;
+  int disp_unit;
+  void* shared_base;
+  MPI_Win_shared_query(window, 0, &shared_bytes, &disp_unit, &shared_base);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(shared_base);
+  payload                 = reinterpret_cast<void*>((address + QMC_CLINE - 1) / QMC_CLINE * QMC_CLINE);
+}
+
+SharedMemorySegment::~SharedMemorySegment() { MPI_Win_free(&window); }
+
+void SharedMemorySegment::publish()
+{
+  // MPI owns the mapping, so the payload stays writable
+  MPI_Win_fence(0, window);
+}
+
+#else
+
+namespace
+{
+/** bookkeeping at the start of a POSIX segment
+ *
+ * The segment reaches its full size before the creator writes the header, the
+ * attaching processes wait for initialized before reading or counting themselves.
+ */
+struct SegmentHeader
+{
+  std::atomic<int> initialized;
+  std::atomic<int> ready;
+  std::atomic<int> users;
+  size_t payload_bytes;
+};
+
+/// seconds to wait for another process creating the segment
+constexpr int attach_timeout = 600;
+
+template<typename COND>
+void wait_for(const std::string& name, COND cond)
+{
+  auto start = std::chrono::steady_clock::now();
+  while (!cond())
+  {
+    if (std::chrono::steady_clock::now() - start > std::chrono::seconds(attach_timeout))
+      APP_ABORT("SharedMemorySegment timed out waiting for " << name << ". Remove /dev/shm" << name
+                                                            << " if it is left over from an aborted run.");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+} // namespace
+
+SharedMemorySegment::SharedMemorySegment(Communicate& comm, const std::string& name_in, size_t bytes)
+    : name(name_in), payload_bytes(bytes), creator(false), payload(nullptr), mapping(nullptr)
+{
+  const size_t page = sysconf(_SC_PAGESIZE);
+  mapping_bytes     = page + (bytes + page - 1) / page * page;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd >= 0)
+  {
+    creator = true;
+    if (ftruncate(fd, mapping_bytes) != 0)
+      APP_ABORT("SharedMemorySegment failed to size " << name << ": " << std::strerror(errno));
+  }
+  else if (errno == EEXIST)
+  {
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+      APP_ABORT("SharedMemorySegment failed to open " << name << ": " << std::strerror(errno));
+    // the creator may not have sized the segment yet
+    wait_for(name, [&] {
+      struct stat st;
+      return fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= mapping_bytes;
+    });
+  }
+  else
+    APP_ABORT("SharedMemorySegment failed to create " << name << ": " << std::strerror(errno));
+
+  mapping = mmap(nullptr, mapping_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    APP_ABORT("SharedMemorySegment failed to map " << name << ": " << std::strerror(errno));
+  payload = static_cast<char*>(mapping) + page;
+
+  SegmentHeader* header;
+  if (creator)
+  {
+    // the new segment is zero, initialized stays 0 until the header is complete
+    header                = new (mapping) SegmentHeader;
+    header->payload_bytes = bytes;
+    header->users.store(1, std::memory_order_relaxed);
+    header->ready.store(0, std::memory_order_relaxed);
+    header->initialized.store(1, std::memory_order_release);
+  }
+  else
+  {
+    header = static_cast<SegmentHeader*>(mapping);
+    wait_for(name, [&] { return header->initialized.load(std::memory_order_acquire) == 1; });
+    header->users.fetch_add(1);
+    if (header->payload_bytes != bytes)
+      APP_ABORT("SharedMemorySegment " << name << " exists with a different size");
+  }
+}
+
+SharedMemorySegment::~SharedMemorySegment()
+{
+  SegmentHeader* header = static_cast<SegmentHeader*>(mapping);
+  if (header->users.fetch_sub(1) == 1)
+    shm_unlink(name.c_str());
+  munmap(mapping, mapping_bytes);
+}
+
+void SharedMemorySegment::publish()
+{
+  SegmentHeader* header = static_cast<SegmentHeader*>(mapping);
+  if (creator)
+    header->ready.store(1, std::memory_order_release);
+  else
+    wait_for(name, [&] { return header->ready.load(std::memory_order_acquire) == 1; });
+  mprotect(payload, mapping_bytes - (static_cast<char*>(payload) - static_cast<char*>(mapping)), PROT_READ);
+}
+
+#endif
+
+} // namespace qmcplusplus
@@ -0,0 +1,81 @@
+//////////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source License.
+// See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+//////////////////////////////////////////////////////////////////////////////////////
+
+
+/** @file SharedMemorySegment.h
+ * @brief Declaration of SharedMemorySegment, memory shared by the processes of a node.
+ */
+#ifndef QMCPLUSPLUS_SHARED_MEMORY_SEGMENT_H
+#define QMCPLUSPLUS_SHARED_MEMORY_SEGMENT_H
+
+#include <string>
+#include <Utilities/Communicate.h>
+
+namespace qmcplusplus
+{
+/** memory segment shared by the processes of a node
+ *
+ * One process per node creates and fills the segment, the others attach to it.
+ * With MPI, the segment is an MPI-3 shared window on the node communicator.
+ * Without MPI, it is a named POSIX shared memory object and independent
+ * processes using the same name share it. The last process detaching from it
+ * removes the name.
+ *
+ * Usage: construct on every process, fill data() on the creator, then call
+ * publish() on every process before reading.
+ */
+class SharedMemorySegment
+{
+public:
+  /** create or attach to a segment
+   * @param comm communicator, the processes of a node share the segment
+   * @param name name of the POSIX shared memory object, starting with '/'
+   * @param bytes size of the segment
+   */
+  SharedMemorySegment(Communicate& comm, const std::string& name, size_t bytes);
+
+  ~SharedMemorySegment();
+
+  SharedMemorySegment(const SharedMemorySegment&) = delete;
+  SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+  /// true if this process is responsible for filling the segment
+  bool isCreator() const { return creator; }
+
+  /// start of the segment, aligned to a page
+  void* data() const { return payload; }
+
+  /// size of the segment in bytes
+  size_t size() const { return payload_bytes; }
+
+  /** make the contents written by the creator visible to every process
+   *
+   * Attaching processes wait for the creator. Afterwards the segment is
+   * mapped read-only where the platform allows it.
+   */
+  void publish();
+
+private:
+  std::string name;
+  size_t payload_bytes;
+  bool creator;
+  void* payload;
+#ifdef HAVE_MPI
+  MPI_Win window;
+#else
+  /// the whole mapping, a header page followed by the payload
+  void* mapping;
+  size_t mapping_bytes;
+#endif
+};
+
+} // namespace qmcplusplus
+#endif
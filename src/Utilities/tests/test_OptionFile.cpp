@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+// This file is distributed under the University of Illinois/NCSA Open Source
+// License.  See LICENSE file in top directory for details.
+//
+// Copyright (c) 2019 QMCPACK developers.
+//
+// File developed by:
+//
+// File created by:
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+#include "Utilities/OptionFile.h"
+#include "Utilities/Configuration.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <sstream>
+
+namespace qmcplusplus
+{
+TEST_CASE("OptionFile words", "[Utilities]")
+{
+  std::istringstream is("# autotuned\n-g \"2 2 1\"  -w 8 # walkers\n\t-a 64\n-j");
+  std::vector<std::string> words = readOptionWords(is);
+  REQUIRE(words.size() == 7);
+  REQUIRE(words[0] == "-g");
+  REQUIRE(words[1] == "2 2 1");
+  REQUIRE(words[2] == "-w");
+  REQUIRE(words[3] == "8");
+  REQUIRE(words[4] == "-a");
+  REQUIRE(words[5] == "64");
+  REQUIRE(words[6] == "-j");
+}
+
+TEST_CASE("OptionFile missing file", "[Utilities]")
+{
+  std::vector<std::string> strs = {"dummy_progname", "-w", "4", "-L", "/nonexistent/miniqmc.opt", "-a", "32"};
+  std::vector<char*> ptrs;
+  for (auto& s : strs)
+    ptrs.push_back(&s[0]);
+  ptrs.push_back(nullptr);
+
+  OptionArgs args(strs.size(), ptrs.data());
+  REQUIRE(!args.valid());
+  REQUIRE(args.argc() == 5);
+  REQUIRE(std::string(args.argv()[3]) == "-a");
+  REQUIRE(args.argv()[5] == nullptr);
+  REQUIRE(args.num_threads() == 0);
+}
+
+TEST_CASE("OptionFile command line wins", "[Utilities]")
+{
+  const char* fname = "test_option_file.opt";
+  {
+    std::ofstream fout(fname);
+    fout << "-w 8 -a 64\n-j\n";
+  }
+  std::vector<std::string> strs = {"dummy_progname", "-L", fname, "-w", "4"};
+  std::vector<char*> ptrs;
+  for (auto& s : strs)
+    ptrs.push_back(&s[0]);
+  ptrs.push_back(nullptr);
+
+  OptionArgs args(strs.size(), ptrs.data());
+  std::remove(fname);
+  REQUIRE(args.valid());
+  REQUIRE(args.argc() == 8);
+
+  // parsed like the drivers do, the last -w is the one of the command line
+  int nw = 0, tile = 0;
+  bool j3 = false;
+  optind  = 1;
+  int opt;
+  while ((opt = getopt(args.argc(), args.argv(), "ja:w:")) != -1)
+    switch (opt)
+    {
+    case 'a':
+      tile = std::atoi(optarg);
+      break;
+    case 'j':
+      j3 = true;
+      break;
+    case 'w':
+      nw = std::atoi(optarg);
+      break;
+    }
+  optind = 1;
+  REQUIRE(nw == 4);
+  REQUIRE(tile == 64);
+  REQUIRE(j3);
+}
+
+TEST_CASE("OptionFile OMP_NUM_THREADS", "[Utilities]")
+{
+  const char* fname = "test_option_file_threads.opt";
+  {
+    std::ofstream fout(fname);
+    fout << "# autotuned\nOMP_NUM_THREADS=3\n-w 2\n";
+  }
+  std::vector<std::string> strs = {"dummy_progname", "-L", fname};
+  std::vector<char*> ptrs;
+  for (auto& s : strs)
+    ptrs.push_back(&s[0]);
+  ptrs.push_back(nullptr);
+
+  const int saved_threads = omp_get_max_threads();
+  OptionArgs args(strs.size(), ptrs.data());
+  std::remove(fname);
+  REQUIRE(args.valid());
+  REQUIRE(args.num_threads() == 3);
+  // the setting is not passed on as an option but applied to OpenMP
+  REQUIRE(args.argc() == 3);
+  REQUIRE(std::string(args.argv()[1]) == "-w");
+#if defined(ENABLE_OPENMP)
+  REQUIRE(omp_get_max_threads() == 3);
+#endif
+  omp_set_num_threads(saved_threads);
+}
+
+} // namespace qmcplusplus